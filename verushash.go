@@ -1,40 +1,143 @@
 package verushash
 
 import (
+	"runtime"
+	"sync"
+
 	"github.com/hashpool/go-verushash/verushash"
-	"unsafe"
 )
 
-// Initialize verushash object once.
-var verusHash = VH.NewVerushash()
+// ErrInvalidHeader is returned by VerusHash_V2B2Into for input that is not a complete
+// serialized block header.
+var ErrInvalidHeader = VH.ErrInvalidHeader
 
 func VerusHash(serializedHeader []byte) []byte {
-	hash := make([]byte, 32)
-	ptrHash := uintptr(unsafe.Pointer(&hash[0]))
-	length := len(serializedHeader)
-	verusHash.Verushash(string(serializedHeader), length, ptrHash)
+	hash := make([]byte, VH.HashSize)
+	VH.HashInto(hash, serializedHeader)
 	return hash
 }
 
 func VerusHash_V2B(serializedHeader []byte) []byte {
-	hash := make([]byte, 32)
-	ptrHash := uintptr(unsafe.Pointer(&hash[0]))
-	length := len(serializedHeader)
-	verusHash.Verushash_v2b(string(serializedHeader), length, ptrHash)
+	hash := make([]byte, VH.HashSize)
+	VH.HashV2bInto(hash, serializedHeader)
 	return hash
 }
 
 func VerusHash_V2B1(serializedHeader []byte) []byte {
-	hash := make([]byte, 32)
-	ptrHash := uintptr(unsafe.Pointer(&hash[0]))
-	length := len(serializedHeader)
-	verusHash.Verushash_v2b1(string(serializedHeader), length, ptrHash)
+	hash := make([]byte, VH.HashSize)
+	VH.HashV2b1Into(hash, serializedHeader)
 	return hash
 }
 
+// VerusHash_V2B2 returns a zero hash if serializedHeader is not a complete header.
 func VerusHash_V2B2(serializedHeader []byte) []byte {
-	hash := make([]byte, 32)
-	ptrHash := uintptr(unsafe.Pointer(&hash[0]))
-	verusHash.Verushash_v2b2(string(serializedHeader), ptrHash)
+	hash := make([]byte, VH.HashSize)
+	VH.HashV2b2Into(hash, serializedHeader)
 	return hash
 }
+
+// The Into variants write the hash to the first 32 bytes of dst instead of allocating it.
+
+func VerusHashInto(dst, serializedHeader []byte) {
+	VH.HashInto(dst, serializedHeader)
+}
+
+func VerusHash_V2Into(dst, serializedHeader []byte) {
+	VH.HashV2Into(dst, serializedHeader)
+}
+
+func VerusHash_V2BInto(dst, serializedHeader []byte) {
+	VH.HashV2bInto(dst, serializedHeader)
+}
+
+func VerusHash_V2B1Into(dst, serializedHeader []byte) {
+	VH.HashV2b1Into(dst, serializedHeader)
+}
+
+func VerusHash_V2B2Into(dst, serializedHeader []byte) error {
+	return VH.HashV2b2Into(dst, serializedHeader)
+}
+
+var (
+	batchOnce sync.Once
+	batch     *VH.Batch
+)
+
+// VerusHash_V2B2Batch hashes every header into dst, 32 bytes per header, in a single call into
+// C++ that spreads the headers over GOMAXPROCS native threads. errs, if not nil, must be as
+// long as headers and gets ErrInvalidHeader or nil for each one. It returns the number of
+// invalid headers, whose hashes are zero.
+func VerusHash_V2B2Batch(dst []byte, headers [][]byte, errs []error) int {
+	batchOnce.Do(func() {
+		batch = VH.NewBatch(runtime.GOMAXPROCS(0))
+	})
+	failed, _ := batch.HashV2b2(dst, headers, errs)
+	return failed
+}
+
+// Templates checks shares against registered pool jobs from only their nTime and the end of
+// their solution, see VH.Templates.
+type Templates = VH.Templates
+
+// NewTemplates returns Templates with room for capacity live jobs, or a default number if
+// capacity is not positive.
+func NewTemplates(capacity int) *Templates {
+	return VH.NewTemplates(capacity)
+}
+
+// Stats holds the library's opt-in hot path counters and stage timings, see VH.Stats.
+type Stats = VH.Stats
+
+// EnableStats turns the counters on or off. They are off by default.
+func EnableStats(enable bool) {
+	VH.EnableStats(enable)
+}
+
+// ReadStats fills stats with the totals since the last ResetStats.
+func ReadStats(stats *Stats) {
+	VH.ReadStats(stats)
+}
+
+func ResetStats() {
+	VH.ResetStats()
+}
+
+// KeyCacheStats holds the counters of the key cache that every context shares, see
+// VH.KeyCacheStats.
+type KeyCacheStats = VH.KeyCacheStats
+
+// SetKeyCacheCapacity sets how many generated keys the shared cache holds, 0 turning it off,
+// and returns the capacity set. It is off by default.
+func SetKeyCacheCapacity(entries int) int {
+	return VH.SetKeyCacheCapacity(entries)
+}
+
+// ReadKeyCacheStats fills stats with the key cache counters since the last ResetKeyCacheStats.
+func ReadKeyCacheStats(stats *KeyCacheStats) {
+	VH.ReadKeyCacheStats(stats)
+}
+
+func ResetKeyCacheStats() {
+	VH.ResetKeyCacheStats()
+}
+
+// CompactToTarget expands nBits into the first 32 bytes of dst, little endian as hashes are
+// written. It returns VH.ErrInvalidCompact for an nBits no hash can meet.
+func CompactToTarget(dst []byte, nBits uint32) error {
+	return VH.CompactToTarget(dst, nBits)
+}
+
+// TargetToCompact returns the nBits form of a 32 byte little endian target, rounded down.
+func TargetToCompact(target []byte) uint32 {
+	return VH.TargetToCompact(target)
+}
+
+// MeetsTarget reports whether hash is at or below target, as 256 bit numbers.
+func MeetsTarget(hash, target []byte) bool {
+	return VH.MeetsTarget(hash, target)
+}
+
+// HashDifficulty returns diff1Target / hash, the difficulty to credit a share with.
+func HashDifficulty(hash, diff1Target []byte) float64 {
+	return VH.HashDifficulty(hash, diff1Target)
+}
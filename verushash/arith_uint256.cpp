@@ -0,0 +1,359 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "arith_uint256.h"
+
+#include "crypto/uint256.h"
+#include "crypto/common.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 uint128_arith;
+
+// returns the low 64 bits of a * b + add, and the high 64 bits in hi
+static inline uint64_t MulAdd64(uint64_t a, uint64_t b, uint64_t add, uint64_t &hi)
+{
+    uint128_arith n = (uint128_arith)a * b + add;
+    hi = (uint64_t)(n >> 64);
+    return (uint64_t)n;
+}
+
+// divides hi:lo by d, which must be greater than hi, returning the remainder in rem
+static inline uint64_t Div128By64(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem)
+{
+    uint128_arith n = ((uint128_arith)hi << 64) | lo;
+    rem = (uint64_t)(n % d);
+    return (uint64_t)(n / d);
+}
+#else
+static inline uint64_t MulAdd64(uint64_t a, uint64_t b, uint64_t add, uint64_t &hi)
+{
+    uint64_t aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32;
+    uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    uint64_t lo = (mid << 32) | (uint32_t)ll;
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    lo += add;
+    hi += lo < add;
+    return lo;
+}
+
+static inline uint64_t Div128By64(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem)
+{
+    uint64_t q = 0;
+    for (int i = 63; i >= 0; i--)
+    {
+        uint64_t top = hi >> 63;
+        hi = (hi << 1) | (lo >> 63);
+        lo <<= 1;
+        if (top || hi >= d)
+        {
+            hi -= d;
+            q |= (uint64_t)1 << i;
+        }
+    }
+    rem = hi;
+    return q;
+}
+#endif
+
+static inline int CountLeadingZeros64(uint64_t n)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(n);
+#else
+    int count = 0;
+    while (!(n & 0x8000000000000000ULL))
+    {
+        n <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+template <unsigned int BITS>
+base_uint<BITS>::base_uint(const std::string& str)
+{
+    SetHex(str);
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::operator<<=(unsigned int shift)
+{
+    base_uint<BITS> a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    int k = shift / 64;
+    shift = shift % 64;
+    for (int i = 0; i < WIDTH; i++) {
+        if (i + k + 1 < WIDTH && shift != 0)
+            pn[i + k + 1] |= (a.pn[i] >> (64 - shift));
+        if (i + k < WIDTH)
+            pn[i + k] |= (a.pn[i] << shift);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::operator>>=(unsigned int shift)
+{
+    base_uint<BITS> a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    int k = shift / 64;
+    shift = shift % 64;
+    for (int i = 0; i < WIDTH; i++) {
+        if (i - k - 1 >= 0 && shift != 0)
+            pn[i - k - 1] |= (a.pn[i] << (64 - shift));
+        if (i - k >= 0)
+            pn[i - k] |= (a.pn[i] >> shift);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::operator*=(uint32_t b32)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < WIDTH; i++) {
+        pn[i] = MulAdd64(pn[i], b32, carry, carry);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::operator*=(const base_uint& b)
+{
+    base_uint<BITS> a;
+    for (int j = 0; j < WIDTH; j++) {
+        uint64_t carry = 0;
+        for (int i = 0; i + j < WIDTH; i++) {
+            uint64_t hi;
+            uint64_t lo = MulAdd64(pn[j], b.pn[i], carry, hi);
+            a.pn[i + j] += lo;
+            carry = hi + (a.pn[i + j] < lo);
+        }
+    }
+    *this = a;
+    return *this;
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::operator/=(const base_uint& b)
+{
+    int n = WIDTH;                      // limbs in the divisor
+    while (n > 0 && !b.pn[n - 1])
+        n--;
+    if (!n)
+        throw uint_error("Division by zero");
+    int m = WIDTH;                      // limbs in the dividend
+    while (m > 0 && !pn[m - 1])
+        m--;
+
+    base_uint<BITS> q;
+    if (m < n || *this < b) {
+        *this = q;
+        return *this;
+    }
+
+    if (n == 1) {
+        // one limb divisor, one 128 by 64 bit division per limb
+        uint64_t rem = 0;
+        for (int i = m - 1; i >= 0; i--)
+            q.pn[i] = Div128By64(rem, pn[i], b.pn[0], rem);
+        *this = q;
+        return *this;
+    }
+
+    // Knuth's algorithm D, normalizing so the divisor's top limb has its high bit set
+    int s = CountLeadingZeros64(b.pn[n - 1]);
+    uint64_t vn[WIDTH], un[WIDTH + 1];
+    for (int i = n - 1; i > 0; i--)
+        vn[i] = (b.pn[i] << s) | (s ? b.pn[i - 1] >> (64 - s) : 0);
+    vn[0] = b.pn[0] << s;
+    un[m] = s ? pn[m - 1] >> (64 - s) : 0;
+    for (int i = m - 1; i > 0; i--)
+        un[i] = (pn[i] << s) | (s ? pn[i - 1] >> (64 - s) : 0);
+    un[0] = pn[0] << s;
+
+    for (int j = m - n; j >= 0; j--) {
+        // estimate the quotient limb from the top two limbs, the remainder so far is below the
+        // divisor, so un[j + n] is at most vn[n - 1] and the estimate is at most 2 too large
+        uint64_t qhat, rhat;
+        bool rhatOverflow = false;
+        if (un[j + n] >= vn[n - 1]) {
+            qhat = ~(uint64_t)0;
+            rhat = un[j + n - 1] + vn[n - 1];
+            rhatOverflow = rhat < vn[n - 1];
+        } else {
+            qhat = Div128By64(un[j + n], un[j + n - 1], vn[n - 1], rhat);
+        }
+        while (!rhatOverflow) {
+            uint64_t phi, plo = MulAdd64(qhat, vn[n - 2], 0, phi);
+            if (phi < rhat || (phi == rhat && plo <= un[j + n - 2]))
+                break;
+            qhat--;
+            rhat += vn[n - 1];
+            rhatOverflow = rhat < vn[n - 1];
+        }
+
+        // multiply and subtract
+        uint64_t carry = 0, borrow = 0;
+        for (int i = 0; i < n; i++) {
+            uint64_t plo = MulAdd64(qhat, vn[i], carry, carry);
+            uint64_t t = un[i + j] - plo;
+            uint64_t b1 = un[i + j] < plo;
+            un[i + j] = t - borrow;
+            borrow = b1 | (t < borrow);
+        }
+        uint64_t t = un[j + n] - carry;
+        uint64_t b1 = un[j + n] < carry;
+        un[j + n] = t - borrow;
+        borrow = b1 | (t < borrow);
+
+        // the estimate was one too large, add the divisor back
+        if (borrow) {
+            qhat--;
+            uint64_t c = 0;
+            for (int i = 0; i < n; i++) {
+                uint64_t sum = un[i + j] + vn[i];
+                uint64_t c1 = sum < vn[i];
+                un[i + j] = sum + c;
+                c = c1 | (un[i + j] < sum);
+            }
+            un[j + n] += c;
+        }
+        q.pn[j] = qhat;
+    }
+    *this = q;
+    return *this;
+}
+
+template <unsigned int BITS>
+double base_uint<BITS>::getdouble() const
+{
+    // no data dependent branches, the limbs are scaled and summed from the top down
+    double ret = 0.0;
+    for (int i = WIDTH - 1; i >= 0; i--)
+        ret = ret * 18446744073709551616.0 + (double)pn[i];
+    return ret;
+}
+
+template <unsigned int BITS>
+std::string base_uint<BITS>::GetHex() const
+{
+    return ArithToUint256(*this).GetHex();
+}
+
+template <unsigned int BITS>
+void base_uint<BITS>::SetHex(const char* psz)
+{
+    *this = UintToArith256(uint256S(psz));
+}
+
+template <unsigned int BITS>
+void base_uint<BITS>::SetHex(const std::string& str)
+{
+    SetHex(str.c_str());
+}
+
+template <unsigned int BITS>
+std::string base_uint<BITS>::ToString() const
+{
+    return (GetHex());
+}
+
+template <unsigned int BITS>
+unsigned int base_uint<BITS>::bits() const
+{
+    for (int pos = WIDTH - 1; pos >= 0; pos--) {
+        if (pn[pos])
+            return 64 * pos + 64 - CountLeadingZeros64(pn[pos]);
+    }
+    return 0;
+}
+
+// Explicit instantiations for base_uint<256>
+template base_uint<256>::base_uint(const std::string&);
+template base_uint<256>& base_uint<256>::operator<<=(unsigned int);
+template base_uint<256>& base_uint<256>::operator>>=(unsigned int);
+template base_uint<256>& base_uint<256>::operator*=(uint32_t b32);
+template base_uint<256>& base_uint<256>::operator*=(const base_uint<256>& b);
+template base_uint<256>& base_uint<256>::operator/=(const base_uint<256>& b);
+template double base_uint<256>::getdouble() const;
+template std::string base_uint<256>::GetHex() const;
+template std::string base_uint<256>::ToString() const;
+template void base_uint<256>::SetHex(const char*);
+template void base_uint<256>::SetHex(const std::string&);
+template unsigned int base_uint<256>::bits() const;
+
+// This implementation directly uses shifts instead of going
+// through an intermediate MPI representation.
+arith_uint256& arith_uint256::SetCompact(uint32_t nCompact, bool* pfNegative, bool* pfOverflow)
+{
+    int nSize = nCompact >> 24;
+    uint32_t nWord = nCompact & 0x007fffff;
+    if (nSize <= 3) {
+        nWord >>= 8 * (3 - nSize);
+        *this = nWord;
+    } else {
+        *this = nWord;
+        *this <<= 8 * (nSize - 3);
+    }
+    if (pfNegative)
+        *pfNegative = nWord != 0 && (nCompact & 0x00800000) != 0;
+    if (pfOverflow)
+        *pfOverflow = nWord != 0 && ((nSize > 34) ||
+                                     (nWord > 0xff && nSize > 33) ||
+                                     (nWord > 0xffff && nSize > 32));
+    return *this;
+}
+
+uint32_t arith_uint256::GetCompact(bool fNegative) const
+{
+    int nSize = (bits() + 7) / 8;
+    uint32_t nCompact = 0;
+    if (nSize <= 3) {
+        nCompact = GetLow64() << 8 * (3 - nSize);
+    } else {
+        arith_uint256 bn = *this >> 8 * (nSize - 3);
+        nCompact = bn.GetLow64();
+    }
+    // The 0x00800000 bit denotes the sign.
+    // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
+    if (nCompact & 0x00800000) {
+        nCompact >>= 8;
+        nSize++;
+    }
+    assert((nCompact & ~0x007fffff) == 0);
+    assert(nSize < 256);
+    nCompact |= nSize << 24;
+    nCompact |= (fNegative && (nCompact & 0x007fffff) ? 0x00800000 : 0);
+    return nCompact;
+}
+
+uint256 ArithToUint256(const arith_uint256 &a)
+{
+    uint256 b;
+    for (int x = 0; x < a.WIDTH; ++x)
+        WriteLE64(b.begin() + x * 8, a.pn[x]);
+    return b;
+}
+
+arith_uint256 UintToArith256(const uint256 &a)
+{
+    arith_uint256 b;
+    for (int x = 0; x < b.WIDTH; ++x)
+        b.pn[x] = ReadLE64(a.begin() + x * 8);
+    return b;
+}
+
+double GetHashDifficulty(const uint256 &hash, const arith_uint256 &diff1Target)
+{
+    return diff1Target.getdouble() / UintToArith256(hash).getdouble();
+}
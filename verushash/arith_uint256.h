@@ -20,13 +20,13 @@ public:
     explicit uint_error(const std::string& str) : std::runtime_error(str) {}
 };
 
-/** Template base class for unsigned big integers. */
+/** Template base class for unsigned big integers, in little endian 64 bit limbs. */
 template<unsigned int BITS>
 class base_uint
 {
 protected:
-    enum { WIDTH=BITS/32 };
-    uint32_t pn[WIDTH];
+    enum { WIDTH=BITS/64 };
+    uint64_t pn[WIDTH];
 public:
 
     base_uint()
@@ -50,9 +50,8 @@ public:
 
     base_uint(uint64_t b)
     {
-        pn[0] = (unsigned int)b;
-        pn[1] = (unsigned int)(b >> 32);
-        for (int i = 2; i < WIDTH; i++)
+        pn[0] = b;
+        for (int i = 1; i < WIDTH; i++)
             pn[i] = 0;
     }
 
@@ -60,10 +59,10 @@ public:
 
     bool operator!() const
     {
+        uint64_t any = 0;
         for (int i = 0; i < WIDTH; i++)
-            if (pn[i] != 0)
-                return false;
-        return true;
+            any |= pn[i];
+        return any == 0;
     }
 
     const base_uint operator~() const
@@ -87,9 +86,8 @@ public:
 
     base_uint& operator=(uint64_t b)
     {
-        pn[0] = (unsigned int)b;
-        pn[1] = (unsigned int)(b >> 32);
-        for (int i = 2; i < WIDTH; i++)
+        pn[0] = b;
+        for (int i = 1; i < WIDTH; i++)
             pn[i] = 0;
         return *this;
     }
@@ -117,15 +115,13 @@ public:
 
     base_uint& operator^=(uint64_t b)
     {
-        pn[0] ^= (unsigned int)b;
-        pn[1] ^= (unsigned int)(b >> 32);
+        pn[0] ^= b;
         return *this;
     }
 
     base_uint& operator|=(uint64_t b)
     {
-        pn[0] |= (unsigned int)b;
-        pn[1] |= (unsigned int)(b >> 32);
+        pn[0] |= b;
         return *this;
     }
 
@@ -137,16 +133,24 @@ public:
         uint64_t carry = 0;
         for (int i = 0; i < WIDTH; i++)
         {
-            uint64_t n = carry + pn[i] + b.pn[i];
-            pn[i] = n & 0xffffffff;
-            carry = n >> 32;
+            uint64_t n = pn[i] + b.pn[i];
+            uint64_t c = n < pn[i];
+            pn[i] = n + carry;
+            carry = c | (pn[i] < n);
         }
         return *this;
     }
 
     base_uint& operator-=(const base_uint& b)
     {
-        *this += -b;
+        uint64_t borrow = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = pn[i] - b.pn[i];
+            uint64_t c = n > pn[i];
+            pn[i] = n - borrow;
+            borrow = c | (pn[i] > n);
+        }
         return *this;
     }
 
@@ -162,7 +166,7 @@ public:
     {
         base_uint b;
         b = b64;
-        *this += -b;
+        *this -= b;
         return *this;
     }
 
@@ -191,7 +195,7 @@ public:
     {
         // prefix operator
         int i = 0;
-        while (--pn[i] == (uint32_t)-1 && i < WIDTH-1)
+        while (--pn[i] == (uint64_t)-1 && i < WIDTH-1)
             i++;
         return *this;
     }
@@ -204,8 +208,23 @@ public:
         return ret;
     }
 
-    int CompareTo(const base_uint& b) const;
-    bool EqualTo(uint64_t b) const;
+    int CompareTo(const base_uint& b) const
+    {
+        for (int i = WIDTH - 1; i >= 0; i--)
+        {
+            if (pn[i] != b.pn[i])
+                return pn[i] < b.pn[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    bool EqualTo(uint64_t b) const
+    {
+        uint64_t diff = pn[0] ^ b;
+        for (int i = 1; i < WIDTH; i++)
+            diff |= pn[i];
+        return diff == 0;
+    }
 
     friend inline const base_uint operator+(const base_uint& a, const base_uint& b) { return base_uint(a) += b; }
     friend inline const base_uint operator-(const base_uint& a, const base_uint& b) { return base_uint(a) -= b; }
@@ -244,8 +263,7 @@ public:
 
     uint64_t GetLow64() const
     {
-        assert(WIDTH >= 2);
-        return pn[0] | (uint64_t)pn[1] << 32;
+        return pn[0];
     }
 };
 
@@ -287,4 +305,10 @@ public:
 uint256 ArithToUint256(const arith_uint256 &);
 arith_uint256 UintToArith256(const uint256 &);
 
+/**
+ * Difficulty of a hash relative to a difficulty 1 target, diff1Target / hash,
+ * as pools account for shares. A zero hash has infinite difficulty.
+ */
+double GetHashDifficulty(const uint256 &hash, const arith_uint256 &diff1Target);
+
 #endif // BITCOIN_ARITH_UINT256_H
@@ -0,0 +1,136 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+import (
+	"errors"
+	"sync"
+	"unsafe"
+)
+
+// ErrBatchClosed is returned by a Batch after Close.
+var ErrBatchClosed = errors.New("verushash: batch is closed")
+
+// Batch hashes and checks VerusHash 2b2 block headers many at a time, crossing into C++ once
+// per call. The headers are split across the calling thread and threads-1 native worker
+// threads, each with its own hashing context. A Batch may be used from several goroutines,
+// but their calls run one after another.
+type Batch struct {
+	mu     sync.Mutex
+	native *C.verushash_batch
+
+	// reused between calls. headers are packed into one buffer, because cgo does not allow
+	// passing C++ an array of pointers into Go memory
+	data     []byte
+	lens     []C.int
+	passed   []byte
+	complete []byte
+}
+
+// NewBatch returns a Batch hashing on threads threads, counting the calling one.
+func NewBatch(threads int) *Batch {
+	if threads < 1 {
+		threads = 1
+	}
+	return &Batch{native: C.verushash_batch_new(C.int(threads))}
+}
+
+// Close stops the native worker threads and frees their hashing contexts.
+func (b *Batch) Close() {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.native != nil {
+		C.verushash_batch_free(b.native)
+		b.native = nil
+	}
+}
+
+// HashV2b2 hashes each of headers into dst[32*i:32*i+32], where dst must hold 32 bytes per
+// header. errs, if not nil, must be as long as headers, and gets ErrInvalidHeader for each
+// header that is incomplete or malformed, whose hash is zeroed, and nil for the rest. It
+// returns the number of invalid headers.
+func (b *Batch) HashV2b2(dst []byte, headers [][]byte, errs []error) (int, error) {
+	_, failed, err := b.run(dst, headers, nil, nil, errs)
+	return failed, err
+}
+
+// Verify hashes headers as HashV2b2 does, and sets passed[i] if the hash of header i is at or
+// below its target. targets is nil, or holds a 32 byte little endian target per header. A nil
+// targets, or an all zero target, checks against the header's own nBits. passed must be as
+// long as headers. It returns the number of headers that passed.
+func (b *Batch) Verify(dst []byte, headers [][]byte, targets []byte, passed []bool, errs []error) (int, error) {
+	if len(passed) < len(headers) {
+		panic("verushash: passed shorter than headers")
+	}
+	nPassed, _, err := b.run(dst, headers, targets, passed, errs)
+	return nPassed, err
+}
+
+func (b *Batch) run(dst []byte, headers [][]byte, targets []byte, passed []bool, errs []error) (int, int, error) {
+	n := len(headers)
+	if len(dst) < n*HashSize {
+		panic("verushash: destination shorter than 32 bytes per header")
+	}
+	if targets != nil && len(targets) < n*HashSize {
+		panic("verushash: targets shorter than 32 bytes per header")
+	}
+	if errs != nil && len(errs) < n {
+		panic("verushash: errs shorter than headers")
+	}
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.native == nil {
+		return 0, 0, ErrBatchClosed
+	}
+	if n == 0 {
+		return 0, 0, nil
+	}
+
+	b.data = b.data[:0]
+	b.lens = b.lens[:0]
+	for _, h := range headers {
+		b.data = append(b.data, h...)
+		b.lens = append(b.lens, C.int(len(h)))
+	}
+	bitmapLen := (n + 7) / 8
+	if cap(b.passed) < bitmapLen {
+		b.passed = make([]byte, bitmapLen)
+		b.complete = make([]byte, bitmapLen)
+	}
+	b.passed = b.passed[:bitmapLen]
+	b.complete = b.complete[:bitmapLen]
+
+	var data, ptargets *C.uchar
+	if len(b.data) > 0 {
+		data = (*C.uchar)(unsafe.Pointer(&b.data[0]))
+	}
+	if targets != nil {
+		ptargets = (*C.uchar)(unsafe.Pointer(&targets[0]))
+	}
+	nPassed := C.verushash_batch_verify(b.native, (*C.uchar)(unsafe.Pointer(&dst[0])), data,
+		&b.lens[0], C.int(n), ptargets,
+		(*C.uchar)(unsafe.Pointer(&b.passed[0])), (*C.uchar)(unsafe.Pointer(&b.complete[0])))
+
+	failed := 0
+	for i := 0; i < n; i++ {
+		ok := b.complete[i>>3]&(1<<uint(i&7)) != 0
+		if !ok {
+			failed++
+		}
+		if errs != nil {
+			if ok {
+				errs[i] = nil
+			} else {
+				errs[i] = ErrInvalidHeader
+			}
+		}
+		if passed != nil {
+			passed[i] = b.passed[i>>3]&(1<<uint(i&7)) != 0
+		}
+	}
+	return int(nPassed), failed, nil
+}
@@ -0,0 +1,469 @@
+/*
+Microbenchmarks for each stage of VerusHash, for comparing builds and hosts.
+
+Every stage runs on every CPU tier this host supports, from the portable kernels up to the
+detected tier, through the same dispatch table the hashers use, and on 1 to --threads threads.
+Each thread has its own hashing context and runs the same number of calls, which is calibrated
+on one thread to take at least --time milliseconds. Haraka and clhash calls are chained on their
+own output, so they measure latency, as in a hash. Cycles are TSC reference cycles, which tick
+at a fixed rate regardless of turbo.
+
+    bench_verushash [--threads N] [--time MS] [--tier NAME] [--stage NAME] [--json FILE]
+
+--json writes the results as JSON to FILE, or to stdout for "-", and the table goes to stderr.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "solutiondata.h"
+#include "streams.h"
+#include "crypto/utilstrencodings.h"
+#include "crypto/verus_context.h"
+#include "crypto/verus_dispatch.h"
+
+#if !defined(__arm__) && !defined(__aarch64__)
+#define BENCH_HAVE_TSC 1
+#endif
+
+// a mined VerusHash 2.2 header, 1487 bytes
+static const char *benchHeaderHex =
+    "040001006ed1c1e38657e43e71889c0b4e437cf4fc58d9dcf1281b860dfd7db3aa09b721f7dcb0d1664d4ab721a0346a"
+    "09e61c38519409f3bf54b8152be2e8b3caa60f86c1dd7f0bf30733660b849e233d8c378264524e7cc42dd07ea0e80087"
+    "f853311269d7a764a7f1011d0010000000000000000000000000000000000000000000000000000000000000fd400507"
+    "000000000104007e12ef7050ff3bb47afc6587c570f52fe304d5bf3704d6b023896938373cc6c9730619f48abfe02da6"
+    "09bc877c7dd7bc33fe45c322a4d0e176cda9503110fe17a6ef9ea235635e328124ff3429db9f9e91b64e2d9188de3a15"
+    "253dce2e173db0cbd9080504de7c3883219dc2a4ef50b1cd1f44e0010000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "00000000000000000000000000000000000000000000000000000000000000000010000000000000fe09fd4e663700";
+
+// the protocol version the library deserializes headers with
+static const int BENCH_PROTOCOL_VERSION = 170009;
+
+// offset of nTime in a serialized header, which stays in the hash when the non-canonical
+// fields are cleared, so varying it gives every call a new key
+static const size_t HEADER_TIME_OFFSET = 100;
+
+// results of every stage end up here, so the calls cannot be optimized away
+static std::atomic<uint64_t> benchSink(0);
+
+static inline uint64_t ReadTSC()
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// everything a stage needs on one thread, set up before timing starts
+struct CBenchState
+{
+    CVerusHashContext context;
+    const verus_kernels *kernels;
+    alignas(64) unsigned char buf[2][64];
+    alignas(32) unsigned char seed[32];
+    unsigned char *key;
+    uint64_t keyMask;
+    __m128i **pMoveScratch;
+    std::vector<unsigned char> header;
+    CBlockHeader blockHeader;
+    uint64_t sink;
+
+    CBenchState() : kernels(GetVerusKernels()), sink(0)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            buf[0][i] = i;
+            buf[1][i] = 0;
+        }
+        memset(seed, 0x5a, sizeof(seed));
+        key = context.GetKey();
+        keyMask = verusclhasher::keymask(VERUSKEYSIZE);
+        pMoveScratch = (__m128i **)(key + VERUSKEYSIZE + keyMask + 1);
+        CVerusHashV2::GenNewCLKey(seed, key, context.GetDescr());
+
+        header = ParseHex(benchHeaderHex);
+        CDataStream s((const char *)header.data(), (const char *)header.data() + header.size(), SER_NETWORK, BENCH_PROTOCOL_VERSION);
+        s >> blockHeader;
+    }
+};
+
+typedef void (*BenchFunction)(CBenchState &state, uint64_t count);
+
+static void BenchHaraka512(CBenchState &state, uint64_t count)
+{
+    void (*haraka512)(unsigned char *, const unsigned char *) = state.kernels->haraka512;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        (*haraka512)(state.buf[(i + 1) & 1], state.buf[i & 1]);
+    }
+    state.sink += state.buf[count & 1][0];
+}
+
+static void BenchHaraka512Keyed(CBenchState &state, uint64_t count)
+{
+    void (*haraka512keyed)(unsigned char *, const unsigned char *, const u128 *) = state.kernels->haraka512_keyed;
+    const u128 *rc = (const u128 *)state.key;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        (*haraka512keyed)(state.buf[(i + 1) & 1], state.buf[i & 1], rc + (i & 0x1ff));
+    }
+    state.sink += state.buf[count & 1][0];
+}
+
+static void BenchHaraka256(CBenchState &state, uint64_t count)
+{
+    void (*haraka256)(unsigned char *, const unsigned char *) = state.kernels->haraka256;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        (*haraka256)(state.buf[(i + 1) & 1], state.buf[i & 1]);
+    }
+    state.sink += state.buf[count & 1][0];
+}
+
+template <int clhashVersion>
+static void BenchCLHash(CBenchState &state, uint64_t count)
+{
+    uint64_t (*clhash)(void *, const unsigned char *, uint64_t, __m128i **) = state.kernels->verusclhash[clhashVersion];
+    for (uint64_t i = 0; i < count; i++)
+    {
+        // the key is not restored between calls, which changes its contents but not the work
+        uint64_t intermediate = (*clhash)(state.key, state.buf[0], state.keyMask, state.pMoveScratch);
+        memcpy(state.buf[0] + 32, &intermediate, sizeof(intermediate));
+    }
+    state.sink += state.buf[0][32];
+}
+
+static void BenchGenNewCLKey(CBenchState &state, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        // a new seed each call, so the whole key is generated
+        (*(uint64_t *)state.seed)++;
+        CVerusHashV2::GenNewCLKey(state.seed, state.key, state.context.GetDescr());
+    }
+    state.sink += state.key[0];
+}
+
+static void BenchDeserialize(CBenchState &state, uint64_t count)
+{
+    const char *pbegin = (const char *)state.header.data();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        CBlockHeader bh;
+        CDataStream s(pbegin, pbegin + state.header.size(), SER_NETWORK, BENCH_PROTOCOL_VERSION);
+        s >> bh;
+        state.sink += bh.nSolution.size();
+    }
+}
+
+static void BenchGetVerusV2Hash(CBenchState &state, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        state.blockHeader.nTime++;
+        state.sink += *state.blockHeader.GetVerusV2Hash(state.context).begin();
+    }
+}
+
+static void BenchGetVerusV2HashRaw(CBenchState &state, uint64_t count)
+{
+    uint256 hash;
+    unsigned char *ptime = state.header.data() + HEADER_TIME_OFFSET;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        ptime[0]++;
+        ptime[1] += !ptime[0];
+        CBlockHeader::GetVerusV2Hash(state.header.data(), state.header.size(), state.context, hash);
+        state.sink += *hash.begin();
+    }
+}
+
+static const struct
+{
+    const char *name;
+    BenchFunction function;
+} benchStages[] = {
+    { "haraka512", BenchHaraka512 },
+    { "haraka512_keyed", BenchHaraka512Keyed },
+    { "haraka256", BenchHaraka256 },
+    { "verusclhash_v2", BenchCLHash<VERUS_CLHASH_V2> },
+    { "verusclhash_v2_1", BenchCLHash<VERUS_CLHASH_V2_1> },
+    { "verusclhash_v2_2", BenchCLHash<VERUS_CLHASH_V2_2> },
+    { "GenNewCLKey", BenchGenNewCLKey },
+    { "deserialize", BenchDeserialize },
+    { "GetVerusV2Hash", BenchGetVerusV2Hash },
+    { "GetVerusV2Hash_raw", BenchGetVerusV2HashRaw },
+};
+
+struct CBenchResult
+{
+    const char *stage;
+    int tier;
+    int threads;
+    uint64_t calls;             // per thread
+    double seconds;             // wall time for all threads
+    double nsPerCall;           // per thread, the latency of one call
+    double cyclesPerCall;
+    double callsPerSecond;      // all threads together
+    double scaling;             // callsPerSecond over threads times the one thread rate
+};
+
+// runs count calls of a stage on each of nThreads threads, timing from when every thread is
+// set up to when the last one finishes
+static CBenchResult RunStage(BenchFunction function, int nThreads, uint64_t count)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<double> seconds(nThreads);
+    std::vector<uint64_t> cycles(nThreads);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < nThreads; i++)
+    {
+        threads.emplace_back([&, i]() {
+            CBenchState state;
+            ready++;
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            auto start = std::chrono::steady_clock::now();
+            uint64_t startTSC = ReadTSC();
+            (*function)(state, count);
+            cycles[i] = ReadTSC() - startTSC;
+            seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            benchSink += state.sink;
+        });
+    }
+    while (ready.load() < nThreads)
+    {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double threadSeconds = 0, threadCycles = 0;
+    for (int i = 0; i < nThreads; i++)
+    {
+        threadSeconds += seconds[i];
+        threadCycles += cycles[i];
+    }
+
+    CBenchResult result;
+    result.stage = NULL;
+    result.tier = GetVerusCPUTier();
+    result.threads = nThreads;
+    result.calls = count;
+    result.seconds = wall;
+    result.nsPerCall = threadSeconds * 1e9 / ((double)count * nThreads);
+    result.cyclesPerCall = threadCycles / ((double)count * nThreads);
+    result.callsPerSecond = (double)count * nThreads / wall;
+    result.scaling = 1.0;
+    return result;
+}
+
+// doubles the calls on one thread until they take at least minSeconds
+static uint64_t Calibrate(BenchFunction function, double minSeconds)
+{
+    uint64_t count = 16;
+    while (true)
+    {
+        CBenchResult result = RunStage(function, 1, count);
+        if (result.seconds >= minSeconds || count >= (1ULL << 40))
+        {
+            return count;
+        }
+        double scale = result.seconds > 0 ? minSeconds / result.seconds * 1.2 : 16;
+        count = (uint64_t)(count * (scale < 2 ? 2 : scale > 16 ? 16 : scale));
+    }
+}
+
+static void WriteJSON(FILE *f, const std::vector<CBenchResult> &results)
+{
+    fprintf(f, "{\n");
+    fprintf(f, "  \"host\": {\n");
+    fprintf(f, "    \"detected_tier\": \"%s\",\n", GetVerusCPUTierName(DetectVerusCPUTier()));
+    fprintf(f, "    \"sha_ni\": %s,\n", GetVerusKernels()->sha256shani ? "true" : "false");
+    fprintf(f, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+#ifdef __VERSION__
+    fprintf(f, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(f, "    \"tsc\": %s\n", ReadTSC() ? "true" : "false");
+    fprintf(f, "  },\n");
+    fprintf(f, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const CBenchResult &r = results[i];
+        fprintf(f, "%s\n    {\"stage\": \"%s\", \"tier\": \"%s\", \"port\": %s, \"threads\": %d, \"calls_per_thread\": %llu, "
+                   "\"seconds\": %.6f, \"ns_per_call\": %.3f, \"cycles_per_call\": %.1f, \"ns_per_hash\": %.3f, "
+                   "\"hashes_per_second\": %.1f, "
+                   "\"scaling\": %.3f}",
+                i ? "," : "", r.stage, GetVerusCPUTierName(r.tier), r.tier == VERUS_TIER_PORTABLE ? "true" : "false",
+                r.threads, (unsigned long long)r.calls, r.seconds, r.nsPerCall, r.cyclesPerCall,
+                1e9 / r.callsPerSecond, r.callsPerSecond, r.scaling);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+static int TierFromName(const char *name)
+{
+    for (int tier = 0; tier < VERUS_TIER_COUNT; tier++)
+    {
+        if (!strcmp(name, GetVerusCPUTierName(tier)))
+        {
+            return tier;
+        }
+    }
+    return atoi(name);
+}
+
+static void Usage()
+{
+    fprintf(stderr, "usage: bench_verushash [--threads N] [--time MS] [--tier NAME] [--stage NAME] [--json FILE]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = std::thread::hardware_concurrency();
+    double minSeconds = 0.1;
+    int onlyTier = -1;
+    const char *onlyStage = NULL;
+    const char *jsonFile = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            Usage();
+        }
+        if (!strcmp(argv[i], "--threads"))
+        {
+            maxThreads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--time"))
+        {
+            minSeconds = atof(argv[++i]) / 1000;
+        }
+        else if (!strcmp(argv[i], "--tier"))
+        {
+            onlyTier = TierFromName(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--stage"))
+        {
+            onlyStage = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--json"))
+        {
+            jsonFile = argv[++i];
+        }
+        else
+        {
+            Usage();
+        }
+    }
+    if (maxThreads < 1)
+    {
+        maxThreads = 1;
+    }
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n <<= 1)
+    {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(maxThreads);
+
+    FILE *table = jsonFile && !strcmp(jsonFile, "-") ? stderr : stdout;
+    fprintf(table, "%-20s %-10s %7s %12s %12s %14s %8s\n", "stage", "tier", "threads", "ns/call", "cycles/call", "hashes/s", "scaling");
+
+    std::vector<CBenchResult> results;
+    int detected = DetectVerusCPUTier();
+    for (int tier = VERUS_TIER_PORTABLE; tier <= detected; tier++)
+    {
+        if (onlyTier >= 0 && tier != onlyTier)
+        {
+            continue;
+        }
+        // the hashers pick their kernels up from the table when initialized
+        ForceVerusCPUTier(tier);
+        CVerusHash::init();
+        CVerusHashV2::init();
+
+        for (const auto &stage : benchStages)
+        {
+            if (onlyStage && strcmp(onlyStage, stage.name))
+            {
+                continue;
+            }
+            uint64_t count = Calibrate(stage.function, minSeconds);
+            double baseRate = 0;
+            for (int nThreads : threadCounts)
+            {
+                CBenchResult result = RunStage(stage.function, nThreads, count);
+                result.stage = stage.name;
+                if (nThreads == 1)
+                {
+                    baseRate = result.callsPerSecond;
+                }
+                result.scaling = baseRate > 0 ? result.callsPerSecond / (baseRate * nThreads) : 0;
+                fprintf(table, "%-20s %-10s %7d %12.2f %12.1f %14.0f %8.3f\n", result.stage, GetVerusCPUTierName(tier),
+                        nThreads, result.nsPerCall, result.cyclesPerCall, result.callsPerSecond, result.scaling);
+                fflush(table);
+                results.push_back(result);
+            }
+        }
+    }
+    ForceVerusCPUTier(-1);
+
+    if (jsonFile)
+    {
+        FILE *f = strcmp(jsonFile, "-") ? fopen(jsonFile, "w") : stdout;
+        if (!f)
+        {
+            fprintf(stderr, "ERROR: cannot open %s\n", jsonFile);
+            return 1;
+        }
+        WriteJSON(f, results);
+        if (f != stdout)
+        {
+            fclose(f);
+        }
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 
 // #include "primitives/block.h"
 
+#include "crypto/common.h"
 #include "crypto/utilstrencodings.h"
 #include "solutiondata.h"
 
@@ -113,6 +114,74 @@ int32_t CBlockHeader::GetPBaaSHeader(CPBaaSBlockHeader &pbh, const uint160 &cID)
 }
 
 
+// offsets of the fields of a serialized header, and of the fields within the solution descriptor
+// at the start of its solution
+enum {
+    HEADER_PREVBLOCK_OFFSET = 4,
+    HEADER_TIME_OFFSET = 100,
+    HEADER_BITS_OFFSET = 104,
+    HEADER_SOLUTION_OFFSET = CBlockHeader::HEADER_SIZE,
+    DESCRIPTOR_MMRROOTS_OFFSET = 8,
+    DESCRIPTOR_MMRROOTS_SIZE = 64
+};
+
+// the layout of nearly every VerusHash 2 header: an Equihash 200,9 sized solution, after a 3 byte
+// compact size of 0xfd 0x40 0x05
+enum {
+    HEADER_FULL_SOLUTION_SIZE = 1344,
+    HEADER_FULL_SOLUTION_OFFSET = HEADER_SOLUTION_OFFSET + 3,
+    HEADER_FULL_SIZE = HEADER_FULL_SOLUTION_OFFSET + HEADER_FULL_SOLUTION_SIZE
+};
+
+// hashes a VerusHash 2 header of the full size layout, serialized in block, which is overwritten
+// with its canonical form, so the whole header goes through the haraka chain in one write
+static void HashFullSizeV2b(unsigned char *block, CVerusHashContext &context, uint256 &hash)
+{
+    const unsigned char *psolution = block + HEADER_FULL_SOLUTION_OFFSET;
+    uint32_t descrVersion = psolution[0] | (psolution[1] << 8) | (psolution[2] << 16) | ((uint32_t)psolution[3] << 24);
+    int solutionVersion = CConstVerusSolutionVector::activationHeight.ActiveVersion(0x7fffffff) > 0 ? descrVersion : 0;
+
+    // everything but the version, time and solution is cleared, as in ClearNonCanonicalData
+    memset(block + HEADER_PREVBLOCK_OFFSET, 0, HEADER_TIME_OFFSET - HEADER_PREVBLOCK_OFFSET);
+    memset(block + HEADER_BITS_OFFSET, 0, HEADER_SOLUTION_OFFSET - HEADER_BITS_OFFSET);
+    if (descrVersion >= CConstVerusSolutionVector::activationHeight.ACTIVATE_PBAAS_HEADER)
+    {
+        memset(block + HEADER_FULL_SOLUTION_OFFSET + DESCRIPTOR_MMRROOTS_OFFSET, 0, DESCRIPTOR_MMRROOTS_SIZE);
+    }
+
+    CVerusHashV2 &vh2 = context.GetHasher(solutionVersion);
+    vh2.Reset();
+    vh2.Write(block, HEADER_FULL_SIZE);
+    vh2.Finalize2b(hash.begin());
+}
+
+// hashes a VerusHash 2 header with a full size solution without copying it to clear it or
+// serializing it field by field. returns false for any other layout, to go the generic way
+static bool GetFullSizeV2bHash(const CBlockHeader &bh, CVerusHashContext &context, uint256 &hash)
+{
+    if (bh.nSolution.size() != HEADER_FULL_SOLUTION_SIZE)
+    {
+        return false;
+    }
+
+    uint64_t start = CVerusStats::IsEnabled() ? CVerusStats::Timestamp() : 0;
+    alignas(32) unsigned char block[HEADER_FULL_SIZE];
+    // the non-canonical fields are cleared by HashFullSizeV2b
+    WriteLE32(block, bh.nVersion);
+    WriteLE32(block + HEADER_TIME_OFFSET, bh.nTime);
+    block[HEADER_SOLUTION_OFFSET] = 0xfd;
+    block[HEADER_SOLUTION_OFFSET + 1] = HEADER_FULL_SOLUTION_SIZE & 0xff;
+    block[HEADER_SOLUTION_OFFSET + 2] = HEADER_FULL_SOLUTION_SIZE >> 8;
+    memcpy(block + HEADER_FULL_SOLUTION_OFFSET, bh.nSolution.data(), HEADER_FULL_SOLUTION_SIZE);
+    if (start)
+    {
+        CVerusStats::Stage(VERUS_STAGE_CLEAR_NONCANONICAL, start);
+    }
+
+    HashFullSizeV2b(block, context, hash);
+    return true;
+}
+
 uint256 CBlockHeader::GetVerusV2Hash() const
 {
     if (hashPrevBlock.IsNull())
@@ -124,6 +193,12 @@ uint256 CBlockHeader::GetVerusV2Hash() const
     {
         if (nVersion == VERUS_V2)
         {
+            uint256 hash;
+            if (GetFullSizeV2bHash(*this, CVerusHashContext::ThreadContext(), hash))
+            {
+                return hash;
+            }
+
             int solutionVersion = CConstVerusSolutionVector::Version(nSolution);
 
             // in order for this to work, the PBaaS hash of the pre-header must match the header data
@@ -135,8 +210,13 @@ uint256 CBlockHeader::GetVerusV2Hash() const
             //    debugPrint = true;
             //    printf("%s: version V5_1 header, pbaasType: %d, CheckNonCanonicalData: %d\n", __func__, pbaasType, CheckNonCanonicalData());
             //}
+            uint64_t start = CVerusStats::IsEnabled() ? CVerusStats::Timestamp() : 0;
             CBlockHeader bh = CBlockHeader(*this);
             bh.ClearNonCanonicalData();
+            if (start)
+            {
+                CVerusStats::Stage(VERUS_STAGE_CLEAR_NONCANONICAL, start);
+            }
             //if (debugPrint)
             //{
             //    printf("%s\n", SerializeVerusHashV2b(bh, solutionVersion).GetHex().c_str());
@@ -151,6 +231,146 @@ uint256 CBlockHeader::GetVerusV2Hash() const
     }
 }
 
+uint256 CBlockHeader::GetVerusV2Hash(CVerusHashContext &context) const
+{
+    if (hashPrevBlock.IsNull())
+    {
+        // always use SHA256D for genesis block
+        return SerializeHash(*this);
+    }
+    else if (nVersion == VERUS_V2)
+    {
+        uint256 hash;
+        if (GetFullSizeV2bHash(*this, context, hash))
+        {
+            return hash;
+        }
+
+        int solutionVersion = CConstVerusSolutionVector::Version(nSolution);
+        uint64_t start = CVerusStats::IsEnabled() ? CVerusStats::Timestamp() : 0;
+        CBlockHeader bh = CBlockHeader(*this);
+        bh.ClearNonCanonicalData();
+        if (start)
+        {
+            CVerusStats::Stage(VERUS_STAGE_CLEAR_NONCANONICAL, start);
+        }
+        return SerializeVerusHashV2b(bh, context, solutionVersion);
+    }
+    else
+    {
+        return SerializeVerusHash(*this);
+    }
+}
+
+// parses the length prefix of the solution as ReadCompactSize does, returning the number of bytes
+// it takes up, or 0 if it is incomplete or would not deserialize
+static size_t ParseCompactSize(const unsigned char *p, size_t avail, uint64_t &nSize)
+{
+    if (!avail)
+    {
+        return 0;
+    }
+    size_t nBytes = *p < 253 ? 1 : *p == 253 ? 3 : *p == 254 ? 5 : 9;
+    if (avail < nBytes)
+    {
+        return 0;
+    }
+    nSize = nBytes == 1 ? *p : 0;
+    for (size_t i = nBytes - 1; i > 0; i--)
+    {
+        nSize = (nSize << 8) | p[i];
+    }
+    if ((nBytes == 3 && nSize < 253) ||
+        (nBytes == 5 && nSize < 0x10000u) ||
+        (nBytes == 9 && nSize < 0x100000000ULL) ||
+        nSize > (uint64_t)MAX_SIZE)
+    {
+        return 0;
+    }
+    return nBytes;
+}
+
+// counts a header that did not deserialize, for returning from GetVerusV2Hash
+static bool DeserializeFailed()
+{
+    if (CVerusStats::IsEnabled())
+    {
+        CVerusStats::Count(VERUS_STAT_DESERIALIZE_FAILURES);
+    }
+    return false;
+}
+
+bool CBlockHeader::GetVerusV2Hash(const unsigned char *pheader, size_t len, CVerusHashContext &context, uint256 &hash)
+{
+    static const unsigned char zeros[HEADER_TIME_OFFSET - HEADER_PREVBLOCK_OFFSET] = {0};
+
+    uint64_t start = CVerusStats::IsEnabled() ? CVerusStats::Timestamp() : 0;
+    uint64_t solutionSize;
+    size_t sizeBytes;
+    if (len < HEADER_SOLUTION_OFFSET ||
+        !(sizeBytes = ParseCompactSize(pheader + HEADER_SOLUTION_OFFSET, len - HEADER_SOLUTION_OFFSET, solutionSize)) ||
+        solutionSize > len - HEADER_SOLUTION_OFFSET - sizeBytes)
+    {
+        return DeserializeFailed();
+    }
+    const unsigned char *psolution = pheader + HEADER_SOLUTION_OFFSET + sizeBytes;
+    size_t headerLen = (psolution - pheader) + solutionSize;
+
+    int32_t nVersion = pheader[0] | (pheader[1] << 8) | (pheader[2] << 16) | ((uint32_t)pheader[3] << 24);
+    if (start)
+    {
+        CVerusStats::Stage(VERUS_STAGE_DESERIALIZE, start);
+    }
+
+    if (!memcmp(pheader + HEADER_PREVBLOCK_OFFSET, zeros, sizeof(uint256)))
+    {
+        // always use SHA256D for genesis block
+        CHash256().Write(pheader, headerLen).Finalize(hash.begin());
+    }
+    else if (nVersion == VERUS_V2 && headerLen == HEADER_FULL_SIZE && sizeBytes == 3)
+    {
+        alignas(32) unsigned char block[HEADER_FULL_SIZE];
+        memcpy(block, pheader, HEADER_FULL_SIZE);
+        HashFullSizeV2b(block, context, hash);
+    }
+    else if (nVersion == VERUS_V2)
+    {
+        if (solutionSize < sizeof(CPBaaSSolutionDescriptor))
+        {
+            return DeserializeFailed();
+        }
+        uint32_t descrVersion = psolution[0] | (psolution[1] << 8) | (psolution[2] << 16) | ((uint32_t)psolution[3] << 24);
+        int solutionVersion = CConstVerusSolutionVector::activationHeight.ActiveVersion(0x7fffffff) > 0 ? descrVersion : 0;
+
+        // everything but the version, time and solution is cleared, as in ClearNonCanonicalData
+        CVerusHashV2 &vh2 = context.GetHasher(solutionVersion);
+        vh2.Reset();
+        vh2.Write(pheader, HEADER_PREVBLOCK_OFFSET);
+        vh2.Write(zeros, HEADER_TIME_OFFSET - HEADER_PREVBLOCK_OFFSET);
+        vh2.Write(pheader + HEADER_TIME_OFFSET, HEADER_BITS_OFFSET - HEADER_TIME_OFFSET);
+        vh2.Write(zeros, HEADER_SOLUTION_OFFSET - HEADER_BITS_OFFSET);
+        if (descrVersion >= CConstVerusSolutionVector::activationHeight.ACTIVATE_PBAAS_HEADER)
+        {
+            const unsigned char *pmmr = psolution + DESCRIPTOR_MMRROOTS_OFFSET;
+            vh2.Write(pheader + HEADER_SOLUTION_OFFSET, pmmr - (pheader + HEADER_SOLUTION_OFFSET));
+            vh2.Write(zeros, DESCRIPTOR_MMRROOTS_SIZE);
+            vh2.Write(pmmr + DESCRIPTOR_MMRROOTS_SIZE, (pheader + headerLen) - (pmmr + DESCRIPTOR_MMRROOTS_SIZE));
+        }
+        else
+        {
+            vh2.Write(pheader + HEADER_SOLUTION_OFFSET, headerLen - HEADER_SOLUTION_OFFSET);
+        }
+        vh2.Finalize2b(hash.begin());
+    }
+    else
+    {
+        CVerusHash vh;
+        vh.Write(pheader, headerLen);
+        vh.Finalize(hash.begin());
+    }
+    return true;
+}
+
 CPBaaSPreHeader::CPBaaSPreHeader(const CBlockHeader &bh)
 {
     hashPrevBlock = bh.hashPrevBlock;
@@ -0,0 +1,17 @@
+# Fails if any of OBJECTS has load time constructors. The ISA variant objects are built with
+# instruction sets the CPU may not have, so nothing in them may run before dispatch picks a
+# tier, see crypto/verus_isa.h.
+#
+# cmake -DOBJDUMP=<objdump> -DOBJECTS=<object>;... -P CheckNoInitArray.cmake
+
+foreach (object ${OBJECTS})
+    execute_process(COMMAND ${OBJDUMP} -h ${object}
+                    OUTPUT_VARIABLE headers
+                    RESULT_VARIABLE result)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${OBJDUMP} -h ${object} failed")
+    endif ()
+    if (headers MATCHES "\\.(init_array|ctors)")
+        message(FATAL_ERROR "${object} has static initializers, which would run its instruction sets at load time")
+    endif ()
+endforeach ()
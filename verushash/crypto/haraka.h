@@ -32,6 +32,8 @@ Optimized Implementations for Haraka256 and Haraka512
 #include "immintrin.h"
 #endif
 
+#include <stddef.h>
+
 #define NUMROUNDS 5
 
 #ifdef _WIN32
@@ -129,4 +131,9 @@ void haraka512_keyed(unsigned char *out, const unsigned char *in, const u128 *rc
 void haraka512_4x(unsigned char *out, const unsigned char *in);
 void haraka512_8x(unsigned char *out, const unsigned char *in);
 
+/* the Haraka512 chain of CVerusHashV2::Write in one call, with the permutation inlined and the
+   chaining value kept in registers. curBuf holds the chaining value followed by curPos bytes of
+   pending input, and gets the same after len more bytes. returns the new pending count */
+size_t verushash2_write(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len);
+
 #endif
@@ -0,0 +1,177 @@
+/*
+Haraka256 and Haraka512 using VAES on zmm registers, for CPUs with VAES, AVX-512F and
+AVX-512VL. A single Haraka512 state fits in one zmm register, so each AES round of all
+four state words is one instruction and MIX4 is one dword permutation. The multi-lane
+kernels hold the same state word of four lanes in each register instead.
+*/
+#include "haraka_vaes.h"
+
+extern u128 rc0[40];
+
+#define LOAD512(src) _mm512_loadu_si512((const void *)(src))
+#define STORE512(dest,src) _mm512_storeu_si512((void *)(dest),src)
+#define BRC512(k, i) _mm512_broadcast_i32x4((k)[i])
+
+#define MIX4_512(s0, s1, s2, s3) \
+  tmp  = _mm512_unpacklo_epi32(s0, s1); \
+  s0 = _mm512_unpackhi_epi32(s0, s1); \
+  s1 = _mm512_unpacklo_epi32(s2, s3); \
+  s2 = _mm512_unpackhi_epi32(s2, s3); \
+  s3 = _mm512_unpacklo_epi32(s0, s2); \
+  s0 = _mm512_unpackhi_epi32(s0, s2); \
+  s2 = _mm512_unpackhi_epi32(s1, tmp); \
+  s1 = _mm512_unpacklo_epi32(s1, tmp);
+
+/* MIX4 of s0..s3 held in one zmm, as the dword each destination dword comes from */
+#define MIX4_PERM512 _mm512_setr_epi32(3, 11, 7, 15, 8, 0, 12, 4, 9, 1, 13, 5, 2, 10, 6, 14)
+
+/* MIX2 of two independent Haraka256 states, one in each 256 bit half */
+#define MIX2_PERM512 _mm512_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15)
+
+static inline void haraka512_avx512_impl(unsigned char *out, const unsigned char *in, const u128 *k) {
+  const __m512i mix = MIX4_PERM512;
+  const __m512i x = LOAD512(in);
+  __m512i s = x;
+  int i;
+
+  for (i = 0; i < 40; i += 8) {
+    s = _mm512_aesenc_epi128(s, LOAD512(k + i));
+    s = _mm512_aesenc_epi128(s, LOAD512(k + i + 4));
+    s = _mm512_permutexvar_epi32(mix, s);
+  }
+
+  // feed forward, then truncate to the high half of s0 and s1 and the low half of s2 and s3
+  s = _mm512_permutexvar_epi64(_mm512_setr_epi64(1, 3, 4, 6, 0, 0, 0, 0), _mm512_xor_si512(s, x));
+  _mm256_storeu_si256((__m256i *)out, _mm512_castsi512_si256(s));
+}
+
+void haraka512_avx512(unsigned char *out, const unsigned char *in) {
+  haraka512_avx512_impl(out, in, rc);
+}
+
+void haraka512_zero_avx512(unsigned char *out, const unsigned char *in) {
+  haraka512_avx512_impl(out, in, rc0);
+}
+
+void haraka512_keyed_avx512(unsigned char *out, const unsigned char *in, const u128 *rc) {
+  haraka512_avx512_impl(out, in, rc);
+}
+
+/* moves between four lanes of 64 bytes and word 0 to 3 of every lane, in either direction */
+#define TRANSPOSE4_512(d0, d1, d2, d3, l0, l1, l2, l3) \
+  t0 = _mm512_shuffle_i64x2(l0, l1, 0x44); \
+  t1 = _mm512_shuffle_i64x2(l0, l1, 0xee); \
+  t2 = _mm512_shuffle_i64x2(l2, l3, 0x44); \
+  t3 = _mm512_shuffle_i64x2(l2, l3, 0xee); \
+  d0 = _mm512_shuffle_i64x2(t0, t2, 0x88); \
+  d1 = _mm512_shuffle_i64x2(t0, t2, 0xdd); \
+  d2 = _mm512_shuffle_i64x2(t1, t3, 0x88); \
+  d3 = _mm512_shuffle_i64x2(t1, t3, 0xdd);
+
+#define LOAD512_4x(s0, s1, s2, s3, src) \
+  TRANSPOSE4_512(s0, s1, s2, s3, LOAD512(src), LOAD512((src) + 64), LOAD512((src) + 128), LOAD512((src) + 192));
+
+#define AES4_512(s0, s1, s2, s3, rci) \
+  s0 = _mm512_aesenc_epi128(s0, BRC512(rc, rci)); \
+  s1 = _mm512_aesenc_epi128(s1, BRC512(rc, rci + 1)); \
+  s2 = _mm512_aesenc_epi128(s2, BRC512(rc, rci + 2)); \
+  s3 = _mm512_aesenc_epi128(s3, BRC512(rc, rci + 3));
+
+/* feed forward, then store the high halves of s0 and s1 followed by the low halves of s2 and s3 for each lane */
+#define TRUNCSTORE_4x(out, s0, s1, s2, s3, src) \
+  LOAD512_4x(x0, x1, x2, x3, src); \
+  t0 = _mm512_unpackhi_epi64(_mm512_xor_si512(s0, x0), _mm512_xor_si512(s1, x1)); \
+  t1 = _mm512_unpacklo_epi64(_mm512_xor_si512(s2, x2), _mm512_xor_si512(s3, x3)); \
+  t2 = _mm512_shuffle_i64x2(t0, t1, 0x44); \
+  t3 = _mm512_shuffle_i64x2(t0, t1, 0xee); \
+  STORE512(out, _mm512_shuffle_i64x2(t2, t2, 0xd8)); \
+  STORE512((out) + 64, _mm512_shuffle_i64x2(t3, t3, 0xd8));
+
+void haraka512_4x_avx512(unsigned char *out, const unsigned char *in) {
+  __m512i a0, a1, a2, a3, x0, x1, x2, x3, t0, t1, t2, t3, tmp;
+  int i;
+
+  LOAD512_4x(a0, a1, a2, a3, in);
+
+  for (i = 0; i < 40; i += 8) {
+    AES4_512(a0, a1, a2, a3, i);
+    AES4_512(a0, a1, a2, a3, i + 4);
+    MIX4_512(a0, a1, a2, a3);
+  }
+
+  TRUNCSTORE_4x(out, a0, a1, a2, a3, in);
+}
+
+void haraka512_8x_avx512(unsigned char *out, const unsigned char *in) {
+  __m512i a0, a1, a2, a3, b0, b1, b2, b3, x0, x1, x2, x3, t0, t1, t2, t3, tmp;
+  int i;
+
+  LOAD512_4x(a0, a1, a2, a3, in);
+  LOAD512_4x(b0, b1, b2, b3, in + 256);
+
+  for (i = 0; i < 40; i += 8) {
+    AES4_512(a0, a1, a2, a3, i);
+    AES4_512(b0, b1, b2, b3, i);
+    AES4_512(a0, a1, a2, a3, i + 4);
+    AES4_512(b0, b1, b2, b3, i + 4);
+    MIX4_512(a0, a1, a2, a3);
+    MIX4_512(b0, b1, b2, b3);
+  }
+
+  TRUNCSTORE_4x(out, a0, a1, a2, a3, in);
+  TRUNCSTORE_4x(out + 128, b0, b1, b2, b3, in + 256);
+}
+
+/* two whole Haraka256 states in each register */
+#define AES2_512(s0, s1, k) \
+  s0 = _mm512_aesenc_epi128(s0, k); \
+  s1 = _mm512_aesenc_epi128(s1, k);
+
+#define RC2_512(i) _mm512_broadcast_i64x4(_mm256_set_m128i(rc[(i) + 1], rc[i]))
+
+void haraka256_4x_avx512(unsigned char *out, const unsigned char *in) {
+  const __m512i mix = MIX2_PERM512;
+  __m512i s0, s1;
+  int i;
+
+  s0 = LOAD512(in);
+  s1 = LOAD512(in + 64);
+
+  for (i = 0; i < 20; i += 4) {
+    AES2_512(s0, s1, RC2_512(i));
+    AES2_512(s0, s1, RC2_512(i + 2));
+    s0 = _mm512_permutexvar_epi32(mix, s0);
+    s1 = _mm512_permutexvar_epi32(mix, s1);
+  }
+
+  STORE512(out, _mm512_xor_si512(s0, LOAD512(in)));
+  STORE512(out + 64, _mm512_xor_si512(s1, LOAD512(in + 64)));
+}
+
+void haraka256_8x_avx512(unsigned char *out, const unsigned char *in) {
+  const __m512i mix = MIX2_PERM512;
+  __m512i s0, s1, s2, s3;
+  int i;
+
+  s0 = LOAD512(in);
+  s1 = LOAD512(in + 64);
+  s2 = LOAD512(in + 128);
+  s3 = LOAD512(in + 192);
+
+  for (i = 0; i < 20; i += 4) {
+    const __m512i k0 = RC2_512(i), k1 = RC2_512(i + 2);
+    AES2_512(s0, s1, k0);
+    AES2_512(s2, s3, k0);
+    AES2_512(s0, s1, k1);
+    AES2_512(s2, s3, k1);
+    s0 = _mm512_permutexvar_epi32(mix, s0);
+    s1 = _mm512_permutexvar_epi32(mix, s1);
+    s2 = _mm512_permutexvar_epi32(mix, s2);
+    s3 = _mm512_permutexvar_epi32(mix, s3);
+  }
+
+  STORE512(out, _mm512_xor_si512(s0, LOAD512(in)));
+  STORE512(out + 64, _mm512_xor_si512(s1, LOAD512(in + 64)));
+  STORE512(out + 128, _mm512_xor_si512(s2, LOAD512(in + 128)));
+  STORE512(out + 192, _mm512_xor_si512(s3, LOAD512(in + 192)));
+}
@@ -58,7 +58,7 @@
 const uint32_t saes_table[4][256] = { saes_data(saes_u0), saes_data(saes_u1), saes_data(saes_u2), saes_data(saes_u3) };
 
 
-static const unsigned char haraka_rc[40][16] = {
+const unsigned char haraka_rc[40][16] = {
     {0x9d, 0x7b, 0x81, 0x75, 0xf0, 0xfe, 0xc5, 0xb2, 0x0a, 0xc0, 0x20, 0xe6, 0x4c, 0x70, 0x84, 0x06},
     {0x17, 0xf7, 0x08, 0x2f, 0xa4, 0x6b, 0x0f, 0x64, 0x6b, 0xa0, 0xf3, 0x88, 0xe1, 0xb4, 0x66, 0x8b},
     {0x14, 0x91, 0x02, 0x9f, 0x60, 0x9d, 0x02, 0xcf, 0x98, 0x84, 0xf2, 0x53, 0x2d, 0xde, 0x02, 0x34},
@@ -408,6 +408,36 @@ void haraka512_port_keyed(unsigned char *out, const unsigned char *in, const u12
     memcpy(out + 24, buf + 48, 8);
 }
 
+void haraka512_port_4x(unsigned char *out, const unsigned char *in)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        haraka512_port(out + (i << 5), in + (i << 6));
+    }
+}
+
+void haraka512_port_8x(unsigned char *out, const unsigned char *in)
+{
+    haraka512_port_4x(out, in);
+    haraka512_port_4x(out + 128, in + 256);
+}
+
+size_t verushash2_write_port(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len)
+{
+    size_t pos = 0;
+
+    while (len - pos >= 32 - curPos) {
+        memcpy(curBuf + 32 + curPos, data + pos, 32 - curPos);
+        pos += 32 - curPos;
+        curPos = 0;
+        /* the permutation is done into a copy of the input, so the output can overwrite it */
+        haraka512_port(curBuf, curBuf);
+    }
+    memcpy(curBuf + 32 + curPos, data + pos, len - pos);
+    return curPos + len - pos;
+}
+
 void haraka512_perm_zero(unsigned char *out, const unsigned char *in) 
 {
     int i, j;
@@ -489,6 +519,21 @@ void haraka256_port(unsigned char *out, const unsigned char *in)
     }
 }
 
+void haraka256_port_4x(unsigned char *out, const unsigned char *in)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        haraka256_port(out + (i << 5), in + (i << 5));
+    }
+}
+
+void haraka256_port_8x(unsigned char *out, const unsigned char *in)
+{
+    haraka256_port_4x(out, in);
+    haraka256_port_4x(out + 128, in + 128);
+}
+
 void haraka256_sk(unsigned char *out, const unsigned char *in)
 {
     int i, j;
@@ -7,6 +7,8 @@
 #include "immintrin.h"
 #endif
 
+#include <stddef.h>
+
 #define NUMROUNDS 5
 
 #ifdef _WIN32
@@ -37,6 +39,9 @@ static inline void mix2_emu(__m128i *s0, __m128i *s1)
 
 typedef unsigned int uint32_t;
 
+/* the AES round as four 32 bit table lookups per column, by the row each byte comes from */
+extern const uint32_t saes_table[4][256];
+
 static inline __m128i _mm_unpacklo_epi32_emu(__m128i a, __m128i b)
 {
     uint32_t result[4];
@@ -64,6 +69,9 @@ static inline __m128i _mm_unpackhi_epi32_emu(__m128i a, __m128i b)
   s1 = _mm_unpackhi_epi32_emu(s0, s1); \
   s0 = tmp;
 
+/* Haraka round constants */
+extern const unsigned char haraka_rc[40][16];
+
 /* load constants */
 void load_constants_port();
 
@@ -90,9 +98,20 @@ void haraka512_perm_zero(unsigned char *out, const unsigned char *in);
 /* Implementation of Haraka-512, using zero key */
 void haraka512_port_zero(unsigned char *out, const unsigned char *in);
 
+/* Haraka-512 on 4 and 8 contiguous 64 byte inputs, layout compatible with haraka512_4x/8x */
+void haraka512_port_4x(unsigned char *out, const unsigned char *in);
+void haraka512_port_8x(unsigned char *out, const unsigned char *in);
+
+/* verushash2_write on haraka512_port */
+size_t verushash2_write_port(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len);
+
 /* Implementation of Haraka-256 */
 void haraka256_port(unsigned char *out, const unsigned char *in);
 
+/* Haraka-256 on 4 and 8 contiguous 32 byte inputs, layout compatible with haraka256_4x/8x */
+void haraka256_port_4x(unsigned char *out, const unsigned char *in);
+void haraka256_port_8x(unsigned char *out, const unsigned char *in);
+
 /* Implementation of Haraka-256 using sk.seed constants */
 void haraka256_sk(unsigned char *out, const unsigned char *in);
 
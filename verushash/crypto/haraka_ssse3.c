@@ -0,0 +1,250 @@
+/*
+Haraka256 and Haraka512 with a software AES on SSSE3, for CPUs without AES-NI. This is the
+vector permute AES of Mike Hamburg's "Accelerating AES with Vector Permute Instructions",
+as used in vpaes: the S-box is computed with pshufb lookups of 4 bit halves in a tower field
+basis, so a round works on all 16 bytes of a block at once with no memory lookup that
+depends on the data.
+
+The state stays in the tower basis from the first round to the last. The MIX steps and
+ShiftRows only move bytes and the basis change is linear, so they commute with it, and the
+round constants are converted once. MixColumns is done with rotations of the S-box output
+and of its double, which comes from its own tables. Every state is independent of the others
+in a round, so the kernels run up to eight AES blocks side by side.
+*/
+#include <string.h>
+
+#include "haraka_ssse3.h"
+
+#include <tmmintrin.h>
+
+#define LOADU(src) _mm_loadu_si128((const u128 *)(src))
+#define STOREU(dest,src) _mm_storeu_si128((u128 *)(dest),src)
+
+static const u128 k_s0F = { 0x0F0F0F0F0F0F0F0FLL, 0x0F0F0F0F0F0F0F0FLL };
+
+/* GF(2^4) inverses, and inverses of the field element a with a fixed factor, with 0x80 for no inverse */
+static const u128 k_inv = { 0x0E05060F0D080180LL, 0x040703090A0B0C02LL };
+static const u128 k_inva = { 0x01040A060F0B0780LL, 0x030D0E0C02050809LL };
+
+/* change into the tower basis, by low and high nibble */
+static const u128 k_iptlo = { (long long)0xC2B2E8985A2A7000ULL, (long long)0xCABAE09052227808ULL };
+static const u128 k_ipthi = { 0x4C01307D317C4D00LL, (long long)0xCD80B1FCB0FDCC81ULL };
+
+/* change back into the standard basis, by low and high nibble */
+static const u128 k_optlo = { (long long)0xFF9F4929D6B66000ULL, (long long)0xF7974121DEBE6808ULL };
+static const u128 k_opthi = { 0x01EDBD5150BCEC00LL, (long long)0xE10D5DB1B05C0CE0ULL };
+
+/* S-box outputs in the tower basis, and the same doubled, from the two halves of the inversion */
+static const u128 k_sb1u = { (long long)0xB19BE18FCB503E00ULL, (long long)0xA5DF7A6E142AF544ULL };
+static const u128 k_sb1t = { 0x3618D415FAE22300LL, 0x3BF7CCC10D2ED9EFLL };
+static const u128 k_sb2u = { (long long)0xE27A93C60B712400ULL, 0x5EB7E955BC982FCDLL };
+static const u128 k_sb2t = { 0x69EB88400AE12900LL, (long long)0xC2A163C8AB82234AULL };
+
+/* ShiftRows, and each byte of a column rotated forward and back by one row */
+static const u128 k_sr = { 0x030E09040F0A0500LL, 0x0B06010C07020D08LL };
+static const u128 k_mcf = { 0x0407060500030201LL, 0x0C0F0E0D080B0A09LL };
+static const u128 k_mcb = { 0x0605040702010003LL, 0x0E0D0C0F0A09080BLL };
+
+/* the S-box affine constant 0x63 in the tower basis, which the round keys absorb */
+static const u128 k_s63 = { 0x5B5B5B5B5B5B5B5BLL, 0x5B5B5B5B5B5B5B5BLL };
+
+/* round constants and zero round constants in the tower basis, with the S-box constant added */
+static u128 rc_ssse3[40];
+static u128 rc0_ssse3[40];
+
+static inline u128 tower_basis(u128 x)
+{
+  u128 lo = _mm_and_si128(x, k_s0F);
+  u128 hi = _mm_srli_epi32(_mm_andnot_si128(k_s0F, x), 4);
+  return _mm_xor_si128(_mm_shuffle_epi8(k_iptlo, lo), _mm_shuffle_epi8(k_ipthi, hi));
+}
+
+static inline u128 standard_basis(u128 x)
+{
+  u128 lo = _mm_and_si128(x, k_s0F);
+  u128 hi = _mm_srli_epi32(_mm_andnot_si128(k_s0F, x), 4);
+  return _mm_xor_si128(_mm_shuffle_epi8(k_optlo, lo), _mm_shuffle_epi8(k_opthi, hi));
+}
+
+static inline u128 round_key(u128 k)
+{
+  return _mm_xor_si128(tower_basis(k), k_s63);
+}
+
+/* one AES round, _mm_aesenc_si128, on a state and key in the tower basis */
+static inline u128 aesenc_ssse3(u128 s, u128 k)
+{
+  u128 i, j, ak, io, jo, a, a2, b;
+
+  s = _mm_shuffle_epi8(s, k_sr);
+
+  // split into the two halves over GF(2^4) and invert
+  i = _mm_srli_epi32(_mm_andnot_si128(k_s0F, s), 4);
+  j = _mm_and_si128(s, k_s0F);
+  ak = _mm_shuffle_epi8(k_inva, j);
+  j = _mm_xor_si128(j, i);
+  io = _mm_xor_si128(_mm_shuffle_epi8(k_inv, i), ak);
+  jo = _mm_xor_si128(_mm_shuffle_epi8(k_inv, j), ak);
+  io = _mm_xor_si128(_mm_shuffle_epi8(k_inv, io), j);
+  jo = _mm_xor_si128(_mm_shuffle_epi8(k_inv, jo), i);
+
+  // S-box output and its double, then MixColumns as 2a0 + 3a1 + a2 + a3 for each row
+  a = _mm_xor_si128(_mm_shuffle_epi8(k_sb1u, io), _mm_shuffle_epi8(k_sb1t, jo));
+  a2 = _mm_xor_si128(_mm_shuffle_epi8(k_sb2u, io), _mm_shuffle_epi8(k_sb2t, jo));
+  b = _mm_xor_si128(a2, _mm_shuffle_epi8(a, k_mcf));
+  a = _mm_xor_si128(_mm_shuffle_epi8(a, k_mcb), _mm_shuffle_epi8(b, k_mcf));
+  return _mm_xor_si128(_mm_xor_si128(a, b), k);
+}
+
+#define MIX2(s0, s1) \
+  tmp = _mm_unpacklo_epi32(s0, s1); \
+  s1 = _mm_unpackhi_epi32(s0, s1); \
+  s0 = tmp;
+
+#define MIX4(s0, s1, s2, s3) \
+  tmp  = _mm_unpacklo_epi32(s0, s1); \
+  s0 = _mm_unpackhi_epi32(s0, s1); \
+  s1 = _mm_unpacklo_epi32(s2, s3); \
+  s2 = _mm_unpackhi_epi32(s2, s3); \
+  s3 = _mm_unpacklo_epi32(s0, s2); \
+  s0 = _mm_unpackhi_epi32(s0, s2); \
+  s2 = _mm_unpackhi_epi32(s1, tmp); \
+  s1 = _mm_unpacklo_epi32(s1, tmp);
+
+void load_constants_ssse3()
+{
+  int i;
+
+  for (i = 0; i < 40; i++) {
+    rc_ssse3[i] = round_key(LOADU(haraka_rc[i]));
+    rc0_ssse3[i] = k_s63;
+  }
+}
+
+/* Haraka256 of lanes contiguous 32 byte inputs, lanes being a constant of at most 4 */
+static inline void haraka256_ssse3_impl(unsigned char *out, const unsigned char *in, int lanes)
+{
+  u128 s[4][2], tmp;
+  int i, j, l;
+
+  for (l = 0; l < lanes; l++) {
+    s[l][0] = tower_basis(LOADU(in + 32 * l));
+    s[l][1] = tower_basis(LOADU(in + 32 * l + 16));
+  }
+
+  for (i = 0; i < 40; i += 8) {
+    for (j = 0; j < 8; j += 4) {
+      for (l = 0; l < lanes; l++) {
+        s[l][0] = aesenc_ssse3(s[l][0], rc_ssse3[(i >> 1) + (j >> 1)]);
+        s[l][1] = aesenc_ssse3(s[l][1], rc_ssse3[(i >> 1) + (j >> 1) + 1]);
+      }
+    }
+    for (l = 0; l < lanes; l++) {
+      MIX2(s[l][0], s[l][1]);
+    }
+  }
+
+  // feed forward
+  for (l = 0; l < lanes; l++) {
+    STOREU(out + 32 * l, _mm_xor_si128(standard_basis(s[l][0]), LOADU(in + 32 * l)));
+    STOREU(out + 32 * l + 16, _mm_xor_si128(standard_basis(s[l][1]), LOADU(in + 32 * l + 16)));
+  }
+}
+
+/* Haraka512 of lanes contiguous 64 byte inputs with the round keys k, lanes being a constant of at most 2 */
+static inline void haraka512_ssse3_impl(unsigned char *out, const unsigned char *in, const u128 *k, int lanes)
+{
+  u128 s[2][4], x, tmp;
+  int i, j, l;
+
+  for (l = 0; l < lanes; l++) {
+    for (j = 0; j < 4; j++) {
+      s[l][j] = tower_basis(LOADU(in + 64 * l + 16 * j));
+    }
+  }
+
+  for (i = 0; i < 40; i += 8) {
+    for (j = 0; j < 8; j++) {
+      for (l = 0; l < lanes; l++) {
+        s[l][j & 3] = aesenc_ssse3(s[l][j & 3], k[i + j]);
+      }
+    }
+    for (l = 0; l < lanes; l++) {
+      MIX4(s[l][0], s[l][1], s[l][2], s[l][3]);
+    }
+  }
+
+  // feed forward, then truncate to the high half of s0 and s1 and the low half of s2 and s3
+  for (l = 0; l < lanes; l++) {
+    for (j = 0; j < 4; j++) {
+      s[l][j] = _mm_xor_si128(standard_basis(s[l][j]), LOADU(in + 64 * l + 16 * j));
+    }
+    x = _mm_unpackhi_epi64(s[l][0], s[l][1]);
+    STOREU(out + 32 * l, x);
+    x = _mm_unpacklo_epi64(s[l][2], s[l][3]);
+    STOREU(out + 32 * l + 16, x);
+  }
+}
+
+void haraka256_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka256_ssse3_impl(out, in, 1);
+}
+
+void haraka256_4x_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka256_ssse3_impl(out, in, 4);
+}
+
+void haraka256_8x_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka256_ssse3_impl(out, in, 4);
+  haraka256_ssse3_impl(out + 128, in + 128, 4);
+}
+
+void haraka512_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka512_ssse3_impl(out, in, rc_ssse3, 1);
+}
+
+void haraka512_zero_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka512_ssse3_impl(out, in, rc0_ssse3, 1);
+}
+
+void haraka512_keyed_ssse3(unsigned char *out, const unsigned char *in, const u128 *rc)
+{
+  u128 k[40];
+  int i;
+
+  for (i = 0; i < 40; i++) {
+    k[i] = round_key(LOADU(rc + i));
+  }
+  haraka512_ssse3_impl(out, in, k, 1);
+}
+
+void haraka512_4x_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka512_ssse3_impl(out, in, rc_ssse3, 2);
+  haraka512_ssse3_impl(out + 64, in + 128, rc_ssse3, 2);
+}
+
+void haraka512_8x_ssse3(unsigned char *out, const unsigned char *in)
+{
+  haraka512_4x_ssse3(out, in);
+  haraka512_4x_ssse3(out + 128, in + 256);
+}
+
+size_t verushash2_write_ssse3(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len)
+{
+  size_t pos = 0;
+
+  while (len - pos >= 32 - curPos) {
+    memcpy(curBuf + 32 + curPos, data + pos, 32 - curPos);
+    pos += 32 - curPos;
+    curPos = 0;
+    haraka512_ssse3(curBuf, curBuf);
+  }
+  memcpy(curBuf + 32 + curPos, data + pos, len - pos);
+  return curPos + len - pos;
+}
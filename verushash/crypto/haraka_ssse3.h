@@ -0,0 +1,30 @@
+/*
+Haraka256 and Haraka512 with AES done in software on SSSE3 byte shuffles, for CPUs
+without AES-NI.
+
+These replace the table based kernels of haraka_portable.c where the CPU has SSSE3. They
+take the same input and output layouts and produce identical output, but run in constant
+time and several AES blocks at once. The round constants must be loaded with
+load_constants_ssse3().
+*/
+#ifndef HARAKA_SSSE3_H_
+#define HARAKA_SSSE3_H_
+
+#include "haraka_portable.h"
+
+/* converts the Haraka round constants to the basis the kernels work in */
+void load_constants_ssse3();
+
+void haraka256_ssse3(unsigned char *out, const unsigned char *in);
+void haraka256_4x_ssse3(unsigned char *out, const unsigned char *in);
+void haraka256_8x_ssse3(unsigned char *out, const unsigned char *in);
+void haraka512_ssse3(unsigned char *out, const unsigned char *in);
+void haraka512_zero_ssse3(unsigned char *out, const unsigned char *in);
+void haraka512_keyed_ssse3(unsigned char *out, const unsigned char *in, const u128 *rc);
+void haraka512_4x_ssse3(unsigned char *out, const unsigned char *in);
+void haraka512_8x_ssse3(unsigned char *out, const unsigned char *in);
+
+/* verushash2_write on haraka512_ssse3 */
+size_t verushash2_write_ssse3(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+Multi-lane Haraka256 and Haraka512 using VAES on ymm registers, for CPUs with VAES
+and AVX2. Each register holds the same 128 bit state word of two lanes, so the round
+and mix steps are the AES-NI ones at twice the width. Single hashes are latency bound
+and gain nothing from the wider registers, so they stay on the AES-NI kernels.
+*/
+#include "haraka_vaes.h"
+
+#define LOAD256(src) _mm256_loadu_si256((const __m256i *)(src))
+#define STORE256(dest,src) _mm256_storeu_si256((__m256i *)(dest),src)
+#define BRC256(i) _mm256_broadcastsi128_si256(rc[i])
+
+/* one AES round of word j across a pair of lanes in each of two registers */
+#define AES_256x2(s0, s1, k) \
+  s0 = _mm256_aesenc_epi128(s0, k); \
+  s1 = _mm256_aesenc_epi128(s1, k);
+
+#define MIX2_256(s) \
+  s = _mm256_permutevar8x32_epi32(s, mix);
+
+#define MIX4_256(s0, s1, s2, s3) \
+  tmp  = _mm256_unpacklo_epi32(s0, s1); \
+  s0 = _mm256_unpackhi_epi32(s0, s1); \
+  s1 = _mm256_unpacklo_epi32(s2, s3); \
+  s2 = _mm256_unpackhi_epi32(s2, s3); \
+  s3 = _mm256_unpacklo_epi32(s0, s2); \
+  s0 = _mm256_unpackhi_epi32(s0, s2); \
+  s2 = _mm256_unpackhi_epi32(s1, tmp); \
+  s1 = _mm256_unpacklo_epi32(s1, tmp);
+
+/* word 0 to 3 of two consecutive 64 byte lanes, one word per register */
+#define LOAD512_PAIR(s0, s1, s2, s3, src) \
+  s0 = _mm256_permute2x128_si256(LOAD256(src), LOAD256((src) + 64), 0x20); \
+  s1 = _mm256_permute2x128_si256(LOAD256(src), LOAD256((src) + 64), 0x31); \
+  s2 = _mm256_permute2x128_si256(LOAD256((src) + 32), LOAD256((src) + 96), 0x20); \
+  s3 = _mm256_permute2x128_si256(LOAD256((src) + 32), LOAD256((src) + 96), 0x31);
+
+/* feed forward and store the truncated 32 byte output of both lanes */
+#define TRUNCSTORE_PAIR(out, s0, s1, s2, s3, src) \
+  LOAD512_PAIR(x0, x1, x2, x3, src); \
+  x0 = _mm256_unpackhi_epi64(_mm256_xor_si256(s0, x0), _mm256_xor_si256(s1, x1)); \
+  x2 = _mm256_unpacklo_epi64(_mm256_xor_si256(s2, x2), _mm256_xor_si256(s3, x3)); \
+  STORE256(out, _mm256_permute2x128_si256(x0, x2, 0x20)); \
+  STORE256((out) + 32, _mm256_permute2x128_si256(x0, x2, 0x31));
+
+/* a whole Haraka256 state in each register */
+void haraka256_4x_vaes(unsigned char *out, const unsigned char *in) {
+  const __m256i mix = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  __m256i s0, s1, s2, s3;
+  int i;
+
+  s0 = LOAD256(in);
+  s1 = LOAD256(in + 32);
+  s2 = LOAD256(in + 64);
+  s3 = LOAD256(in + 96);
+
+  for (i = 0; i < 20; i += 4) {
+    const __m256i k0 = _mm256_set_m128i(rc[i + 1], rc[i]);
+    const __m256i k1 = _mm256_set_m128i(rc[i + 3], rc[i + 2]);
+    AES_256x2(s0, s1, k0);
+    AES_256x2(s2, s3, k0);
+    AES_256x2(s0, s1, k1);
+    AES_256x2(s2, s3, k1);
+    MIX2_256(s0);
+    MIX2_256(s1);
+    MIX2_256(s2);
+    MIX2_256(s3);
+  }
+
+  STORE256(out, _mm256_xor_si256(s0, LOAD256(in)));
+  STORE256(out + 32, _mm256_xor_si256(s1, LOAD256(in + 32)));
+  STORE256(out + 64, _mm256_xor_si256(s2, LOAD256(in + 64)));
+  STORE256(out + 96, _mm256_xor_si256(s3, LOAD256(in + 96)));
+}
+
+void haraka256_8x_vaes(unsigned char *out, const unsigned char *in) {
+  haraka256_4x_vaes(out, in);
+  haraka256_4x_vaes(out + 128, in + 128);
+}
+
+void haraka512_4x_vaes(unsigned char *out, const unsigned char *in) {
+  __m256i a0, a1, a2, a3, b0, b1, b2, b3, x0, x1, x2, x3, tmp;
+  int i;
+
+  LOAD512_PAIR(a0, a1, a2, a3, in);
+  LOAD512_PAIR(b0, b1, b2, b3, in + 128);
+
+  for (i = 0; i < 40; i += 8) {
+    x0 = BRC256(i);
+    x1 = BRC256(i + 1);
+    x2 = BRC256(i + 2);
+    x3 = BRC256(i + 3);
+    AES_256x2(a0, b0, x0);
+    AES_256x2(a1, b1, x1);
+    AES_256x2(a2, b2, x2);
+    AES_256x2(a3, b3, x3);
+    x0 = BRC256(i + 4);
+    x1 = BRC256(i + 5);
+    x2 = BRC256(i + 6);
+    x3 = BRC256(i + 7);
+    AES_256x2(a0, b0, x0);
+    AES_256x2(a1, b1, x1);
+    AES_256x2(a2, b2, x2);
+    AES_256x2(a3, b3, x3);
+    MIX4_256(a0, a1, a2, a3);
+    MIX4_256(b0, b1, b2, b3);
+  }
+
+  TRUNCSTORE_PAIR(out, a0, a1, a2, a3, in);
+  TRUNCSTORE_PAIR(out + 64, b0, b1, b2, b3, in + 128);
+}
+
+void haraka512_8x_vaes(unsigned char *out, const unsigned char *in) {
+  haraka512_4x_vaes(out, in);
+  haraka512_4x_vaes(out + 128, in + 256);
+}
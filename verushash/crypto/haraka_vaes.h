@@ -0,0 +1,29 @@
+/*
+Haraka256 and Haraka512 using VAES on ymm and zmm registers.
+
+The _vaes kernels need VAES and AVX2, the _avx512 kernels need VAES, AVX-512F and
+AVX-512VL. Both use the round constants from haraka.c, which must be loaded with
+load_constants(), and produce output identical to the AES-NI kernels with the same
+input and output layouts.
+*/
+#ifndef HARAKA_VAES_H_
+#define HARAKA_VAES_H_
+
+#include "haraka.h"
+
+/* VAES with AVX2, multi-lane only, 128 bit lanes of ymm registers */
+void haraka256_4x_vaes(unsigned char *out, const unsigned char *in);
+void haraka256_8x_vaes(unsigned char *out, const unsigned char *in);
+void haraka512_4x_vaes(unsigned char *out, const unsigned char *in);
+void haraka512_8x_vaes(unsigned char *out, const unsigned char *in);
+
+/* VAES with AVX-512, 128 bit lanes of zmm registers */
+void haraka256_4x_avx512(unsigned char *out, const unsigned char *in);
+void haraka256_8x_avx512(unsigned char *out, const unsigned char *in);
+void haraka512_avx512(unsigned char *out, const unsigned char *in);
+void haraka512_zero_avx512(unsigned char *out, const unsigned char *in);
+void haraka512_keyed_avx512(unsigned char *out, const unsigned char *in, const u128 *rc);
+void haraka512_4x_avx512(unsigned char *out, const unsigned char *in);
+void haraka512_8x_avx512(unsigned char *out, const unsigned char *in);
+
+#endif
@@ -8,6 +8,18 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/** A SHA-256 block transform, processing a number of consecutive 64-byte chunks. */
+typedef void (*SHA256TransformType)(uint32_t* s, const unsigned char* chunk, size_t blocks);
+
+/** Portable block transform. */
+void SHA256TransformGeneric(uint32_t* s, const unsigned char* chunk, size_t blocks);
+
+/** Block transform using the x86 SHA extensions, see sha256_shani.cpp. */
+void SHA256TransformSHANI(uint32_t* s, const unsigned char* chunk, size_t blocks);
+
+/** Select the block transform used by CSHA256, done by the Verus kernel dispatch table. */
+void SHA256SetTransform(SHA256TransformType transform);
+
 /** A hasher class for SHA-256. */
 class CSHA256
 {
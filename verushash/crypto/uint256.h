@@ -160,8 +160,12 @@ inline uint256 uint256S(const std::string& str)
 }
 
 // Defined here so we have access to it in both primitives/transaction.h and protocol.h.
+// Left out of the ISA variant builds (see verus_isa.h), whose static initializers would run
+// their instruction sets at load time, on CPUs that may not have them.
+#ifndef VERUS_ISA_VARIANT
 /* The placeholder value used for the auth digest of pre-v5 transactions. */
 static const uint256 LEGACY_TX_AUTH_DIGEST =
     uint256S("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+#endif
 
 #endif // BITCOIN_UINT256_H
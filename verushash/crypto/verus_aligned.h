@@ -0,0 +1,56 @@
+/*
+Heap allocation for over-aligned types.
+
+Before C++17, new only aligns to alignof(std::max_align_t), usually 16 bytes, so a type declared
+alignas(32) or alignas(64) can be handed a block that breaks its alignment. A type that is
+allocated with new derives from CAlignedNew<itself>, whose operator new and new[] ask
+posix_memalign for the type's own alignment.
+*/
+#ifndef VERUS_ALIGNED_H_
+#define VERUS_ALIGNED_H_
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+inline void *AllocAligned(size_t size, size_t align)
+{
+    void *p;
+#ifdef _WIN32
+    p = _aligned_malloc(size, align);
+#else
+    if (posix_memalign(&p, align < sizeof(void *) ? sizeof(void *) : align, size))
+    {
+        p = NULL;
+    }
+#endif
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+inline void FreeAligned(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+template <typename T>
+struct CAlignedNew
+{
+    static void *operator new(size_t size) { return AllocAligned(size, alignof(T)); }
+    static void *operator new[](size_t size) { return AllocAligned(size, alignof(T)); }
+    static void operator delete(void *p) { FreeAligned(p); }
+    static void operator delete[](void *p) { FreeAligned(p); }
+};
+
+#endif // VERUS_ALIGNED_H_
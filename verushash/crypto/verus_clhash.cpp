@@ -28,7 +28,6 @@
 #pragma warning (disable : 4146)
 #include <intrin.h>
 #endif
-int __cpuverusoptimized = 0x80;
 
 #if defined(__arm__)  || defined(__aarch64__)
 #include "crypto/sse2neon.h"
@@ -40,6 +39,7 @@ int __cpuverusoptimized = 0x80;
 #define posix_memalign(p, a, s) (((*(p)) = _aligned_malloc((s), (a))), *(p) ?0 :errno)
 #endif
 
+#ifndef VERUS_ISA_VARIANT
 thread_local thread_specific_ptr verusclhasher_key;
 thread_local thread_specific_ptr verusclhasher_descr;
 
@@ -58,6 +58,7 @@ thread_specific_ptr::~thread_specific_ptr() {
     }
 }
 #endif // defined(__APPLE__) || defined(_WIN32)
+#endif // VERUS_ISA_VARIANT
 
 // multiply the length and the some key, no modulo
     static inline __attribute__((always_inline)) __m128i lazyLengthHash(uint64_t keylength, uint64_t length) {
@@ -403,6 +404,19 @@ uint64_t verusclhash_sv2_2(void * random, const unsigned char buf[64], uint64_t
     return precompReduction64(acc);
 }
 
+// the clhash and the final keyed Haraka512 of CVerusHashV2::Finalize2b, for one clhash version
+// fixed at compile time. the entry points below are flattened, so the clhash is inlined too.
+template <__m128i (*clmulrepeat)(__m128i *, const __m128i *, uint64_t, __m128i **)>
+static inline __attribute__((always_inline)) void verushash2b_finish_t(unsigned char hash[32], unsigned char *curBuf, size_t curPos,
+                                                                       void *key, uint64_t keyMask, __m128i **pMoveScratch)
+{
+    __m128i acc = (*clmulrepeat)((__m128i *)key, (const __m128i *)curBuf, keyMask, pMoveScratch);
+    acc = _mm_xor_si128(acc, lazyLengthHash(1024, 64));
+    uint64_t intermediate = precompReduction64(acc);
+    verusclhash_fillextra(curBuf, curPos, intermediate);
+    haraka512_keyed_local(hash, curBuf, (const u128 *)key + (intermediate & (keyMask >> 4)));
+}
+
 __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch)
 {
     const __m128i pbuf_copy[4] = {_mm_xor_si128(buf[0], buf[2]), _mm_xor_si128(buf[1], buf[3]), buf[2], buf[3]};
@@ -684,291 +698,398 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1(__m128i *randomsource,
     return acc;
 }
 
-__m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch)
+// one of the 32 dependent steps of the VerusHash 2.2 clhash, taking and returning the accumulator.
+// the accumulator picks the two key entries the step mutates, which are recorded in the move scratch
+static inline __attribute__((always_inline)) __m128i verusclhash_sv2_2_step(__m128i acc, __m128i *randomsource, const __m128i *pbuf_copy,
+                                                                            uint64_t keyMask, __m128i **&pMoveScratch)
 {
-    const __m128i pbuf_copy[4] = {_mm_xor_si128(buf[0], buf[2]), _mm_xor_si128(buf[1], buf[3]), buf[2], buf[3]};
     const __m128i *pbuf;
+    const uint64_t selector = _mm_cvtsi128_si64(acc);
 
-    // divide key mask by 16 from bytes to __m128i
-    keyMask >>= 4;
+    // get two random locations in the key, which will be mutated and swapped
+    __m128i *prand = randomsource + ((selector >> 5) & keyMask);
+    __m128i *prandex = randomsource + ((selector >> 32) & keyMask);
 
-    // the random buffer must have at least 32 16 byte dwords after the keymask to work with this
-    // algorithm. we take the value from the last element inside the keyMask + 2, as that will never
-    // be used to xor into the accumulator before it is hashed with other values first
-    __m128i acc = _mm_load_si128(randomsource + (keyMask + 2));
+    *(pMoveScratch++) = prand;
+    *(pMoveScratch++) = prandex;        
 
-    for (int64_t i = 0; i < 32; i++)
+    // select random start and order of pbuf processing
+    pbuf = pbuf_copy + (selector & 3);
+
+    switch (selector & 0x1c)
     {
-        const uint64_t selector = _mm_cvtsi128_si64(acc);
+        case 0:
+        {
+            const __m128i temp1 = _mm_load_si128(prandex);
+            const __m128i temp2 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
+            const __m128i add1 = _mm_xor_si128(temp1, temp2);
+            const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
+            acc = _mm_xor_si128(clprod1, acc);
+
+            const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
+            const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
+
+            const __m128i temp12 = _mm_load_si128(prand);
+            _mm_store_si128(prand, tempa2);
+
+            const __m128i temp22 = _mm_load_si128(pbuf);
+            const __m128i add12 = _mm_xor_si128(temp12, temp22);
+            const __m128i clprod12 = _mm_clmulepi64_si128(add12, add12, 0x10);
+            acc = _mm_xor_si128(clprod12, acc);
+
+            const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
+            const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
+            _mm_store_si128(prandex, tempb2);
+            break;
+        }
+        case 4:
+        {
+            const __m128i temp1 = _mm_load_si128(prand);
+            const __m128i temp2 = _mm_load_si128(pbuf);
+            const __m128i add1 = _mm_xor_si128(temp1, temp2);
+            const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
+            acc = _mm_xor_si128(clprod1, acc);
+            const __m128i clprod2 = _mm_clmulepi64_si128(temp2, temp2, 0x10);
+            acc = _mm_xor_si128(clprod2, acc);
+
+            const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
+            const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
+
+            const __m128i temp12 = _mm_load_si128(prandex);
+            _mm_store_si128(prandex, tempa2);
+
+            const __m128i temp22 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
+            const __m128i add12 = _mm_xor_si128(temp12, temp22);
+            acc = _mm_xor_si128(add12, acc);
+
+            const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
+            const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
+            _mm_store_si128(prand, tempb2);
+            break;
+        }
+        case 8:
+        {
+            const __m128i temp1 = _mm_load_si128(prandex);
+            const __m128i temp2 = _mm_load_si128(pbuf);
+            const __m128i add1 = _mm_xor_si128(temp1, temp2);
+            acc = _mm_xor_si128(add1, acc);
+
+            const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
+            const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
+
+            const __m128i temp12 = _mm_load_si128(prand);
+            _mm_store_si128(prand, tempa2);
+
+            const __m128i temp22 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
+            const __m128i add12 = _mm_xor_si128(temp12, temp22);
+            const __m128i clprod12 = _mm_clmulepi64_si128(add12, add12, 0x10);
+            acc = _mm_xor_si128(clprod12, acc);
+            const __m128i clprod22 = _mm_clmulepi64_si128(temp22, temp22, 0x10);
+            acc = _mm_xor_si128(clprod22, acc);
+
+            const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
+            const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
+            _mm_store_si128(prandex, tempb2);
+            break;
+        }
+        case 0xc:
+        {
+            const __m128i temp1 = _mm_load_si128(prand);
+            const __m128i temp2 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
+            const __m128i add1 = _mm_xor_si128(temp1, temp2);
 
-        // get two random locations in the key, which will be mutated and swapped
-        __m128i *prand = randomsource + ((selector >> 5) & keyMask);
-        __m128i *prandex = randomsource + ((selector >> 32) & keyMask);
+            // cannot be zero here
+            const int32_t divisor = (uint32_t)selector;
 
-        *(pMoveScratch++) = prand;
-        *(pMoveScratch++) = prandex;        
+            acc = _mm_xor_si128(add1, acc);
 
-        // select random start and order of pbuf processing
-        pbuf = pbuf_copy + (selector & 3);
+            const int64_t dividend = _mm_cvtsi128_si64(acc);
+            const __m128i modulo = _mm_cvtsi32_si128(dividend % divisor);
+            acc = _mm_xor_si128(modulo, acc);
 
-        switch (selector & 0x1c)
-        {
-            case 0:
-            {
-                const __m128i temp1 = _mm_load_si128(prandex);
-                const __m128i temp2 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
-                const __m128i add1 = _mm_xor_si128(temp1, temp2);
-                const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
-                acc = _mm_xor_si128(clprod1, acc);
+            const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
+            const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
 
-                const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
-                const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
-
-                const __m128i temp12 = _mm_load_si128(prand);
-                _mm_store_si128(prand, tempa2);
+            if (dividend & 1)
+            {
+                const __m128i temp12 = _mm_load_si128(prandex);
+                _mm_store_si128(prandex, tempa2);
 
                 const __m128i temp22 = _mm_load_si128(pbuf);
                 const __m128i add12 = _mm_xor_si128(temp12, temp22);
                 const __m128i clprod12 = _mm_clmulepi64_si128(add12, add12, 0x10);
                 acc = _mm_xor_si128(clprod12, acc);
+                const __m128i clprod22 = _mm_clmulepi64_si128(temp22, temp22, 0x10);
+                acc = _mm_xor_si128(clprod22, acc);
 
                 const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
                 const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
-                _mm_store_si128(prandex, tempb2);
-                break;
+                _mm_store_si128(prand, tempb2);
             }
-            case 4:
+            else
             {
-                const __m128i temp1 = _mm_load_si128(prand);
-                const __m128i temp2 = _mm_load_si128(pbuf);
-                const __m128i add1 = _mm_xor_si128(temp1, temp2);
-                const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
-                acc = _mm_xor_si128(clprod1, acc);
-                const __m128i clprod2 = _mm_clmulepi64_si128(temp2, temp2, 0x10);
-                acc = _mm_xor_si128(clprod2, acc);
-
-                const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
-                const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
-
-                const __m128i temp12 = _mm_load_si128(prandex);
+                const __m128i tempb3 = _mm_load_si128(prandex);
                 _mm_store_si128(prandex, tempa2);
-
-                const __m128i temp22 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
-                const __m128i add12 = _mm_xor_si128(temp12, temp22);
-                acc = _mm_xor_si128(add12, acc);
-
-                const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
-                const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
-                _mm_store_si128(prand, tempb2);
-                break;
+                _mm_store_si128(prand, tempb3);
+                const __m128i tempb4 = _mm_load_si128(pbuf);
+                acc = _mm_xor_si128(tempb4, acc);
             }
-            case 8:
-            {
-                const __m128i temp1 = _mm_load_si128(prandex);
-                const __m128i temp2 = _mm_load_si128(pbuf);
-                const __m128i add1 = _mm_xor_si128(temp1, temp2);
-                acc = _mm_xor_si128(add1, acc);
+            break;
+        }
+        case 0x10:
+        {
+            // a few AES operations
+            const __m128i *rc = prand;
+            __m128i tmp;
 
-                const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
-                const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
+            __m128i temp1 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
+            __m128i temp2 = _mm_load_si128(pbuf);
 
-                const __m128i temp12 = _mm_load_si128(prand);
-                _mm_store_si128(prand, tempa2);
+            AES2(temp1, temp2, 0);
+            MIX2(temp1, temp2);
 
-                const __m128i temp22 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
-                const __m128i add12 = _mm_xor_si128(temp12, temp22);
-                const __m128i clprod12 = _mm_clmulepi64_si128(add12, add12, 0x10);
-                acc = _mm_xor_si128(clprod12, acc);
-                const __m128i clprod22 = _mm_clmulepi64_si128(temp22, temp22, 0x10);
-                acc = _mm_xor_si128(clprod22, acc);
+            AES2(temp1, temp2, 4);
+            MIX2(temp1, temp2);
 
-                const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
-                const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
-                _mm_store_si128(prandex, tempb2);
-                break;
-            }
-            case 0xc:
-            {
-                const __m128i temp1 = _mm_load_si128(prand);
-                const __m128i temp2 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
-                const __m128i add1 = _mm_xor_si128(temp1, temp2);
+            AES2(temp1, temp2, 8);
+            MIX2(temp1, temp2);
 
-                // cannot be zero here
-                const int32_t divisor = (uint32_t)selector;
+            acc = _mm_xor_si128(temp2, _mm_xor_si128(temp1, acc));
 
-                acc = _mm_xor_si128(add1, acc);
+            const __m128i tempa1 = _mm_load_si128(prand);
+            const __m128i tempa2 = _mm_mulhrs_epi16(acc, tempa1);
+            const __m128i tempa3 = _mm_xor_si128(tempa1, tempa2);
 
-                const int64_t dividend = _mm_cvtsi128_si64(acc);
-                const __m128i modulo = _mm_cvtsi32_si128(dividend % divisor);
-                acc = _mm_xor_si128(modulo, acc);
+            const __m128i tempa4 = _mm_load_si128(prandex);
+            _mm_store_si128(prandex, tempa3);
+            _mm_store_si128(prand, tempa4);
+            break;
+        }
+        case 0x14:
+        {
+            // we'll just call this one the monkins loop, inspired by Chris - modified to cast to uint64_t on shift for more variability in the loop
+            const __m128i *buftmp = pbuf - (((selector & 1) << 1) - 1);
+            __m128i tmp; // used by MIX2
 
-                const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp1);
-                const __m128i tempa2 = _mm_xor_si128(tempa1, temp1);
+            uint64_t rounds = selector >> 61; // loop randomly between 1 and 8 times
+            __m128i *rc = prand;
+            uint64_t aesroundoffset = 0;
+            __m128i onekey;
 
-                if (dividend & 1)
+            do
+            {
+                if (selector & (((uint64_t)0x10000000) << rounds))
                 {
-                    const __m128i temp12 = _mm_load_si128(prandex);
-                    _mm_store_si128(prandex, tempa2);
+                    onekey = _mm_load_si128(rc++);
+                    const __m128i temp2 = _mm_load_si128(rounds & 1 ? pbuf : buftmp);
+                    const __m128i add1 = _mm_xor_si128(onekey, temp2);
+                    const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
+                    acc = _mm_xor_si128(clprod1, acc);
+                }
+                else
+                {
+                    onekey = _mm_load_si128(rc++);
+                    __m128i temp2 = _mm_load_si128(rounds & 1 ? buftmp : pbuf);
+                    AES2(onekey, temp2, aesroundoffset);
+                    aesroundoffset += 4;
+                    MIX2(onekey, temp2);
+                    acc = _mm_xor_si128(onekey, acc);
+                    acc = _mm_xor_si128(temp2, acc);
+                }
+            } while (rounds--);
 
-                    const __m128i temp22 = _mm_load_si128(pbuf);
-                    const __m128i add12 = _mm_xor_si128(temp12, temp22);
-                    const __m128i clprod12 = _mm_clmulepi64_si128(add12, add12, 0x10);
-                    acc = _mm_xor_si128(clprod12, acc);
-                    const __m128i clprod22 = _mm_clmulepi64_si128(temp22, temp22, 0x10);
-                    acc = _mm_xor_si128(clprod22, acc);
+            const __m128i tempa1 = _mm_load_si128(prand);
+            const __m128i tempa2 = _mm_mulhrs_epi16(acc, tempa1);
+            const __m128i tempa3 = _mm_xor_si128(tempa1, tempa2);
 
-                    const __m128i tempb1 = _mm_mulhrs_epi16(acc, temp12);
-                    const __m128i tempb2 = _mm_xor_si128(tempb1, temp12);
-                    _mm_store_si128(prand, tempb2);
+            const __m128i tempa4 = _mm_load_si128(prandex);
+            _mm_store_si128(prandex, tempa3);
+            _mm_store_si128(prand, tempa4);
+            break;
+        }
+        case 0x18:
+        {
+            const __m128i *buftmp = pbuf - (((selector & 1) << 1) - 1);
+            __m128i tmp; // used by MIX2
+
+            uint64_t rounds = selector >> 61; // loop randomly between 1 and 8 times
+            __m128i *rc = prand;
+            __m128i onekey;
+
+            do
+            {
+                if (selector & (((uint64_t)0x10000000) << rounds))
+                {
+                    onekey = _mm_load_si128(rc++);
+                    const __m128i temp2 = _mm_load_si128(rounds & 1 ? pbuf : buftmp);
+                    onekey = _mm_xor_si128(onekey, temp2);
+                    // cannot be zero here, may be negative
+                    const int32_t divisor = (uint32_t)selector;
+                    const int64_t dividend = _mm_cvtsi128_si64(onekey);
+                    const __m128i modulo = _mm_cvtsi32_si128(dividend % divisor);
+                    acc = _mm_xor_si128(modulo, acc);
                 }
                 else
                 {
-                    const __m128i tempb3 = _mm_load_si128(prandex);
-                    _mm_store_si128(prandex, tempa2);
-                    _mm_store_si128(prand, tempb3);
-                    const __m128i tempb4 = _mm_load_si128(pbuf);
-                    acc = _mm_xor_si128(tempb4, acc);
+                    onekey = _mm_load_si128(rc++);
+                    __m128i temp2 = _mm_load_si128(rounds & 1 ? buftmp : pbuf);
+                    const __m128i add1 = _mm_xor_si128(onekey, temp2);
+                    onekey = _mm_clmulepi64_si128(add1, add1, 0x10);
+                    const __m128i clprod2 = _mm_mulhrs_epi16(acc, onekey);
+                    acc = _mm_xor_si128(clprod2, acc);
                 }
-                break;
-            }
-            case 0x10:
-            {
-                // a few AES operations
-                const __m128i *rc = prand;
-                __m128i tmp;
+            } while (rounds--);
 
-                __m128i temp1 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1));
-                __m128i temp2 = _mm_load_si128(pbuf);
+            const __m128i tempa3 = _mm_load_si128(prandex);
+            const __m128i tempa4 = _mm_xor_si128(tempa3, acc);
 
-                AES2(temp1, temp2, 0);
-                MIX2(temp1, temp2);
-
-                AES2(temp1, temp2, 4);
-                MIX2(temp1, temp2);
+            _mm_store_si128(prandex, onekey);
+            _mm_store_si128(prand, tempa4);
+            break;
+        }
+        case 0x1c:
+        {
+            const __m128i temp1 = _mm_load_si128(pbuf);
+            const __m128i temp2 = _mm_load_si128(prandex);
+            const __m128i add1 = _mm_xor_si128(temp1, temp2);
+            const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
+            acc = _mm_xor_si128(clprod1, acc);
+
+            const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp2);
+            const __m128i tempa2 = _mm_xor_si128(tempa1, temp2);
+
+            const __m128i tempa3 = _mm_load_si128(prand);
+            _mm_store_si128(prand, tempa2);
+
+            acc = _mm_xor_si128(tempa3, acc);
+            const __m128i temp4 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1)); 
+            acc = _mm_xor_si128(temp4,acc);  
+            const __m128i tempb1 = _mm_mulhrs_epi16(acc, tempa3);
+            const __m128i tempb2 = _mm_xor_si128(tempb1, tempa3);
+            _mm_store_si128(prandex, tempb2);
+            break;
+        }
+    }
+    return acc;
+}
 
-                AES2(temp1, temp2, 8);
-                MIX2(temp1, temp2);
+__m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch)
+{
+    const __m128i pbuf_copy[4] = {_mm_xor_si128(buf[0], buf[2]), _mm_xor_si128(buf[1], buf[3]), buf[2], buf[3]};
 
-                acc = _mm_xor_si128(temp2, _mm_xor_si128(temp1, acc));
+    // divide key mask by 16 from bytes to __m128i
+    keyMask >>= 4;
 
-                const __m128i tempa1 = _mm_load_si128(prand);
-                const __m128i tempa2 = _mm_mulhrs_epi16(acc, tempa1);
-                const __m128i tempa3 = _mm_xor_si128(tempa1, tempa2);
+    // the random buffer must have at least 32 16 byte dwords after the keymask to work with this
+    // algorithm. we take the value from the last element inside the keyMask + 2, as that will never
+    // be used to xor into the accumulator before it is hashed with other values first
+    __m128i acc = _mm_load_si128(randomsource + (keyMask + 2));
 
-                const __m128i tempa4 = _mm_load_si128(prandex);
-                _mm_store_si128(prandex, tempa3);
-                _mm_store_si128(prand, tempa4);
-                break;
-            }
-            case 0x14:
-            {
-                // we'll just call this one the monkins loop, inspired by Chris - modified to cast to uint64_t on shift for more variability in the loop
-                const __m128i *buftmp = pbuf - (((selector & 1) << 1) - 1);
-                __m128i tmp; // used by MIX2
+    for (int64_t i = 0; i < 32; i++)
+    {
+        acc = verusclhash_sv2_2_step(acc, randomsource, pbuf_copy, keyMask, pMoveScratch);
+    }
+    return acc;
+}
 
-                uint64_t rounds = selector >> 61; // loop randomly between 1 and 8 times
-                __m128i *rc = prand;
-                uint64_t aesroundoffset = 0;
-                __m128i onekey;
+__attribute__((flatten)) void verushash2b_finish(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch)
+{
+    verushash2b_finish_t<__verusclmulwithoutreduction64alignedrepeat>(hash, curBuf, curPos, key, keyMask, pMoveScratch);
+}
 
-                do
-                {
-                    if (selector & (((uint64_t)0x10000000) << rounds))
-                    {
-                        onekey = _mm_load_si128(rc++);
-                        const __m128i temp2 = _mm_load_si128(rounds & 1 ? pbuf : buftmp);
-                        const __m128i add1 = _mm_xor_si128(onekey, temp2);
-                        const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
-                        acc = _mm_xor_si128(clprod1, acc);
-                    }
-                    else
-                    {
-                        onekey = _mm_load_si128(rc++);
-                        __m128i temp2 = _mm_load_si128(rounds & 1 ? buftmp : pbuf);
-                        AES2(onekey, temp2, aesroundoffset);
-                        aesroundoffset += 4;
-                        MIX2(onekey, temp2);
-                        acc = _mm_xor_si128(onekey, acc);
-                        acc = _mm_xor_si128(temp2, acc);
-                    }
-                } while (rounds--);
+__attribute__((flatten)) void verushash2b_finish_sv2_1(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch)
+{
+    verushash2b_finish_t<__verusclmulwithoutreduction64alignedrepeat_sv2_1>(hash, curBuf, curPos, key, keyMask, pMoveScratch);
+}
 
-                const __m128i tempa1 = _mm_load_si128(prand);
-                const __m128i tempa2 = _mm_mulhrs_epi16(acc, tempa1);
-                const __m128i tempa3 = _mm_xor_si128(tempa1, tempa2);
+__attribute__((flatten)) void verushash2b_finish_sv2_2(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch)
+{
+    verushash2b_finish_t<__verusclmulwithoutreduction64alignedrepeat_sv2_2>(hash, curBuf, curPos, key, keyMask, pMoveScratch);
+}
 
-                const __m128i tempa4 = _mm_load_si128(prandex);
-                _mm_store_si128(prandex, tempa3);
-                _mm_store_si128(prand, tempa4);
-                break;
-            }
-            case 0x18:
-            {
-                const __m128i *buftmp = pbuf - (((selector & 1) << 1) - 1);
-                __m128i tmp; // used by MIX2
+// the clhash and final keyed Haraka512 of N VerusHash 2.2 hashes, with the steps of their clhash
+// loops interleaved. the accumulators are independent, so while one lane waits on a clmul, multiply
+// or division, the others have work to issue.
+template <int N>
+static inline __attribute__((always_inline)) void verushash2b_finish_sv2_2_n(struct verushash2b_lane *lanes, uint64_t keyMask)
+{
+    __m128i pbuf_copy[N][4];
+    __m128i *randomsource[N];
+    __m128i **pMoveScratch[N];
+    __m128i acc[N];
+    uint64_t intermediate[N];
 
-                uint64_t rounds = selector >> 61; // loop randomly between 1 and 8 times
-                __m128i *rc = prand;
-                __m128i onekey;
+    // divide key mask by 16 from bytes to __m128i
+    keyMask >>= 4;
 
-                do
-                {
-                    if (selector & (((uint64_t)0x10000000) << rounds))
-                    {
-                        onekey = _mm_load_si128(rc++);
-                        const __m128i temp2 = _mm_load_si128(rounds & 1 ? pbuf : buftmp);
-                        onekey = _mm_xor_si128(onekey, temp2);
-                        // cannot be zero here, may be negative
-                        const int32_t divisor = (uint32_t)selector;
-                        const int64_t dividend = _mm_cvtsi128_si64(onekey);
-                        const __m128i modulo = _mm_cvtsi32_si128(dividend % divisor);
-                        acc = _mm_xor_si128(modulo, acc);
-                    }
-                    else
-                    {
-                        onekey = _mm_load_si128(rc++);
-                        __m128i temp2 = _mm_load_si128(rounds & 1 ? buftmp : pbuf);
-                        const __m128i add1 = _mm_xor_si128(onekey, temp2);
-                        onekey = _mm_clmulepi64_si128(add1, add1, 0x10);
-                        const __m128i clprod2 = _mm_mulhrs_epi16(acc, onekey);
-                        acc = _mm_xor_si128(clprod2, acc);
-                    }
-                } while (rounds--);
+    for (int l = 0; l < N; l++)
+    {
+        const __m128i *buf = (const __m128i *)lanes[l].curBuf;
+        pbuf_copy[l][0] = _mm_xor_si128(buf[0], buf[2]);
+        pbuf_copy[l][1] = _mm_xor_si128(buf[1], buf[3]);
+        pbuf_copy[l][2] = buf[2];
+        pbuf_copy[l][3] = buf[3];
+        randomsource[l] = (__m128i *)lanes[l].key;
+        pMoveScratch[l] = lanes[l].pMoveScratch;
+        acc[l] = _mm_load_si128(randomsource[l] + (keyMask + 2));
+    }
 
-                const __m128i tempa3 = _mm_load_si128(prandex);
-                const __m128i tempa4 = _mm_xor_si128(tempa3, acc);
+    for (int64_t i = 0; i < 32; i++)
+    {
+#pragma GCC unroll 4
+        for (int l = 0; l < N; l++)
+        {
+            acc[l] = verusclhash_sv2_2_step(acc[l], randomsource[l], pbuf_copy[l], keyMask, pMoveScratch[l]);
+        }
+    }
 
-                _mm_store_si128(prandex, onekey);
-                _mm_store_si128(prand, tempa4);
-                break;
-            }
-            case 0x1c:
-            {
-                const __m128i temp1 = _mm_load_si128(pbuf);
-                const __m128i temp2 = _mm_load_si128(prandex);
-                const __m128i add1 = _mm_xor_si128(temp1, temp2);
-                const __m128i clprod1 = _mm_clmulepi64_si128(add1, add1, 0x10);
-                acc = _mm_xor_si128(clprod1, acc);
+    for (int l = 0; l < N; l++)
+    {
+        intermediate[l] = precompReduction64(_mm_xor_si128(acc[l], lazyLengthHash(1024, 64)));
+        verusclhash_fillextra(lanes[l].curBuf, lanes[l].curPos, intermediate[l]);
+    }
+#pragma GCC unroll 4
+    for (int l = 0; l < N; l++)
+    {
+        haraka512_keyed_local(lanes[l].hash, lanes[l].curBuf, (const u128 *)lanes[l].key + (intermediate[l] & keyMask));
+    }
+}
 
-                const __m128i tempa1 = _mm_mulhrs_epi16(acc, temp2);
-                const __m128i tempa2 = _mm_xor_si128(tempa1, temp2);
+void verushash2b_finish_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask)
+{
+    for (int i = 0; i < count; i++)
+    {
+        verushash2b_finish(lanes[i].hash, lanes[i].curBuf, lanes[i].curPos, lanes[i].key, keyMask, lanes[i].pMoveScratch);
+    }
+}
 
-                const __m128i tempa3 = _mm_load_si128(prand);
-                _mm_store_si128(prand, tempa2);
+void verushash2b_finish_sv2_1_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask)
+{
+    for (int i = 0; i < count; i++)
+    {
+        verushash2b_finish_sv2_1(lanes[i].hash, lanes[i].curBuf, lanes[i].curPos, lanes[i].key, keyMask, lanes[i].pMoveScratch);
+    }
+}
 
-                acc = _mm_xor_si128(tempa3, acc);
-                const __m128i temp4 = _mm_load_si128(pbuf - (((selector & 1) << 1) - 1)); 
-                acc = _mm_xor_si128(temp4,acc);  
-                const __m128i tempb1 = _mm_mulhrs_epi16(acc, tempa3);
-                const __m128i tempb2 = _mm_xor_si128(tempb1, tempa3);
-                _mm_store_si128(prandex, tempb2);
-                break;
-            }
-        }
+__attribute__((flatten)) void verushash2b_finish_sv2_2_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask)
+{
+    for (; count >= 4; count -= 4, lanes += 4)
+    {
+        verushash2b_finish_sv2_2_n<4>(lanes, keyMask);
+    }
+    if (count >= 2)
+    {
+        verushash2b_finish_sv2_2_n<2>(lanes, keyMask);
+        count -= 2;
+        lanes += 2;
+    }
+    if (count)
+    {
+        verushash2b_finish_sv2_2_n<1>(lanes, keyMask);
     }
-    return acc;
 }
 
+#ifndef VERUS_ISA_VARIANT
 void *alloc_aligned_buffer(uint64_t bufSize)
 {
     void *answer = NULL;
@@ -981,3 +1102,4 @@ void *alloc_aligned_buffer(uint64_t bufSize)
         return answer;
     }
 }
+#endif // VERUS_ISA_VARIANT
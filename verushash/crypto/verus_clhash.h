@@ -30,8 +30,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
+#include "verus_dispatch.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -84,8 +87,6 @@ struct thread_specific_ptr {
 extern thread_local thread_specific_ptr verusclhasher_key;
 extern thread_local thread_specific_ptr verusclhasher_descr;
 
-extern int __cpuverusoptimized;
-
 __m128i __verusclmulwithoutreduction64alignedrepeat(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
 __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
 __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
@@ -93,36 +94,16 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_port(__m128i *randomsource,
 __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1_port(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
 __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2_port(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
 
+// true on any tier with AES-NI and PCLMULQDQ or their ARM equivalents, see verus_dispatch.h
 inline bool IsCPUVerusOptimized()
 {
-    #if defined(__arm__)  || defined(__aarch64__)
-    long hwcaps= getauxval(AT_HWCAP);
-
-    if((hwcaps & HWCAP_AES) && (hwcaps & HWCAP_PMULL))
-        __cpuverusoptimized = true;
-    else
-        __cpuverusoptimized = false;
-        
-    #else
-    if (__cpuverusoptimized & 0x80)
-    {
-        unsigned int eax,ebx,ecx,edx;
-        if (!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
-        {
-            __cpuverusoptimized = false;
-        }
-        else
-        {
-            __cpuverusoptimized = ((ecx & (bit_AVX | bit_AES | bit_PCLMUL)) == (bit_AVX | bit_AES | bit_PCLMUL));
-        }
-    }
-    #endif
-    return __cpuverusoptimized;
+    return GetVerusCPUTier() >= VERUS_TIER_AESNI;
 };
 
+// selects the best supported tier, or the portable one
 inline void ForceCPUVerusOptimized(bool trueorfalse)
 {
-    __cpuverusoptimized = trueorfalse;
+    ForceVerusCPUTier(trueorfalse ? -1 : VERUS_TIER_PORTABLE);
 };
 
 uint64_t verusclhash(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch);
@@ -133,10 +114,45 @@ uint64_t verusclhash_sv2_1_port(void * random, const unsigned char buf[64], uint
 uint64_t verusclhash_sv2_2_port(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch);
 void *alloc_aligned_buffer(uint64_t bufSize);
 
+// the clhash and final keyed Haraka512 of CVerusHashV2::Finalize2b in one call, with the clhash
+// version fixed and, on the AES-NI tiers, the clhash and Haraka inlined. curBuf holds the chaining
+// value and curPos bytes of input, already filled out to 64 bytes, and key is the key for this
+// hash, with keyMask and pMoveScratch as for verusclhash.
+void verushash2b_finish(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+void verushash2b_finish_sv2_1(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+void verushash2b_finish_sv2_2(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+void verushash2b_finish_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+void verushash2b_finish_sv2_1_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+void verushash2b_finish_sv2_2_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+
+// verushash2b_finish for each of count lanes. the VerusHash 2.2 kernels of the AES-NI tiers run up
+// to 4 lanes in one instruction stream, so their dependent clmul, multiply and AES chains overlap.
+void verushash2b_finish_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+void verushash2b_finish_sv2_1_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+void verushash2b_finish_sv2_2_lanes(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+void verushash2b_finish_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+void verushash2b_finish_sv2_1_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+void verushash2b_finish_sv2_2_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
 
+// fills the 32 - curPos bytes after the pending input in a 64 byte hash buffer with repeated
+// copies of a clhash result, as CVerusHashV2::FillExtra does
+static inline void verusclhash_fillextra(unsigned char *curBuf, size_t curPos, uint64_t intermediate)
+{
+    unsigned char *p = curBuf + 32 + curPos;
+    size_t left = 32 - curPos;
+    do
+    {
+        size_t len = left > sizeof(intermediate) ? sizeof(intermediate) : left;
+        memcpy(p, &intermediate, len);
+        p += len;
+        left -= len;
+    } while (left > 0);
+}
+
 #ifdef __cplusplus
 
 // special high speed hasher for VerusHash 2.0
@@ -145,6 +161,13 @@ struct verusclhasher {
     uint64_t keyMask;
     uint64_t (*verusclhashfunction)(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch);
     __m128i (*verusinternalclhashfunction)(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
+    void (*verushash2bfinishfunction)(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+    void (*verushash2bfinishlanesfunction)(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+
+    // key storage: the key, its refresh copy and the move scratch, keySizeInBytes << 1 bytes in
+    // all, and its description. the calling thread's, unless the hasher was given a context's.
+    unsigned char *key;
+    verusclhash_descr *descr;
 
     static inline uint64_t keymask(uint64_t keysize)
     {
@@ -156,54 +179,36 @@ struct verusclhasher {
         return i ? (((uint64_t)1) << i) - 1 : 0;
     }
 
+    // prepares newly allocated key storage of keySizeInBytes << 1 bytes
+    static inline void initkeystorage(void *keyBuffer, verusclhash_descr *pdesc, uint64_t keySizeInBytes)
+    {
+        // no key is generated yet, so the seed must not match one. an all zero seed comes from
+        // hashing nothing, but the seed is otherwise a Haraka result and never all ones.
+        memset(pdesc->seed.begin(), 0xff, pdesc->seed.size());
+        pdesc->keySizeInBytes = keySizeInBytes;
+        // key restore walks the move scratch, so it must start out empty
+        uint64_t refreshsize = keymask(keySizeInBytes) + 1;
+        memset((unsigned char *)keyBuffer + keySizeInBytes + refreshsize, 0, keySizeInBytes - refreshsize);
+    }
+
+    inline void setfunctions(int solutionVersion)
+    {
+        const verus_kernels *kernels = GetVerusKernels();
+        int clhashVersion = solutionVersion >= SOLUTION_VERUSHHASH_V2_2 ? VERUS_CLHASH_V2_2 :
+                            solutionVersion >= SOLUTION_VERUSHHASH_V2_1 ? VERUS_CLHASH_V2_1 : VERUS_CLHASH_V2;
+        verusclhashfunction = kernels->verusclhash[clhashVersion];
+        verusinternalclhashfunction = kernels->verusclhash_internal[clhashVersion];
+        verushash2bfinishfunction = kernels->verushash2b_finish[clhashVersion];
+        verushash2bfinishlanesfunction = kernels->verushash2b_finish_lanes[clhashVersion];
+    }
+
     // align on 256 bit boundary at end
     verusclhasher(uint64_t keysize=VERUSKEYSIZE, int solutionVersion=SOLUTION_VERUSHHASH_V2) : keySizeInBytes((keysize >> 5) << 5)
     {
 #ifdef __APPLE__
        __tls_init();
 #endif
-        if (IsCPUVerusOptimized())
-        {
-            if (solutionVersion >= SOLUTION_VERUSHHASH_V2_1)
-            {
-                if (solutionVersion >= SOLUTION_VERUSHHASH_V2_2)
-                {
-                    verusclhashfunction = &verusclhash_sv2_2;
-                    verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat_sv2_2;
-                }
-                else
-                {
-                    verusclhashfunction = &verusclhash_sv2_1;
-                    verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat_sv2_1;
-                }
-            }
-            else
-            {
-                verusclhashfunction = &verusclhash;
-                verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat;
-            }
-        }
-        else
-        {
-            if (solutionVersion >= SOLUTION_VERUSHHASH_V2_1)
-            {
-                if (solutionVersion >= SOLUTION_VERUSHHASH_V2_2)
-                {
-                    verusclhashfunction = &verusclhash_sv2_2_port;
-                    verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat_sv2_2_port;
-                }
-                else
-                {
-                    verusclhashfunction = &verusclhash_sv2_1_port;
-                    verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat_sv2_1_port;
-                }
-            }
-            else
-            {
-                verusclhashfunction = &verusclhash_port;
-                verusinternalclhashfunction = &__verusclmulwithoutreduction64alignedrepeat_port;
-            }
-        }
+        setfunctions(solutionVersion);
 
         // if we changed, change it
         if (verusclhasher_key.get() && keySizeInBytes != ((verusclhash_descr *)verusclhasher_descr.get())->keySizeInBytes)
@@ -219,7 +224,7 @@ struct verusclhasher {
             verusclhash_descr *pdesc;
             if (verusclhasher_descr.reset(new verusclhash_descr()), pdesc = (verusclhash_descr *)verusclhasher_descr.get())
             {
-                pdesc->keySizeInBytes = keySizeInBytes;
+                initkeystorage(key, pdesc, keySizeInBytes);
             }
             else
             {
@@ -236,19 +241,28 @@ struct verusclhasher {
             keyMask = 0;
             keySizeInBytes = 0;
         }
+        this->key = (unsigned char *)key;
+        this->descr = (verusclhash_descr *)verusclhasher_descr.get();
 #ifdef VERUSHASHDEBUG
         printf("New hasher, keyMask: %lx, newKeySize: %lx\n", keyMask, keySizeInBytes);
 #endif
     }
 
+    // uses key storage owned by the caller, prepared with initkeystorage
+    verusclhasher(unsigned char *keyBuffer, verusclhash_descr *pdesc, int solutionVersion=SOLUTION_VERUSHHASH_V2) :
+        keySizeInBytes(keyBuffer ? pdesc->keySizeInBytes : 0), key(keyBuffer), descr(pdesc)
+    {
+        setfunctions(solutionVersion);
+        keyMask = keymask(keySizeInBytes);
+    }
+
     inline void *gethasherrefresh()
     {
-        verusclhash_descr *pdesc = (verusclhash_descr *)verusclhasher_descr.get();
-        return (unsigned char *)verusclhasher_key.get() + pdesc->keySizeInBytes;
+        return key + descr->keySizeInBytes;
     }
 
-    // returns a per thread, writeable scratch pad that has enough space to hold a pointer for each
-    // mutated entry in the refresh hash
+    // returns a writeable scratch pad, private to the key storage, that has enough space to hold a
+    // pointer for each mutated entry in the refresh hash
     inline __m128i **getpmovescratch(void *hasherrefresh)
     {
         return (__m128i **)((unsigned char *)hasherrefresh + keyrefreshsize());
@@ -256,7 +270,7 @@ struct verusclhasher {
 
     inline verusclhash_descr *gethasherdescription() const
     {
-        return (verusclhash_descr *)verusclhasher_descr.get();
+        return descr;
     }
 
     inline uint64_t keyrefreshsize() const
@@ -280,19 +294,15 @@ struct verusclhasher {
     // WARNING!! this does not check for NULL ptr, so make sure the buffer is allocated
     inline void *gethashkey()
     {
-        unsigned char *ret = (unsigned char *)verusclhasher_key.get();
-        return fixupkey(ret, *(verusclhash_descr *)verusclhasher_descr.get());
+        return fixupkey(key, *descr);
     }
 
     inline uint64_t operator()(const unsigned char buf[64]) const {
-        unsigned char *pkey = (unsigned char *)verusclhasher_key.get();
-        verusclhash_descr *pdesc = (verusclhash_descr *)verusclhasher_descr.get();
-        return (*verusclhashfunction)(pkey, buf, keyMask, (__m128i **)(pkey + (pdesc->keySizeInBytes + keyrefreshsize())));
+        return (*verusclhashfunction)(key, buf, keyMask, (__m128i **)(key + (descr->keySizeInBytes + keyrefreshsize())));
     }
 
     inline uint64_t operator()(const unsigned char buf[64], void *pkey) const {
-        verusclhash_descr *pdesc = (verusclhash_descr *)verusclhasher_descr.get();
-        return (*verusclhashfunction)(pkey, buf, keyMask, (__m128i **)((unsigned char *)pkey + (pdesc->keySizeInBytes + keyrefreshsize())));
+        return (*verusclhashfunction)(pkey, buf, keyMask, (__m128i **)((unsigned char *)pkey + (descr->keySizeInBytes + keyrefreshsize())));
     }
 
     inline uint64_t operator()(const unsigned char buf[64], void *pkey, __m128i **pMoveScratch) const {
@@ -42,293 +42,155 @@
 #include <intrin.h>
 #endif
 
-void clmul64(uint64_t a, uint64_t b, uint64_t* r)
+// The optimized clhash needs PCLMULQDQ and SSSE3. The functions below stand in for the
+// intrinsics it uses that are not in SSE2, which x86-64 always has and sse2neon provides on ARM,
+// and everything else is the SSE2 intrinsic itself, so the accumulator stays in a register
+// through the loop. Nothing here reads a vector through a pointer to another type, which
+// compilers are free to reorder under strict aliasing.
+
+#if defined(__SIZEOF_INT128__)
+// 64 x 64 bit carry-less multiply with integer multiplies. Each operand is split into five
+// masks of every fifth bit, so each bit of a partial product sums at most 13 bits, and its carries
+// stop before the next bit that mask keeps.
+static inline void clmul64(uint64_t a, uint64_t b, uint64_t *r)
+{
+    typedef unsigned __int128 uint128;
+
+    const uint64_t m0 = 0x1084210842108421ULL, m1 = 0x2108421084210842ULL, m2 = 0x4210842108421084ULL,
+                   m3 = 0x8421084210842108ULL, m4 = 0x0842108421084210ULL;
+    const uint64_t a0 = a & m0, a1 = a & m1, a2 = a & m2, a3 = a & m3, a4 = a & m4;
+    const uint64_t b0 = b & m0, b1 = b & m1, b2 = b & m2, b3 = b & m3, b4 = b & m4;
+
+    const uint128 z0 = ((uint128)a0 * b0) ^ ((uint128)a1 * b4) ^ ((uint128)a2 * b3) ^ ((uint128)a3 * b2) ^ ((uint128)a4 * b1);
+    const uint128 z1 = ((uint128)a0 * b1) ^ ((uint128)a1 * b0) ^ ((uint128)a2 * b4) ^ ((uint128)a3 * b3) ^ ((uint128)a4 * b2);
+    const uint128 z2 = ((uint128)a0 * b2) ^ ((uint128)a1 * b1) ^ ((uint128)a2 * b0) ^ ((uint128)a3 * b4) ^ ((uint128)a4 * b3);
+    const uint128 z3 = ((uint128)a0 * b3) ^ ((uint128)a1 * b2) ^ ((uint128)a2 * b1) ^ ((uint128)a3 * b0) ^ ((uint128)a4 * b4);
+    const uint128 z4 = ((uint128)a0 * b4) ^ ((uint128)a1 * b3) ^ ((uint128)a2 * b2) ^ ((uint128)a3 * b1) ^ ((uint128)a4 * b0);
+
+    // bit 64 is in the masks of bit 4, so the masks of the high word are one over
+    r[0] = ((uint64_t)z0 & m0) ^ ((uint64_t)z1 & m1) ^ ((uint64_t)z2 & m2) ^ ((uint64_t)z3 & m3) ^ ((uint64_t)z4 & m4);
+    r[1] = ((uint64_t)(z0 >> 64) & m1) ^ ((uint64_t)(z1 >> 64) & m2) ^ ((uint64_t)(z2 >> 64) & m3) ^
+           ((uint64_t)(z3 >> 64) & m4) ^ ((uint64_t)(z4 >> 64) & m0);
+}
+#else
+// 64 x 64 bit carry-less multiply with a 4 bit window, for compilers without 128 bit integers
+static inline void clmul64(uint64_t a, uint64_t b, uint64_t *r)
 {
-    uint8_t s = 4,i; //window size
-    uint64_t two_s = 1 << s; //2^s
-    uint64_t smask = two_s-1; //s 1 bits
     uint64_t u[16];
     uint64_t tmp;
-    uint64_t ifmask;
-    //Precomputation
+    int i;
+
     u[0] = 0;
     u[1] = b;
-    for(i = 2 ; i < two_s; i += 2){
-        u[i] = u[i >> 1] << 1; //even indices: left shift
-        u[i + 1] = u[i] ^ b; //odd indices: xor b
+    for (i = 2; i < 16; i += 2)
+    {
+        u[i] = u[i >> 1] << 1;
+        u[i + 1] = u[i] ^ b;
     }
-    //Multiply
-    r[0] = u[a & smask]; //first window only affects lower word
+
+    r[0] = u[a & 15];
     r[1] = 0;
-    for(i = s ; i < 64 ; i += s){
-        tmp = u[a >> i & smask];     
+    for (i = 4; i < 64; i += 4)
+    {
+        tmp = u[a >> i & 15];
         r[0] ^= tmp << i;
         r[1] ^= tmp >> (64 - i);
     }
-    //Repair
-    uint64_t m = 0xEEEEEEEEEEEEEEEE; //s=4 => 16 times 1110
-    for(i = 1 ; i < s ; i++){
-        tmp = ((a & m) >> i);
-        m &= m << 1; //shift mask to exclude all bit j': j' mod s = i
-        ifmask = -((b >> (64-i)) & 1); //if the (64-i)th bit of b is 1
-        r[1] ^= (tmp & ifmask);
-    }
-}
 
-u128 _mm_clmulepi64_si128_emu(const __m128i &a, const __m128i &b, int imm)
-{
-    uint64_t result[2];
-    clmul64(*((uint64_t*)&a + (imm & 1)), *((uint64_t*)&b + ((imm & 0x10) >> 4)), result);
-
-    /*
-    // TEST
-    const __m128i tmp1 = _mm_load_si128(&a);
-    const __m128i tmp2 = _mm_load_si128(&b);
-    imm = imm & 0x11;
-    const __m128i testresult = (imm == 0x10) ? _mm_clmulepi64_si128(tmp1, tmp2, 0x10) : ((imm == 0x01) ? _mm_clmulepi64_si128(tmp1, tmp2, 0x01) : ((imm == 0x00) ? _mm_clmulepi64_si128(tmp1, tmp2, 0x00) : _mm_clmulepi64_si128(tmp1, tmp2, 0x11)));
-    if (!memcmp(&testresult, &result, 16))
+    // the bits of the window entries shifted out of u, for the top 3 bits of b
+    uint64_t m = 0xEEEEEEEEEEEEEEEEULL;
+    for (i = 1; i < 4; i++)
     {
-        printf("_mm_clmulepi64_si128_emu: Portable version passed!\n");
+        tmp = (a & m) >> i;
+        m &= m << 1;
+        r[1] ^= tmp & (0 - ((b >> (64 - i)) & 1));
     }
-    else
-    {
-        printf("_mm_clmulepi64_si128_emu: Portable version failed! a: %lxh %lxl, b: %lxh %lxl, imm: %x, emu: %lxh %lxl, intrin: %lxh %lxl\n", 
-               *((uint64_t *)&a + 1), *(uint64_t *)&a,
-               *((uint64_t *)&b + 1), *(uint64_t *)&b,
-               imm,
-               *((uint64_t *)result + 1), *(uint64_t *)result,
-               *((uint64_t *)&testresult + 1), *(uint64_t *)&testresult);
-        return testresult;
-    }
-    */
-
-    return *(__m128i *)result;
-}
-
-u128 _mm_mulhrs_epi16_emu(__m128i _a, __m128i _b)
-{
-    int16_t result[8];
-    int16_t *a = (int16_t*)&_a, *b = (int16_t*)&_b;
-    for (int i = 0; i < 8; i ++)
-    {
-        result[i] = (int16_t)((((int32_t)(a[i]) * (int32_t)(b[i])) + 0x4000) >> 15);
-    }
-
-    /*
-    const __m128i testresult = _mm_mulhrs_epi16(_a, _b);
-    if (!memcmp(&testresult, &result, 16))
-    {
-        printf("_mm_mulhrs_epi16_emu: Portable version passed!\n");
-    }
-    else
-    {
-        printf("_mm_mulhrs_epi16_emu: Portable version failed! a: %lxh %lxl, b: %lxh %lxl, emu: %lxh %lxl, intrin: %lxh %lxl\n", 
-               *((uint64_t *)&a + 1), *(uint64_t *)&a,
-               *((uint64_t *)&b + 1), *(uint64_t *)&b,
-               *((uint64_t *)result + 1), *(uint64_t *)result,
-               *((uint64_t *)&testresult + 1), *(uint64_t *)&testresult);
-    }
-    */
-
-    return *(__m128i *)result;
-}
-
-inline u128 _mm_set_epi64x_emu(uint64_t hi, uint64_t lo)
-{
-    __m128i result;
-    ((uint64_t *)&result)[0] = lo;
-    ((uint64_t *)&result)[1] = hi;
-    return result;
-}
-
-inline u128 _mm_cvtsi64_si128_emu(uint64_t lo)
-{
-    __m128i result;
-    ((uint64_t *)&result)[0] = lo;
-    ((uint64_t *)&result)[1] = 0;
-    return result;
 }
+#endif
 
-inline int64_t _mm_cvtsi128_si64_emu(const __m128i &a)
+static inline __m128i _mm_clmulepi64_si128_emu(__m128i a, __m128i b, int imm)
 {
-    return *(const int64_t *)&a;
+    uint64_t result[2];
+    clmul64(_mm_cvtsi128_si64(imm & 1 ? _mm_unpackhi_epi64(a, a) : a),
+            _mm_cvtsi128_si64(imm & 0x10 ? _mm_unpackhi_epi64(b, b) : b), result);
+    return _mm_set_epi64x(result[1], result[0]);
 }
 
-inline int32_t _mm_cvtsi128_si32_emu(const __m128i &a)
+static inline __m128i _mm_mulhrs_epi16_emu(__m128i a, __m128i b)
 {
-    return *(const int32_t *)&a;
+    // the 32 bit products, rounded and shifted down
+    const __m128i lo = _mm_mullo_epi16(a, b);
+    const __m128i hi = _mm_mulhi_epi16(a, b);
+    const __m128i round = _mm_set1_epi32(0x4000);
+    __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+    __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+
+    // -32768 * -32768 wraps to -32768, so keep the low 16 bits of each rather than saturating
+    p0 = _mm_srai_epi32(_mm_slli_epi32(p0, 16), 16);
+    p1 = _mm_srai_epi32(_mm_slli_epi32(p1, 16), 16);
+    return _mm_packs_epi32(p0, p1);
 }
 
-inline u128 _mm_cvtsi32_si128_emu(uint32_t lo)
+static inline int64_t _mm_cvtsi128_si64_emu(__m128i a)
 {
-    __m128i result;
-    ((uint32_t *)&result)[0] = lo;
-    ((uint32_t *)&result)[1] = 0;
-    ((uint64_t *)&result)[1] = 0;
-
-    /*
-    const __m128i testresult = _mm_cvtsi32_si128(lo);
-    if (!memcmp(&testresult, &result, 16))
-    {
-        printf("_mm_cvtsi32_si128_emu: Portable version passed!\n");
-    }
-    else
-    {
-        printf("_mm_cvtsi32_si128_emu: Portable version failed!\n");
-    }
-    */
-
-    return result;
+    return _mm_cvtsi128_si64(a);
 }
 
-u128 _mm_setr_epi8_emu(u_char c0, u_char c1, u_char c2, u_char c3, u_char c4, u_char c5, u_char c6, u_char c7, u_char c8, u_char c9, u_char c10, u_char c11, u_char c12, u_char c13, u_char c14, u_char c15)
+static inline __m128i _mm_cvtsi32_si128_emu(uint32_t lo)
 {
-    __m128i result;
-    ((uint8_t *)&result)[0] = c0;
-    ((uint8_t *)&result)[1] = c1;
-    ((uint8_t *)&result)[2] = c2;
-    ((uint8_t *)&result)[3] = c3;
-    ((uint8_t *)&result)[4] = c4;
-    ((uint8_t *)&result)[5] = c5;
-    ((uint8_t *)&result)[6] = c6;
-    ((uint8_t *)&result)[7] = c7;
-    ((uint8_t *)&result)[8] = c8;
-    ((uint8_t *)&result)[9] = c9;
-    ((uint8_t *)&result)[10] = c10;
-    ((uint8_t *)&result)[11] = c11;
-    ((uint8_t *)&result)[12] = c12;
-    ((uint8_t *)&result)[13] = c13;
-    ((uint8_t *)&result)[14] = c14;
-    ((uint8_t *)&result)[15] = c15;
-
-    /*
-    const __m128i testresult = _mm_setr_epi8(c0,c1,c2,c3,c4,c5,c6,c7,c8,c9,c10,c11,c12,c13,c14,c15);
-    if (!memcmp(&testresult, &result, 16))
-    {
-        printf("_mm_setr_epi8_emu: Portable version passed!\n");
-    }
-    else
-    {
-        printf("_mm_setr_epi8_emu: Portable version failed!\n");
-    }
-    */
-
-    return result;
+    return _mm_cvtsi32_si128((int)lo);
 }
 
-inline __m128i _mm_srli_si128_emu(__m128i a, int imm8)
+static inline __m128i _mm_xor_si128_emu(__m128i a, __m128i b)
 {
-    unsigned char result[16];
-    uint8_t shift = imm8 & 0xff;
-    if (shift > 15) shift = 16;
-
-    int i;
-    for (i = 0; i < (16 - shift); i++)
-    {
-        result[i] = ((unsigned char *)&a)[shift + i];
-    }
-    for ( ; i < 16; i++)
-    {
-        result[i] = 0;
-    }
-
-    /*
-    const __m128i tmp1 = _mm_load_si128(&a);
-    __m128i testresult = _mm_srli_si128(tmp1, imm8);
-    if (!memcmp(&testresult, result, 16))
-    {
-        printf("_mm_srli_si128_emu: Portable version passed!\n");
-    }
-    else
-    {
-        printf("_mm_srli_si128_emu: Portable version failed! val: %lx%lx imm: %x emu: %lx%lx, intrin: %lx%lx\n", 
-               *((uint64_t *)&a + 1), *(uint64_t *)&a,
-               imm8,
-               *((uint64_t *)result + 1), *(uint64_t *)result,
-               *((uint64_t *)&testresult + 1), *(uint64_t *)&testresult);
-    }
-    */
-
-    return *(__m128i *)result;
+    return _mm_xor_si128(a, b);
 }
 
-inline __m128i _mm_xor_si128_emu(__m128i a, __m128i b)
+static inline __m128i _mm_load_si128_emu(const void *p)
 {
-#ifdef _WIN32
-    uint64_t result[2];
-    result[0] = *(uint64_t *)&a ^ *(uint64_t *)&b;
-    result[1] = *((uint64_t *)&a + 1) ^ *((uint64_t *)&b + 1);
-    return *(__m128i *)result;
-#else
-    return a ^ b;
-#endif
+    return _mm_load_si128((const __m128i *)p);
 }
 
-inline __m128i _mm_load_si128_emu(const void *p)
+static inline void _mm_store_si128_emu(void *p, __m128i val)
 {
-    return *(__m128i *)p;
+    _mm_store_si128((__m128i *)p, val);
 }
 
-inline void _mm_store_si128_emu(void *p, __m128i val)
+// one AES round, as _mm_aesenc_si128, with the tables of haraka_portable.c
+static inline __m128i aesenc_port(__m128i s, __m128i rk)
 {
-    *(__m128i *)p = val;
+    const uint64_t lo = _mm_cvtsi128_si64(s), hi = _mm_cvtsi128_si64(_mm_unpackhi_epi64(s, s));
+    const uint32_t x0 = (uint32_t)lo, x1 = (uint32_t)(lo >> 32), x2 = (uint32_t)hi, x3 = (uint32_t)(hi >> 32);
+
+    const uint32_t y0 = saes_table[0][x0 & 0xff] ^ saes_table[1][(x1 >> 8) & 0xff] ^ saes_table[2][(x2 >> 16) & 0xff] ^ saes_table[3][x3 >> 24];
+    const uint32_t y1 = saes_table[0][x1 & 0xff] ^ saes_table[1][(x2 >> 8) & 0xff] ^ saes_table[2][(x3 >> 16) & 0xff] ^ saes_table[3][x0 >> 24];
+    const uint32_t y2 = saes_table[0][x2 & 0xff] ^ saes_table[1][(x3 >> 8) & 0xff] ^ saes_table[2][(x0 >> 16) & 0xff] ^ saes_table[3][x1 >> 24];
+    const uint32_t y3 = saes_table[0][x3 & 0xff] ^ saes_table[1][(x0 >> 8) & 0xff] ^ saes_table[2][(x1 >> 16) & 0xff] ^ saes_table[3][x2 >> 24];
+    return _mm_xor_si128(_mm_set_epi32(y3, y2, y1, y0), rk);
 }
 
-__m128i _mm_shuffle_epi8_emu(__m128i a, __m128i b)
-{
-    __m128i result;
-    for (int i = 0; i < 16; i++)
-    {
-        if (((uint8_t *)&b)[i] & 0x80)
-        {
-            ((uint8_t *)&result)[i] = 0;
-        }
-        else
-        {
-            ((uint8_t *)&result)[i] = ((uint8_t *)&a)[((uint8_t *)&b)[i] & 0xf];
-        }
-    }
-
-    /*
-    const __m128i tmp1 = _mm_load_si128(&a);
-    const __m128i tmp2 = _mm_load_si128(&b);
-    __m128i testresult = _mm_shuffle_epi8(tmp1, tmp2);
-    if (!memcmp(&testresult, &result, 16))
-    {
-        printf("_mm_shuffle_epi8_emu: Portable version passed!\n");
-    }
-    else
-    {
-        printf("_mm_shuffle_epi8_emu: Portable version failed!\n");
-    }
-    */
-
-    return result;
-}
+#define AES2_PORT(s0, s1, rci) \
+  s0 = aesenc_port(s0, rc[rci]); \
+  s1 = aesenc_port(s1, rc[rci + 1]); \
+  s0 = aesenc_port(s0, rc[rci + 2]); \
+  s1 = aesenc_port(s1, rc[rci + 3]);
 
 // portable
 static inline __m128i lazyLengthHash_port(uint64_t keylength, uint64_t length) {
-    const __m128i lengthvector = _mm_set_epi64x_emu(keylength,length);
+    const __m128i lengthvector = _mm_set_epi64x(keylength,length);
     const __m128i clprod1 = _mm_clmulepi64_si128_emu( lengthvector, lengthvector, 0x10);
     return clprod1;
 }
 
-// modulo reduction to 64-bit value. The high 64 bits contain garbage, see precompReduction64
-static inline __m128i precompReduction64_si128_port( __m128i A) {
-
-    //const __m128i C = _mm_set_epi64x(1U,(1U<<4)+(1U<<3)+(1U<<1)+(1U<<0)); // C is the irreducible poly. (64,4,3,1,0)
-    const __m128i C = _mm_cvtsi64_si128_emu((1U<<4)+(1U<<3)+(1U<<1)+(1U<<0));
-    __m128i Q2 = _mm_clmulepi64_si128_emu( A, C, 0x01);
-    __m128i Q3 = _mm_shuffle_epi8_emu(_mm_setr_epi8_emu(0, 27, 54, 45, 108, 119, 90, 65, (char)216, (char)195, (char)238, (char)245, (char)180, (char)175, (char)130, (char)153),
-                                  _mm_srli_si128_emu(Q2,8));
-    __m128i Q4 = _mm_xor_si128_emu(Q2,A);
-    const __m128i final = _mm_xor_si128_emu(Q3,Q4);
-    return final;/// WARNING: HIGH 64 BITS SHOULD BE ASSUMED TO CONTAIN GARBAGE
-}
-
+// modulo reduction to 64-bit value
 static inline uint64_t precompReduction64_port( __m128i A) {
-    __m128i tmp = precompReduction64_si128_port(A);
-    return _mm_cvtsi128_si64_emu(tmp);
+    // the irreducible poly. (64,4,3,1,0), and the reduction of the bits of a product with its
+    // low word that land above bit 63
+    static const uint8_t reduce[16] = {0, 27, 54, 45, 108, 119, 90, 65, 216, 195, 238, 245, 180, 175, 130, 153};
+    const uint64_t C = (1U<<4)+(1U<<3)+(1U<<1)+(1U<<0);
+    uint64_t Q2[2];
+    clmul64(_mm_cvtsi128_si64(_mm_unpackhi_epi64(A, A)), C, Q2);
+    return Q2[0] ^ _mm_cvtsi128_si64(A) ^ reduce[Q2[1] & 15];
 }
 
 // verus intermediate hash extra
@@ -502,14 +364,14 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_port(__m128i *randomsource,
                 __m128i temp1 = _mm_load_si128_emu(pbuf - (((selector & 1) << 1) - 1));
                 __m128i temp2 = _mm_load_si128_emu(pbuf);
 
-                AES2_EMU(temp1, temp2, 0);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 0);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 4);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 4);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 8);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 8);
+                MIX2(temp1, temp2);
 
                 acc = _mm_xor_si128_emu(temp1, acc);
                 acc = _mm_xor_si128_emu(temp2, acc);
@@ -553,7 +415,7 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_port(__m128i *randomsource,
                         onekey = _mm_load_si128_emu(rc++);
                         __m128i temp2 = _mm_load_si128_emu(rounds & 1 ? buftmp : pbuf);
                         const uint64_t roundidx = aesround++ << 2;
-                        AES2_EMU(onekey, temp2, roundidx);
+                        AES2_PORT(onekey, temp2, roundidx);
 
                         /*
                         std::cout << " onekey1: " << LEToHex(onekey) << std::endl;
@@ -579,7 +441,7 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_port(__m128i *randomsource,
                         std::cout << " temp22: " << LEToHex(temp2) << std::endl;
                         */
 
-                        MIX2_EMU(onekey, temp2);
+                        MIX2(onekey, temp2);
 
                         /*
                         std::cout << "onekey3: " << LEToHex(onekey) << std::endl;
@@ -798,14 +660,14 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1_port(__m128i *randomso
                 __m128i temp1 = _mm_load_si128_emu(pbuf - (((selector & 1) << 1) - 1));
                 __m128i temp2 = _mm_load_si128_emu(pbuf);
 
-                AES2_EMU(temp1, temp2, 0);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 0);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 4);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 4);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 8);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 8);
+                MIX2(temp1, temp2);
 
                 acc = _mm_xor_si128_emu(temp1, acc);
                 acc = _mm_xor_si128_emu(temp2, acc);
@@ -846,9 +708,9 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1_port(__m128i *randomso
                         onekey = _mm_load_si128_emu(rc++);
                         __m128i temp2 = _mm_load_si128_emu(rounds & 1 ? buftmp : pbuf);
                         const uint64_t roundidx = aesround++ << 2;
-                        AES2_EMU(onekey, temp2, roundidx);
+                        AES2_PORT(onekey, temp2, roundidx);
 
-                        MIX2_EMU(onekey, temp2);
+                        MIX2(onekey, temp2);
 
                         acc = _mm_xor_si128_emu(onekey, acc);
                         acc = _mm_xor_si128_emu(temp2, acc);
@@ -1087,14 +949,14 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2_port(__m128i *randomso
                 __m128i temp1 = _mm_load_si128_emu(pbuf - (((selector & 1) << 1) - 1));
                 __m128i temp2 = _mm_load_si128_emu(pbuf);
 
-                AES2_EMU(temp1, temp2, 0);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 0);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 4);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 4);
+                MIX2(temp1, temp2);
 
-                AES2_EMU(temp1, temp2, 8);
-                MIX2_EMU(temp1, temp2);
+                AES2_PORT(temp1, temp2, 8);
+                MIX2(temp1, temp2);
 
                 acc = _mm_xor_si128_emu(temp1, acc);
                 acc = _mm_xor_si128_emu(temp2, acc);
@@ -1135,9 +997,9 @@ __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2_port(__m128i *randomso
                         onekey = _mm_load_si128_emu(rc++);
                         __m128i temp2 = _mm_load_si128_emu(rounds & 1 ? buftmp : pbuf);
                         const uint64_t roundidx = aesround++ << 2;
-                        AES2_EMU(onekey, temp2, roundidx);
+                        AES2_PORT(onekey, temp2, roundidx);
 
-                        MIX2_EMU(onekey, temp2);
+                        MIX2(onekey, temp2);
 
                         acc = _mm_xor_si128_emu(onekey, acc);
                         acc = _mm_xor_si128_emu(temp2, acc);
@@ -1248,4 +1110,41 @@ uint64_t verusclhash_sv2_2_port(void * random, const unsigned char buf[64], uint
     __m128i  acc = __verusclmulwithoutreduction64alignedrepeat_sv2_2_port(rs64, string, keyMask, pMoveScratch);
     acc = _mm_xor_si128_emu(acc, lazyLengthHash_port(1024, 64));
     return precompReduction64_port(acc);
-}
\ No newline at end of file
+}
+
+// the final Haraka goes through the hasher's keyed Haraka, which is the SSSE3 one where the CPU has it
+void verushash2b_finish_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch) {
+    uint64_t intermediate = verusclhash_port(key, curBuf, keyMask, pMoveScratch);
+    verusclhash_fillextra(curBuf, curPos, intermediate);
+    (*CVerusHashV2::haraka512KeyedFunction)(hash, curBuf, (const u128 *)key + (intermediate & (keyMask >> 4)));
+}
+
+void verushash2b_finish_sv2_1_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch) {
+    uint64_t intermediate = verusclhash_sv2_1_port(key, curBuf, keyMask, pMoveScratch);
+    verusclhash_fillextra(curBuf, curPos, intermediate);
+    (*CVerusHashV2::haraka512KeyedFunction)(hash, curBuf, (const u128 *)key + (intermediate & (keyMask >> 4)));
+}
+
+void verushash2b_finish_sv2_2_port(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch) {
+    uint64_t intermediate = verusclhash_sv2_2_port(key, curBuf, keyMask, pMoveScratch);
+    verusclhash_fillextra(curBuf, curPos, intermediate);
+    (*CVerusHashV2::haraka512KeyedFunction)(hash, curBuf, (const u128 *)key + (intermediate & (keyMask >> 4)));
+}
+
+void verushash2b_finish_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask) {
+    for (int i = 0; i < count; i++) {
+        verushash2b_finish_port(lanes[i].hash, lanes[i].curBuf, lanes[i].curPos, lanes[i].key, keyMask, lanes[i].pMoveScratch);
+    }
+}
+
+void verushash2b_finish_sv2_1_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask) {
+    for (int i = 0; i < count; i++) {
+        verushash2b_finish_sv2_1_port(lanes[i].hash, lanes[i].curBuf, lanes[i].curPos, lanes[i].key, keyMask, lanes[i].pMoveScratch);
+    }
+}
+
+void verushash2b_finish_sv2_2_lanes_port(struct verushash2b_lane *lanes, int count, uint64_t keyMask) {
+    for (int i = 0; i < count; i++) {
+        verushash2b_finish_sv2_2_port(lanes[i].hash, lanes[i].curBuf, lanes[i].curPos, lanes[i].key, keyMask, lanes[i].pMoveScratch);
+    }
+}
@@ -0,0 +1,146 @@
+#include "verus_context.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+CVerusHashContextPool::CVerusHashContextPool(size_t count, int flags) :
+    base(NULL), count(count), mappedSize(0), hugePages(false)
+{
+    size_t size = count * KEY_STORAGE_SIZE;
+    if (!size)
+    {
+        return;
+    }
+
+#ifdef __linux__
+    if (flags & ALLOC_HUGE_PAGES)
+    {
+        size_t hugeSize = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+        void *p = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            base = (unsigned char *)p;
+            mappedSize = hugeSize;
+            hugePages = true;
+        }
+#endif
+        // no reserved huge pages, so ask for transparent ones on a huge page aligned block
+        if (!base && !posix_memalign((void **)&base, HUGE_PAGE_SIZE, hugeSize))
+        {
+#ifdef MADV_HUGEPAGE
+            madvise(base, hugeSize, MADV_HUGEPAGE);
+#endif
+        }
+    }
+#endif
+    if (!base)
+    {
+        base = (unsigned char *)alloc_aligned_buffer(size);
+    }
+    if (!base)
+    {
+        this->count = 0;
+        return;
+    }
+
+    freeList.reserve(count);
+    for (size_t i = count; i > 0; i--)
+    {
+        freeList.push_back(base + (i - 1) * KEY_STORAGE_SIZE);
+    }
+}
+
+CVerusHashContextPool::~CVerusHashContextPool()
+{
+#ifdef __linux__
+    if (mappedSize)
+    {
+        munmap(base, mappedSize);
+        return;
+    }
+#endif
+    free(base);
+}
+
+unsigned char *CVerusHashContextPool::Acquire()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (freeList.empty())
+    {
+        return NULL;
+    }
+    unsigned char *keyStorage = freeList.back();
+    freeList.pop_back();
+    return keyStorage;
+}
+
+void CVerusHashContextPool::Release(unsigned char *keyStorage)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    freeList.push_back(keyStorage);
+}
+
+size_t CVerusHashContextPool::Available()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return freeList.size();
+}
+
+unsigned char *CVerusHashContext::AllocKeyStorage(CVerusHashContextPool *pool, verusclhash_descr &descr)
+{
+    unsigned char *keyStorage = pool ? pool->Acquire() : NULL;
+    if (!keyStorage)
+    {
+        keyStorage = (unsigned char *)alloc_aligned_buffer(VERUSKEYSIZE << 1);
+    }
+    if (!keyStorage)
+    {
+        printf("ERROR: failed to allocate hash buffer - terminating\n");
+        assert(false);
+        return NULL;
+    }
+    verusclhasher::initkeystorage(keyStorage, &descr, VERUSKEYSIZE);
+    return keyStorage;
+}
+
+CVerusHashContext::CVerusHashContext(CVerusHashContextPool *pool) :
+    pool(pool),
+    key(AllocKeyStorage(pool, descr)),
+    tier(GetVerusKernels()->tier),
+    hasherV2(key, &descr, SOLUTION_VERUSHHASH_V2),
+    hasherV2_1(key, &descr, SOLUTION_VERUSHHASH_V2_1),
+    hasherV2_2(key, &descr, SOLUTION_VERUSHHASH_V2_2)
+{
+}
+
+CVerusHashContext::~CVerusHashContext()
+{
+    if (pool && pool->Owns(key))
+    {
+        pool->Release(key);
+    }
+    else
+    {
+        free(key);
+    }
+}
+
+void CVerusHashContext::UpdateKernels()
+{
+    tier = GetVerusKernels()->tier;
+    hasherV2.UpdateKernels();
+    hasherV2_1.UpdateKernels();
+    hasherV2_2.UpdateKernels();
+}
+
+CVerusHashContext &CVerusHashContext::ThreadContext()
+{
+    static thread_local CVerusHashContext context;
+    return context;
+}
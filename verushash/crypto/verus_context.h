@@ -0,0 +1,128 @@
+/*
+Explicit VerusHash 2 hashing contexts.
+
+By default each OS thread gets its own key storage on its first VerusHash 2 hash, so memory
+and cold keys grow with the number of threads that ever hash, and every hash constructs a new
+CVerusHashV2. A CVerusHashContext owns the key storage instead, along with a persistent hasher
+for each solution version, and can be handed from thread to thread as long as only one thread
+uses it at a time. Contexts can take their key storage from a CVerusHashContextPool, which
+allocates it in one block, optionally backed by huge pages.
+*/
+#ifndef VERUS_CONTEXT_H_
+#define VERUS_CONTEXT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+#include "verus_aligned.h"
+#include "verus_hash.h"
+
+class CVerusHashContextPool
+{
+    public:
+        enum {
+            // key, refresh copy and move scratch of one context, rounded up to a cache line
+            KEY_STORAGE_SIZE = ((VERUSKEYSIZE << 1) + 63) & ~63,
+            HUGE_PAGE_SIZE = 2 * 1024 * 1024
+        };
+
+        enum {
+            ALLOC_DEFAULT = 0,
+            ALLOC_HUGE_PAGES = 1            // try explicit, then transparent huge pages
+        };
+
+        // preallocates key storage for count contexts
+        CVerusHashContextPool(size_t count, int flags=ALLOC_DEFAULT);
+        ~CVerusHashContextPool();
+
+        // NULL when every entry is in use
+        unsigned char *Acquire();
+        void Release(unsigned char *keyStorage);
+
+        bool Owns(const unsigned char *keyStorage) const
+        {
+            return keyStorage >= base && keyStorage < base + count * KEY_STORAGE_SIZE;
+        }
+
+        size_t Size() const { return count; }
+        size_t Available();
+
+        // true if the block came from explicitly reserved huge pages
+        bool IsHugePageBacked() const { return hugePages; }
+
+    private:
+        CVerusHashContextPool(const CVerusHashContextPool &) = delete;
+        CVerusHashContextPool &operator=(const CVerusHashContextPool &) = delete;
+
+        unsigned char *base;
+        size_t count;
+        size_t mappedSize;                  // non-zero when base was mapped rather than allocated
+        bool hugePages;
+        std::mutex cs;
+        std::vector<unsigned char *> freeList;
+};
+
+class CVerusHashContext : public CAlignedNew<CVerusHashContext>
+{
+    public:
+        // takes key storage from the pool, or allocates it if there is no pool or it is exhausted
+        explicit CVerusHashContext(CVerusHashContextPool *pool=NULL);
+        ~CVerusHashContext();
+
+        bool IsValid() const { return key != NULL; }
+
+        unsigned char *GetKey() { return key; }
+        verusclhash_descr *GetDescr() { return &descr; }
+
+        // persistent hasher for a solution version, in whatever state its last use left it. it
+        // follows the kernel dispatch table if the CPU tier is forced after the context is made.
+        CVerusHashV2 &GetHasher(int solutionVersion)
+        {
+            if (tier != GetVerusKernels()->tier)
+            {
+                UpdateKernels();
+            }
+            int hashVersion = CVerusHashV2::HashVersion(solutionVersion);
+            return hashVersion == SOLUTION_VERUSHHASH_V2_2 ? hasherV2_2 :
+                   hashVersion == SOLUTION_VERUSHHASH_V2_1 ? hasherV2_1 : hasherV2;
+        }
+
+        // resumes the hasher of the midstate's hash version and returns it, or returns NULL
+        // if the midstate is malformed
+        CVerusHashV2 *SetMidstate(const CVerusHashV2::Midstate &midstate)
+        {
+            CVerusHashV2 &vh2 = GetHasher(midstate.solutionVersion);
+            return vh2.SetMidstate(midstate) ? &vh2 : NULL;
+        }
+
+        // the same for a blob from CVerusHashV2::ExportMidstate, or NULL if the blob is malformed
+        CVerusHashV2 *ImportMidstate(const unsigned char *blob, size_t blobLen)
+        {
+            if (blobLen < CVerusHashV2::MIDSTATE_BLOB_HEADER)
+            {
+                return NULL;
+            }
+            CVerusHashV2 &vh2 = GetHasher(blob[1]);
+            return vh2.ImportMidstate(blob, blobLen) ? &vh2 : NULL;
+        }
+
+        // a context for the calling thread, for callers that do not manage their own
+        static CVerusHashContext &ThreadContext();
+
+    private:
+        CVerusHashContext(const CVerusHashContext &) = delete;
+        CVerusHashContext &operator=(const CVerusHashContext &) = delete;
+
+        static unsigned char *AllocKeyStorage(CVerusHashContextPool *pool, verusclhash_descr &descr);
+        void UpdateKernels();
+
+        CVerusHashContextPool *pool;
+        verusclhash_descr descr;
+        unsigned char *key;
+        int tier;
+        CVerusHashV2 hasherV2, hasherV2_1, hasherV2_2;
+};
+
+#endif // VERUS_CONTEXT_H_
@@ -0,0 +1,322 @@
+/*
+Runtime CPU tier detection and the kernel table for each tier. The AVX2 and AVX-512
+tiers use copies of haraka.c and verus_clhash.cpp built with wider instruction sets,
+see verus_isa.h, next to the hand written VAES kernels in haraka_vaes.c and
+haraka_avx512.c.
+*/
+#include "verus_dispatch.h"
+#include "verus_hash.h"
+#include "verus_isa.h"
+#include "sha256.h"
+
+#include <atomic>
+
+#if defined(__arm__)  || defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#if !defined(__arm__) && !defined(__aarch64__)
+extern "C" {
+VERUS_ISA_DECLARE_KERNELS(_v3)          // x86-64-v3: AVX2, BMI1/2, VAES
+VERUS_ISA_DECLARE_KERNELS(_v4)          // x86-64-v4: AVX-512F/VL/BW/DQ, VAES
+}
+#endif
+
+namespace {
+
+int DetectSSSE3()
+{
+#if defined(__arm__)  || defined(__aarch64__)
+    return false;
+#else
+    unsigned int eax,ebx,ecx,edx;
+    return __get_cpuid(1,&eax,&ebx,&ecx,&edx) && (ecx & bit_SSSE3);
+#endif
+}
+
+int DetectSHANI()
+{
+#if defined(__arm__)  || defined(__aarch64__)
+    return false;
+#else
+    unsigned int eax,ebx,ecx,edx;
+    return __get_cpuid(1,&eax,&ebx,&ecx,&edx) && (ecx & bit_SSE4_1) &&
+           __get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx) && (ebx & bit_SHA);
+#endif
+}
+
+void SetPortableKernels(verus_kernels &k)
+{
+    k.haraka256 = &haraka256_port;
+    k.haraka256_4x = &haraka256_port_4x;
+    k.haraka256_8x = &haraka256_port_8x;
+    k.haraka512 = &haraka512_port;
+    k.haraka512_zero = &haraka512_port_zero;
+    k.haraka512_keyed = &haraka512_port_keyed;
+    k.haraka512_4x = &haraka512_port_4x;
+    k.haraka512_8x = &haraka512_port_8x;
+    k.verusclhash[VERUS_CLHASH_V2] = &verusclhash_port;
+    k.verusclhash[VERUS_CLHASH_V2_1] = &verusclhash_sv2_1_port;
+    k.verusclhash[VERUS_CLHASH_V2_2] = &verusclhash_sv2_2_port;
+    k.verusclhash_internal[VERUS_CLHASH_V2] = &__verusclmulwithoutreduction64alignedrepeat_port;
+    k.verusclhash_internal[VERUS_CLHASH_V2_1] = &__verusclmulwithoutreduction64alignedrepeat_sv2_1_port;
+    k.verusclhash_internal[VERUS_CLHASH_V2_2] = &__verusclmulwithoutreduction64alignedrepeat_sv2_2_port;
+    k.verushash2_write = &verushash2_write_port;
+    k.verushash2b_finish[VERUS_CLHASH_V2] = &verushash2b_finish_port;
+    k.verushash2b_finish[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_port;
+    k.verushash2b_finish[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_port;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2] = &verushash2b_finish_lanes_port;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_lanes_port;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_lanes_port;
+
+#if !defined(__arm__) && !defined(__aarch64__)
+    // without AES-NI, an SSSE3 software AES still beats the table lookups of haraka_portable.c
+    if (k.harakassse3)
+    {
+        k.haraka256 = &haraka256_ssse3;
+        k.haraka256_4x = &haraka256_4x_ssse3;
+        k.haraka256_8x = &haraka256_8x_ssse3;
+        k.haraka512 = &haraka512_ssse3;
+        k.haraka512_zero = &haraka512_zero_ssse3;
+        k.haraka512_keyed = &haraka512_keyed_ssse3;
+        k.haraka512_4x = &haraka512_4x_ssse3;
+        k.haraka512_8x = &haraka512_8x_ssse3;
+        k.verushash2_write = &verushash2_write_ssse3;
+    }
+#endif
+}
+
+void SetAESNIKernels(verus_kernels &k)
+{
+    k.haraka256 = &haraka256;
+    k.haraka256_4x = &haraka256_4x;
+    k.haraka256_8x = &haraka256_8x;
+    k.haraka512 = &haraka512;
+    k.haraka512_zero = &haraka512_zero;
+    k.haraka512_keyed = &haraka512_keyed;
+    k.haraka512_4x = &haraka512_4x;
+    k.haraka512_8x = &haraka512_8x;
+    k.verusclhash[VERUS_CLHASH_V2] = &verusclhash;
+    k.verusclhash[VERUS_CLHASH_V2_1] = &verusclhash_sv2_1;
+    k.verusclhash[VERUS_CLHASH_V2_2] = &verusclhash_sv2_2;
+    k.verusclhash_internal[VERUS_CLHASH_V2] = &__verusclmulwithoutreduction64alignedrepeat;
+    k.verusclhash_internal[VERUS_CLHASH_V2_1] = &__verusclmulwithoutreduction64alignedrepeat_sv2_1;
+    k.verusclhash_internal[VERUS_CLHASH_V2_2] = &__verusclmulwithoutreduction64alignedrepeat_sv2_2;
+    k.verushash2_write = &verushash2_write;
+    k.verushash2b_finish[VERUS_CLHASH_V2] = &verushash2b_finish;
+    k.verushash2b_finish[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1;
+    k.verushash2b_finish[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2] = &verushash2b_finish_lanes;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_lanes;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_lanes;
+}
+
+#if !defined(__arm__) && !defined(__aarch64__)
+void SetAVX2VAESKernels(verus_kernels &k)
+{
+    // single hashes are latency bound and stay on xmm registers, multi-lane use ymm VAES
+    k.haraka256 = &haraka256_v3;
+    k.haraka256_4x = &haraka256_4x_vaes;
+    k.haraka256_8x = &haraka256_8x_vaes;
+    k.haraka512 = &haraka512_v3;
+    k.haraka512_zero = &haraka512_zero_v3;
+    k.haraka512_keyed = &haraka512_keyed_v3;
+    k.haraka512_4x = &haraka512_4x_vaes;
+    k.haraka512_8x = &haraka512_8x_vaes;
+    k.verusclhash[VERUS_CLHASH_V2] = &verusclhash_v3;
+    k.verusclhash[VERUS_CLHASH_V2_1] = &verusclhash_sv2_1_v3;
+    k.verusclhash[VERUS_CLHASH_V2_2] = &verusclhash_sv2_2_v3;
+    k.verusclhash_internal[VERUS_CLHASH_V2] = &__verusclmulwithoutreduction64alignedrepeat_v3;
+    k.verusclhash_internal[VERUS_CLHASH_V2_1] = &__verusclmulwithoutreduction64alignedrepeat_sv2_1_v3;
+    k.verusclhash_internal[VERUS_CLHASH_V2_2] = &__verusclmulwithoutreduction64alignedrepeat_sv2_2_v3;
+    k.verushash2_write = &verushash2_write_v3;
+    k.verushash2b_finish[VERUS_CLHASH_V2] = &verushash2b_finish_v3;
+    k.verushash2b_finish[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_v3;
+    k.verushash2b_finish[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_v3;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2] = &verushash2b_finish_lanes_v3;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_lanes_v3;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_lanes_v3;
+}
+
+void SetAVX512Kernels(verus_kernels &k)
+{
+    // a whole Haraka512 state fits one zmm register, Haraka256 single hashes stay on xmm
+    k.haraka256 = &haraka256_v4;
+    k.haraka256_4x = &haraka256_4x_avx512;
+    k.haraka256_8x = &haraka256_8x_avx512;
+    k.haraka512 = &haraka512_avx512;
+    k.haraka512_zero = &haraka512_zero_avx512;
+    k.haraka512_keyed = &haraka512_keyed_avx512;
+    k.haraka512_4x = &haraka512_4x_avx512;
+    k.haraka512_8x = &haraka512_8x_avx512;
+    k.verusclhash[VERUS_CLHASH_V2] = &verusclhash_v4;
+    k.verusclhash[VERUS_CLHASH_V2_1] = &verusclhash_sv2_1_v4;
+    k.verusclhash[VERUS_CLHASH_V2_2] = &verusclhash_sv2_2_v4;
+    k.verusclhash_internal[VERUS_CLHASH_V2] = &__verusclmulwithoutreduction64alignedrepeat_v4;
+    k.verusclhash_internal[VERUS_CLHASH_V2_1] = &__verusclmulwithoutreduction64alignedrepeat_sv2_1_v4;
+    k.verusclhash_internal[VERUS_CLHASH_V2_2] = &__verusclmulwithoutreduction64alignedrepeat_sv2_2_v4;
+    k.verushash2_write = &verushash2_write_v4;
+    k.verushash2b_finish[VERUS_CLHASH_V2] = &verushash2b_finish_v4;
+    k.verushash2b_finish[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_v4;
+    k.verushash2b_finish[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_v4;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2] = &verushash2b_finish_lanes_v4;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_1] = &verushash2b_finish_sv2_1_lanes_v4;
+    k.verushash2b_finish_lanes[VERUS_CLHASH_V2_2] = &verushash2b_finish_sv2_2_lanes_v4;
+}
+#endif
+
+int DetectTier()
+{
+#if defined(__arm__)  || defined(__aarch64__)
+    long hwcaps= getauxval(AT_HWCAP);
+    return ((hwcaps & HWCAP_AES) && (hwcaps & HWCAP_PMULL)) ? VERUS_TIER_AESNI : VERUS_TIER_PORTABLE;
+#else
+    unsigned int eax,ebx,ecx,edx;
+    int tier = VERUS_TIER_PORTABLE;
+    if (__get_cpuid(1,&eax,&ebx,&ecx,&edx) &&
+        (ecx & (bit_AVX | bit_AES | bit_PCLMUL)) == (bit_AVX | bit_AES | bit_PCLMUL))
+    {
+        tier = VERUS_TIER_AESNI;
+
+        // the OS must save ymm state, and opmask and zmm state for AVX-512
+        if ((ecx & bit_OSXSAVE) && __get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx) &&
+            (ebx & (bit_AVX2 | bit_BMI | bit_BMI2)) == (bit_AVX2 | bit_BMI | bit_BMI2) && (ecx & bit_VAES))
+        {
+            unsigned int xcr0lo, xcr0hi;
+            __asm__ __volatile__ ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+            if ((xcr0lo & 0x6) == 0x6)
+            {
+                const unsigned int avx512 = bit_AVX512F | bit_AVX512VL | bit_AVX512BW | bit_AVX512DQ;
+                tier = ((ebx & avx512) == avx512 && (xcr0lo & 0xe0) == 0xe0) ? VERUS_TIER_AVX512 : VERUS_TIER_AVX2_VAES;
+            }
+        }
+    }
+    return tier;
+#endif
+}
+
+void SetKernels(verus_kernels &k, int tier, int ssse3, int shani)
+{
+    memset(&k, 0, sizeof(k));
+    k.tier = tier;
+    k.harakassse3 = tier == VERUS_TIER_PORTABLE && ssse3;
+    switch (tier)
+    {
+#if !defined(__arm__) && !defined(__aarch64__)
+        case VERUS_TIER_AVX512:
+            SetAVX512Kernels(k);
+            break;
+        case VERUS_TIER_AVX2_VAES:
+            SetAVX2VAESKernels(k);
+            break;
+#endif
+        case VERUS_TIER_AESNI:
+            SetAESNIKernels(k);
+            break;
+        default:
+            SetPortableKernels(k);
+            break;
+    }
+    k.sha256shani = tier >= VERUS_TIER_AESNI && shani;
+    k.sha256_transform = k.sha256shani ? &SHA256TransformSHANI : &SHA256TransformGeneric;
+}
+
+// the CPU's features and a kernel table for each tier it supports, built once and never
+// changed, so a table can be read while another is being switched to
+struct CVerusKernelTables
+{
+    int detectedTier;
+    verus_kernels tiers[VERUS_TIER_COUNT];
+    verus_kernels portableTables;       // the portable tier without SSSE3, see ForceVerusHarakaSSSE3
+
+    CVerusKernelTables() : detectedTier(DetectTier())
+    {
+        int shani = DetectSHANI(), ssse3 = DetectSSSE3();
+        memset(tiers, 0, sizeof(tiers));
+        for (int tier = VERUS_TIER_PORTABLE; tier <= detectedTier; tier++)
+        {
+            SetKernels(tiers[tier], tier, ssse3, shani);
+        }
+        SetKernels(portableTables, VERUS_TIER_PORTABLE, false, shani);
+    }
+};
+
+// initialized on first use by whichever thread gets there first, the others wait for it
+const CVerusKernelTables &KernelTables()
+{
+    static const CVerusKernelTables tables;
+    return tables;
+}
+
+// the table in use, NULL until the first use or forced tier
+std::atomic<const verus_kernels *> verusKernels(NULL);
+std::atomic<int> verusHarakaSSSE3(true);
+
+} // namespace
+
+int DetectVerusCPUTier(void)
+{
+    return KernelTables().detectedTier;
+}
+
+int GetVerusCPUTier(void)
+{
+    return GetVerusKernels()->tier;
+}
+
+int ForceVerusCPUTier(int tier)
+{
+    const CVerusKernelTables &tables = KernelTables();
+    if (tier < 0 || tier > tables.detectedTier)
+    {
+        tier = tables.detectedTier;
+    }
+    const verus_kernels *k = &tables.tiers[tier];
+    if (tier == VERUS_TIER_PORTABLE && !verusHarakaSSSE3.load(std::memory_order_relaxed))
+    {
+        k = &tables.portableTables;
+    }
+    verusKernels.store(k, std::memory_order_release);
+    SHA256SetTransform(k->sha256_transform);
+    return tier;
+}
+
+int ForceVerusHarakaSSSE3(int enable)
+{
+    verusHarakaSSSE3.store(enable, std::memory_order_relaxed);
+    return enable && KernelTables().tiers[VERUS_TIER_PORTABLE].harakassse3;
+}
+
+const verus_kernels *GetVerusKernels(void)
+{
+    const verus_kernels *k = verusKernels.load(std::memory_order_acquire);
+    if (!k)
+    {
+        // the first use publishes the detected tier's table, unless a tier was forced meanwhile
+        const CVerusKernelTables &tables = KernelTables();
+        if (verusKernels.compare_exchange_strong(k, &tables.tiers[tables.detectedTier], std::memory_order_acq_rel))
+        {
+            k = &tables.tiers[tables.detectedTier];
+            SHA256SetTransform(k->sha256_transform);
+        }
+    }
+    return k;
+}
+
+const char *GetVerusCPUTierName(int tier)
+{
+    switch (tier)
+    {
+        case VERUS_TIER_PORTABLE:
+            return "portable";
+        case VERUS_TIER_AESNI:
+            return "aesni";
+        case VERUS_TIER_AVX2_VAES:
+            return "avx2-vaes";
+        case VERUS_TIER_AVX512:
+            return "avx512";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Runtime CPU tier detection and the kernel dispatch table for VerusHash.
+ *
+ * The CPU is sorted once into one of the tiers below, and a table of Haraka, clhash and
+ * SHA-256 kernels built for that tier is shared by every hasher. The tables are built on
+ * first use from any thread and never change after, and the table in use is switched
+ * atomically, so hashers on other threads always see a whole table. Forcing a lower tier
+ * is meant for testing and benchmarks. Hashers pick their kernels up from the table in
+ * CVerusHash::init(), CVerusHashV2::init() and the verusclhasher constructor, so force
+ * the tier before those run.
+ */
+#ifndef VERUS_DISPATCH_H_
+#define VERUS_DISPATCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__arm__)  || defined(__aarch64__)
+#include "crypto/sse2neon.h"
+#else
+#include <x86intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VERUS_TIER_PORTABLE = 0,            // portable C, no AES-NI or PCLMULQDQ
+    VERUS_TIER_AESNI = 1,               // AES-NI, PCLMULQDQ and AVX on xmm registers
+    VERUS_TIER_AVX2_VAES = 2,           // adds AVX2, BMI1/2 and VAES on ymm registers
+    VERUS_TIER_AVX512 = 3,              // adds AVX-512F/VL/BW/DQ, VAES on zmm registers
+    VERUS_TIER_COUNT = 4
+};
+
+// index into the clhash kernels of the table, by VerusHash 2 solution version
+enum {
+    VERUS_CLHASH_V2 = 0,
+    VERUS_CLHASH_V2_1 = 1,
+    VERUS_CLHASH_V2_2 = 2,
+    VERUS_CLHASH_VERSIONS = 3
+};
+
+// one hash of a verushash2b_finish_lanes call, with the arguments verushash2b_finish takes for it
+struct verushash2b_lane
+{
+    unsigned char *hash;
+    unsigned char *curBuf;
+    size_t curPos;
+    void *key;
+    __m128i **pMoveScratch;
+};
+
+struct verus_kernels
+{
+    int tier;
+    int sha256shani;                    // SHA-256 uses the SHA extensions
+    int harakassse3;                    // the portable tier's Haraka uses SSSE3, see haraka_ssse3.h
+
+    void (*haraka256)(unsigned char *out, const unsigned char *in);
+    void (*haraka256_4x)(unsigned char *out, const unsigned char *in);
+    void (*haraka256_8x)(unsigned char *out, const unsigned char *in);
+    void (*haraka512)(unsigned char *out, const unsigned char *in);
+    void (*haraka512_zero)(unsigned char *out, const unsigned char *in);
+    void (*haraka512_keyed)(unsigned char *out, const unsigned char *in, const __m128i *rc);
+    void (*haraka512_4x)(unsigned char *out, const unsigned char *in);
+    void (*haraka512_8x)(unsigned char *out, const unsigned char *in);
+
+    uint64_t (*verusclhash[VERUS_CLHASH_VERSIONS])(void *random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch);
+    __m128i (*verusclhash_internal[VERUS_CLHASH_VERSIONS])(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch);
+
+    // whole steps of VerusHash 2b, so a hasher makes one indirect call per Write and one for the
+    // clhash and final Haraka, instead of one per 32 bytes, see CVerusHashV2
+    size_t (*verushash2_write)(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len);
+    void (*verushash2b_finish[VERUS_CLHASH_VERSIONS])(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch);
+    // the same for several independent hashes, with separate keys of the same size, run
+    // interleaved where the tier and clhash version allow, see CVerusHashV2::Finalize2bBatch
+    void (*verushash2b_finish_lanes[VERUS_CLHASH_VERSIONS])(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+
+    void (*sha256_transform)(uint32_t *s, const unsigned char *chunk, size_t blocks);
+};
+
+// highest tier this CPU and OS support, without looking at any forced tier
+int DetectVerusCPUTier(void);
+
+// tier in use, detected on first call unless forced before
+int GetVerusCPUTier(void);
+
+// selects a tier, clamped to what the CPU supports, and returns the tier selected. a
+// negative tier selects the detected one.
+int ForceVerusCPUTier(int tier);
+
+// whether the portable tier's Haraka may use SSSE3, so tests can reach the table lookup
+// fallback on CPUs that have SSSE3. applies from the next ForceVerusCPUTier, and returns
+// whether SSSE3 will be used
+int ForceVerusHarakaSSSE3(int enable);
+
+// the kernels for the tier in use
+const struct verus_kernels *GetVerusKernels(void);
+
+const char *GetVerusCPUTierName(int tier);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // VERUS_DISPATCH_H_
@@ -9,6 +9,7 @@ inputs only, Verus Hash takes any length of input and produces a 256
 bit output.
 */
 #include <string.h>
+#include <algorithm>
 #include "common.h"
 #include "verus_hash.h"
 
@@ -45,18 +46,17 @@ void CVerusHash::Hash(void *result, const void *data, size_t _len)
         nextOffset *= -1;
     }
     memcpy(result, bufPtr, 32);
+
+    if (CVerusStats::IsEnabled())
+    {
+        CVerusStats::Count(VERUS_STAT_HASHES_V1);
+        CVerusStats::Count(VERUS_STAT_BYTES_HASHED, _len);
+    }
 };
 
 void CVerusHash::init()
 {
-    if (IsCPUVerusOptimized())
-    {
-        haraka512Function = &haraka512_zero;
-    }
-    else
-    {
-        haraka512Function = &haraka512_port_zero;
-    }
+    haraka512Function = GetVerusKernels()->haraka512_zero;
 }
 
 CVerusHash &CVerusHash::Write(const unsigned char *data, size_t _len)
@@ -86,6 +86,20 @@ CVerusHash &CVerusHash::Write(const unsigned char *data, size_t _len)
             pos = len;
         }
     }
+
+    if (CVerusStats::IsEnabled())
+    {
+        CVerusStats::Count(VERUS_STAT_BYTES_HASHED, len);
+    }
+    return *this;
+}
+
+CVerusHash &CVerusHash::WriteV(const verus_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        Write((const unsigned char *)iov[i].iov_base, iov[i].iov_len);
+    }
     return *this;
 }
 
@@ -98,24 +112,34 @@ void verus_hash(void *result, const void *data, size_t len)
 void (*CVerusHashV2::haraka512Function)(unsigned char *out, const unsigned char *in);
 void (*CVerusHashV2::haraka512KeyedFunction)(unsigned char *out, const unsigned char *in, const u128 *rc);
 void (*CVerusHashV2::haraka256Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHashV2::haraka256x4Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHashV2::haraka256x8Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHashV2::haraka512x4Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHashV2::haraka512x8Function)(unsigned char *out, const unsigned char *in);
 
 void CVerusHashV2::init()
 {
-    if (IsCPUVerusOptimized())
+    const verus_kernels *kernels = GetVerusKernels();
+    // load the haraka constants
+    if (kernels->tier >= VERUS_TIER_AESNI)
     {
         load_constants();
-        haraka512Function = &haraka512;
-        haraka512KeyedFunction = &haraka512_keyed;
-        haraka256Function = &haraka256;
+    }
+    else if (kernels->harakassse3)
+    {
+        load_constants_ssse3();
     }
     else
     {
-        // load the haraka constants
         load_constants_port();
-        haraka512Function = &haraka512_port;
-        haraka512KeyedFunction = &haraka512_port_keyed;
-        haraka256Function = &haraka256_port;
     }
+    haraka512Function = kernels->haraka512;
+    haraka512KeyedFunction = kernels->haraka512_keyed;
+    haraka256Function = kernels->haraka256;
+    haraka256x4Function = kernels->haraka256_4x;
+    haraka256x8Function = kernels->haraka256_8x;
+    haraka512x4Function = kernels->haraka512_4x;
+    haraka512x8Function = kernels->haraka512_8x;
 }
 
 void CVerusHashV2::Hash(void *result, const void *data, size_t len)
@@ -148,35 +172,433 @@ void CVerusHashV2::Hash(void *result, const void *data, size_t len)
         nextOffset *= -1;
     }
     memcpy(result, bufPtr, 32);
+
+    if (CVerusStats::IsEnabled())
+    {
+        CVerusStats::Count(VERUS_STAT_HASHES_V2);
+        CVerusStats::Count(VERUS_STAT_BYTES_HASHED, len);
+    }
 };
 
+void CVerusHashV2::HarakaLanes(unsigned char *out, const unsigned char *in, int nLanes)
+{
+    // unused lanes of the multi-lane functions are computed on whatever the caller left there,
+    // which must be initialized, and ignored
+    if (nLanes > 4)
+    {
+        (*haraka512x8Function)(out, in);
+    }
+    else if (nLanes > 1)
+    {
+        (*haraka512x4Function)(out, in);
+    }
+    else
+    {
+        (*haraka512Function)(out, in);
+    }
+}
+
+void CVerusHashV2::Haraka256Lanes(unsigned char *out, const unsigned char *in, int nLanes)
+{
+    if (nLanes > 4)
+    {
+        (*haraka256x8Function)(out, in);
+    }
+    else if (nLanes > 1)
+    {
+        (*haraka256x4Function)(out, in);
+    }
+    else
+    {
+        (*haraka256Function)(out, in);
+    }
+}
+
+void CVerusHashV2::HashBatch(unsigned char *results, const unsigned char *const *data, const size_t *lens, size_t count)
+{
+    alignas(32) unsigned char in[BATCH_LANES * 64];
+    alignas(32) unsigned char out[BATCH_LANES * 32];
+    size_t laneItem[BATCH_LANES], lanePos[BATCH_LANES];
+    size_t next = 0;
+    int nLanes = 0;
+
+    // lanes above nLanes are hashed along with the rest, so they must not be left uninitialized
+    memset(in, 0, sizeof(in));
+
+    for (;;)
+    {
+        // start the next inputs in any free lanes, an empty input hashes to zero without a lane
+        while (nLanes < BATCH_LANES && next < count)
+        {
+            if (lens[next])
+            {
+                laneItem[nLanes] = next;
+                lanePos[nLanes] = 0;
+                memset(in + (nLanes << 6), 0, 32);
+                nLanes++;
+            }
+            else
+            {
+                memset(results + (next << 5), 0, 32);
+            }
+            next++;
+        }
+        if (!nLanes)
+        {
+            break;
+        }
+
+        // digest up to 32 bytes at a time in each lane, behind that lane's last result
+        for (int i = 0; i < nLanes; i++)
+        {
+            const unsigned char *ptr = data[laneItem[i]] + lanePos[i];
+            size_t left = lens[laneItem[i]] - lanePos[i];
+            unsigned char *dest = in + (i << 6) + 32;
+            if (left >= 32)
+            {
+                memcpy(dest, ptr, 32);
+            }
+            else
+            {
+                memcpy(dest, ptr, left);
+                memset(dest + left, 0, 32 - left);
+            }
+            lanePos[i] += 32;
+        }
+
+        HarakaLanes(out, in, nLanes);
+
+        // chain each result into its lane, and retire finished lanes by moving the last lane into their place
+        for (int i = 0; i < nLanes; )
+        {
+            if (lanePos[i] >= lens[laneItem[i]])
+            {
+                memcpy(results + (laneItem[i] << 5), out + (i << 5), 32);
+                if (i != --nLanes)
+                {
+                    laneItem[i] = laneItem[nLanes];
+                    lanePos[i] = lanePos[nLanes];
+                    memcpy(out + (i << 5), out + (nLanes << 5), 32);
+                }
+            }
+            else
+            {
+                memcpy(in + (i << 6), out + (i << 5), 32);
+                i++;
+            }
+        }
+    }
+}
+
+void CVerusHashV2::WriteBatch(CVerusHashV2 *const *hashers, const unsigned char *const *data, const size_t *lens, size_t count)
+{
+    alignas(32) unsigned char in[BATCH_LANES * 64];
+    alignas(32) unsigned char out[BATCH_LANES * 32];
+    size_t laneItem[BATCH_LANES], lanePos[BATCH_LANES];
+    size_t next = 0;
+    int nLanes = 0;
+
+    // lanes above nLanes are hashed along with the rest, so they must not be left uninitialized
+    memset(in, 0, sizeof(in));
+
+    for (;;)
+    {
+        // top up the buffer of each lane, keeping only lanes with a full block to hash and
+        // starting new hashers in any lanes that are free
+        for (int i = 0; ; )
+        {
+            if (i == nLanes)
+            {
+                if (nLanes == BATCH_LANES || next == count)
+                {
+                    break;
+                }
+                laneItem[nLanes] = next++;
+                lanePos[nLanes++] = 0;
+            }
+
+            CVerusHashV2 &h = *hashers[laneItem[i]];
+            const unsigned char *ptr = data[laneItem[i]] + lanePos[i];
+            size_t left = lens[laneItem[i]] - lanePos[i];
+            size_t room = 32 - h.curPos;
+
+            if (left >= room)
+            {
+                memcpy(h.curBuf + 32 + h.curPos, ptr, room);
+                memcpy(in + (i << 6), h.curBuf, 64);
+                lanePos[i] += room;
+                i++;
+            }
+            else
+            {
+                memcpy(h.curBuf + 32 + h.curPos, ptr, left);
+                h.curPos += left;
+                if (i != --nLanes)
+                {
+                    laneItem[i] = laneItem[nLanes];
+                    lanePos[i] = lanePos[nLanes];
+                }
+            }
+        }
+        if (!nLanes)
+        {
+            break;
+        }
+
+        HarakaLanes(out, in, nLanes);
+
+        for (int i = 0; i < nLanes; i++)
+        {
+            CVerusHashV2 &h = *hashers[laneItem[i]];
+            unsigned char *tmp = h.curBuf;
+            memcpy(h.result, out + (i << 5), 32);
+            h.curBuf = h.result;
+            h.result = tmp;
+            h.curPos = 0;
+        }
+    }
+}
+
 CVerusHashV2 &CVerusHashV2::Write(const unsigned char *data, size_t len)
 {
-    unsigned char *tmp;
+    bool fStats = CVerusStats::IsEnabled();
+    uint64_t start = fStats ? CVerusStats::Timestamp() : 0;
 
-    // digest up to 32 bytes at a time
-    for ( int pos = 0; pos < len; )
+    // the whole chain in one call, digesting up to 32 bytes at a time in place in curBuf
+    curPos = (*writeFunction)(curBuf, curPos, data, len);
+
+    if (fStats)
     {
-        int room = 32 - curPos;
+        CVerusStats::Stage(VERUS_STAGE_HARAKA_CHAIN, start);
+        CVerusStats::Count(VERUS_STAT_BYTES_HASHED, len);
+    }
+    return *this;
+}
 
-        if (len - pos >= room)
+CVerusHashV2 &CVerusHashV2::WriteV(const verus_iovec *iov, size_t count)
+{
+    bool fStats = CVerusStats::IsEnabled();
+    uint64_t start = fStats ? CVerusStats::Timestamp() : 0;
+    size_t len = 0;
+
+    // the chain kernel picks up at curPos, so the block position carries from piece to piece
+    for (size_t i = 0; i < count; i++)
+    {
+        curPos = (*writeFunction)(curBuf, curPos, (const unsigned char *)iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+
+    if (fStats)
+    {
+        CVerusStats::Stage(VERUS_STAGE_HARAKA_CHAIN, start);
+        CVerusStats::Count(VERUS_STAT_BYTES_HASHED, len);
+    }
+    return *this;
+}
+
+void CVerusHashV2::GenNewCLKeys(unsigned char *const *seeds, unsigned char *const *keys, verusclhash_descr *const *descrs, size_t count)
+{
+    alignas(32) unsigned char buf1[BATCH_LANES * 32];
+    alignas(32) unsigned char buf2[BATCH_LANES * 32];
+    CVerusKeyCache &keyCache = CVerusKeyCache::Shared();
+
+    // lanes above nLanes are hashed along with the rest, so they must not be left uninitialized
+    memset(buf1, 0, sizeof(buf1));
+
+    for (size_t i = 0; i < count; )
+    {
+        // take up to BATCH_LANES keys that are neither current nor cached, and settle the rest
+        size_t laneItem[BATCH_LANES];
+        unsigned char *in = buf1, *out = buf2;
+        int nLanes = 0;
+        for (; i < count && nLanes < BATCH_LANES; i++)
         {
-            memcpy(curBuf + 32 + curPos, data + pos, room);
-            (*haraka512Function)(result, curBuf);
-            tmp = curBuf;
-            curBuf = result;
-            result = tmp;
-            pos += room;
-            curPos = 0;
+            verusclhash_descr *pdesc = descrs[i];
+            if (pdesc->seed == *((uint256 *)seeds[i]))
+            {
+                RestoreCLKey(keys[i], pdesc);
+            }
+            else if (keyCache.Lookup(*((uint256 *)seeds[i]), pdesc->keySizeInBytes, keys[i]))
+            {
+                if (CVerusStats::IsEnabled())
+                {
+                    CVerusStats::Count(VERUS_STAT_KEYS_CACHED);
+                }
+                SetCLKeySeed(seeds[i], keys[i], pdesc);
+            }
+            else
+            {
+                memcpy(in + (nLanes << 5), seeds[i], 32);
+                laneItem[nLanes++] = i;
+            }
+        }
+        if (!nLanes)
+        {
+            continue;
+        }
+
+        // advance every lane's chain by one Haraka256 per 32 bytes of key, the unused lanes of the
+        // multi-lane functions are computed on earlier data and ignored
+        int size = descrs[laneItem[0]]->keySizeInBytes;
+        int n256blks = size >> 5;
+        int nbytesExtra = size & 0x1f;
+        if (nLanes == 1)
+        {
+            // a lone chain runs in place in its key, as in GenNewCLKey
+            unsigned char *pkey = keys[laneItem[0]];
+            const unsigned char *psrc = in;
+            for (int blk = 0; blk < n256blks; blk++)
+            {
+                (*haraka256Function)(pkey, psrc);
+                psrc = pkey;
+                pkey += 32;
+            }
+            if (nbytesExtra)
+            {
+                (*haraka256Function)(out, psrc);
+                memcpy(pkey, out, nbytesExtra);
+            }
         }
         else
         {
-            memcpy(curBuf + 32 + curPos, data + pos, len - pos);
-            curPos += len - pos;
-            pos = len;
+            for (int blk = 0; blk < n256blks; blk++)
+            {
+                Haraka256Lanes(out, in, nLanes);
+                for (int j = 0; j < nLanes; j++)
+                {
+                    memcpy(keys[laneItem[j]] + (blk << 5), out + (j << 5), 32);
+                }
+                std::swap(in, out);
+            }
+            if (nbytesExtra)
+            {
+                Haraka256Lanes(out, in, nLanes);
+                for (int j = 0; j < nLanes; j++)
+                {
+                    memcpy(keys[laneItem[j]] + (n256blks << 5), out + (j << 5), nbytesExtra);
+                }
+            }
+        }
+
+        for (int j = 0; j < nLanes; j++)
+        {
+            size_t item = laneItem[j];
+            keyCache.Insert(*((uint256 *)seeds[item]), size, keys[item]);
+            if (CVerusStats::IsEnabled())
+            {
+                CVerusStats::Count(VERUS_STAT_KEYS_GENERATED);
+            }
+            SetCLKeySeed(seeds[item], keys[item], descrs[item]);
         }
     }
-    return *this;
+}
+
+void CVerusHashV2::Finalize2bBatch(CVerusHashV2 *const *hashers, unsigned char *const *hashes, size_t count)
+{
+#ifndef VERUSHASHDEBUG
+    if (!CVerusStats::IsEnabled())
+    {
+        verushash2b_lane lanes[BATCH_LANES];
+        unsigned char *seeds[BATCH_LANES], *keys[BATCH_LANES];
+        verusclhash_descr *descrs[BATCH_LANES];
+        for (size_t i = 0; i < count; )
+        {
+            // a run of hashers with the same kernel and key size, each with its own key
+            const verusclhasher &first = hashers[i]->vclh;
+            size_t start = i;
+            int n = 0;
+            for (; i < count && n < BATCH_LANES; i++, n++)
+            {
+                CVerusHashV2 &vh2 = *hashers[i];
+                if (n && (vh2.vclh.verushash2bfinishlanesfunction != first.verushash2bfinishlanesfunction ||
+                          vh2.vclh.keyMask != first.keyMask ||
+                          std::find(keys, keys + n, vh2.vclh.key) != keys + n))
+                {
+                    break;
+                }
+                vh2.FillExtra((u128 *)vh2.curBuf);
+                seeds[n] = vh2.curBuf;
+                keys[n] = vh2.vclh.key;
+                descrs[n] = vh2.vclh.descr;
+            }
+
+            // the keys of the run are generated side by side
+            GenNewCLKeys(seeds, keys, descrs, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                CVerusHashV2 &vh2 = *hashers[start + j];
+                verushash2b_lane &lane = lanes[j];
+                lane.hash = hashes[start + j];
+                lane.curBuf = vh2.curBuf;
+                lane.curPos = vh2.curPos;
+                lane.key = keys[j];
+                lane.pMoveScratch = (__m128i **)(keys[j] + vh2.vclh.descr->keySizeInBytes + vh2.vclh.keyrefreshsize());
+            }
+            (*first.verushash2bfinishlanesfunction)(lanes, n, first.keyMask);
+        }
+        return;
+    }
+#endif
+
+    // stats and debug output are kept per hash
+    for (size_t i = 0; i < count; i++)
+    {
+        hashers[i]->Finalize2b(hashes[i]);
+    }
+}
+
+void CVerusHashV2::GetMidstate(Midstate &midstate) const
+{
+    memcpy(midstate.buf, curBuf, 32 + curPos);
+    midstate.curPos = curPos;
+    midstate.solutionVersion = HashVersion(solutionVersion);
+}
+
+bool CVerusHashV2::SetMidstate(const Midstate &midstate)
+{
+    // switching versions here would outlive the call in a context's persistent hashers
+    if (HashVersion(midstate.solutionVersion) != HashVersion(solutionVersion) || midstate.curPos >= 32)
+    {
+        return false;
+    }
+    curBuf = buf1;
+    result = buf2;
+    curPos = midstate.curPos;
+    memcpy(buf1, midstate.buf, 32 + curPos);
+    return true;
+}
+
+size_t CVerusHashV2::ExportMidstate(unsigned char *blob, size_t blobLen) const
+{
+    size_t size = MIDSTATE_BLOB_HEADER + 32 + curPos;
+    if (blobLen < size)
+    {
+        return 0;
+    }
+    blob[0] = MIDSTATE_BLOB_VERSION;
+    blob[1] = (unsigned char)HashVersion(solutionVersion);
+    blob[2] = (unsigned char)curPos;
+    memcpy(blob + MIDSTATE_BLOB_HEADER, curBuf, 32 + curPos);
+    return size;
+}
+
+bool CVerusHashV2::ImportMidstate(const unsigned char *blob, size_t blobLen)
+{
+    if (blobLen < MIDSTATE_BLOB_HEADER + 32 ||
+        blob[0] != MIDSTATE_BLOB_VERSION ||
+        blob[1] < SOLUTION_VERUSHHASH_V2 ||
+        blob[1] > SOLUTION_VERUSHHASH_V2_2 ||
+        blob[2] >= 32 ||
+        blobLen < MIDSTATE_BLOB_HEADER + 32 + blob[2])
+    {
+        return false;
+    }
+    Midstate midstate;
+    midstate.solutionVersion = blob[1];
+    midstate.curPos = blob[2];
+    memcpy(midstate.buf, blob + MIDSTATE_BLOB_HEADER, 32 + midstate.curPos);
+    return SetMidstate(midstate);
 }
 
 // to be declared and accessed from C
@@ -16,13 +16,25 @@ This provides the PoW hash function for Verus, enabling CPU mining.
 
 #include "uint256.h"
 #include "verus_clhash.h"
+#include "verus_keycache.h"
+#include "verus_stats.h"
 
 extern "C" 
 {
 #include "haraka.h"
 #include "haraka_portable.h"
+#include "haraka_ssse3.h"
+#include "haraka_vaes.h"
 }
 
+// one piece of the input to WriteV, laid out as a POSIX struct iovec so an array of those can be
+// passed as is
+struct verus_iovec
+{
+    const void *iov_base;
+    size_t iov_len;
+};
+
 class CVerusHash
 {
     public:
@@ -35,6 +47,9 @@ class CVerusHash
 
         CVerusHash &Write(const unsigned char *data, size_t len);
 
+        // equivalent to a Write of each piece in turn
+        CVerusHash &WriteV(const verus_iovec *iov, size_t count);
+
         CVerusHash &Reset()
         {
             curBuf = buf1;
@@ -63,6 +78,11 @@ class CVerusHash
             }
             else
                 std::memcpy(hash, curBuf, 32);
+
+            if (CVerusStats::IsEnabled())
+            {
+                CVerusStats::Count(VERUS_STAT_HASHES_V1);
+            }
         }
 
     private:
@@ -79,12 +99,49 @@ class CVerusHashV2
         static void (*haraka512Function)(unsigned char *out, const unsigned char *in);
         static void (*haraka512KeyedFunction)(unsigned char *out, const unsigned char *in, const u128 *rc);
         static void (*haraka256Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka256x4Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka256x8Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka512x4Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka512x8Function)(unsigned char *out, const unsigned char *in);
+
+        // the widest number of independent hashes run through one multi-lane haraka call
+        enum { BATCH_LANES = 8 };
+
+        // equivalent to count calls to Hash, with the independent haraka chains interleaved
+        // across the 4 and 8 lane functions. results must have room for count * 32 bytes
+        static void HashBatch(unsigned char *results, const unsigned char *const *data, const size_t *lens, size_t count);
 
         static void init();
 
+        // chaining state after writing a prefix, which any number of hashes of data sharing that
+        // prefix can resume from instead of hashing the prefix again
+        struct Midstate
+        {
+            alignas(32) unsigned char buf[64];  // last result followed by curPos bytes of pending input
+            uint32_t curPos;
+            int solutionVersion;                // as HashVersion
+        };
+
+        // compact serialized form of a midstate: format version, hash version, curPos,
+        // the last result and only the pending bytes of input
+        enum {
+            MIDSTATE_BLOB_VERSION = 1,
+            MIDSTATE_BLOB_HEADER = 3,
+            MIDSTATE_BLOB_MAX = MIDSTATE_BLOB_HEADER + 32 + 31
+        };
+
         verusclhasher vclh;
 
-        CVerusHashV2(int solutionVersion=SOLUTION_VERUSHHASH_V2) : vclh(VERUSKEYSIZE, solutionVersion) {
+        // the version the hash of a solution version is computed with. later solution versions
+        // hash as the latest hash version, as in verusclhasher::setfunctions
+        static inline int HashVersion(int solutionVersion)
+        {
+            return solutionVersion >= SOLUTION_VERUSHHASH_V2_2 ? SOLUTION_VERUSHHASH_V2_2 :
+                   solutionVersion >= SOLUTION_VERUSHHASH_V2_1 ? SOLUTION_VERUSHHASH_V2_1 : SOLUTION_VERUSHHASH_V2;
+        }
+
+        CVerusHashV2(int solutionVersion=SOLUTION_VERUSHHASH_V2) :
+            vclh(VERUSKEYSIZE, solutionVersion), writeFunction(GetVerusKernels()->verushash2_write), solutionVersion(solutionVersion) {
             // we must have allocated key space, or can't run
             if (!verusclhasher_key.get())
             {
@@ -93,8 +150,30 @@ class CVerusHashV2
             }
         }
 
+        // hashes with key storage owned by the caller instead of the calling thread's, see
+        // VerusHashContext
+        CVerusHashV2(unsigned char *keyBuffer, verusclhash_descr *pdesc, int solutionVersion=SOLUTION_VERUSHHASH_V2) :
+            vclh(keyBuffer, pdesc, solutionVersion), writeFunction(GetVerusKernels()->verushash2_write), solutionVersion(solutionVersion) {}
+
+        // picks up the kernels of the current dispatch table, if the CPU tier was forced after
+        // this hasher was made
+        void UpdateKernels()
+        {
+            writeFunction = GetVerusKernels()->verushash2_write;
+            vclh.setfunctions(solutionVersion);
+        }
+
         CVerusHashV2 &Write(const unsigned char *data, size_t len);
 
+        // equivalent to a Write of each piece in turn, without joining the pieces first. whole
+        // blocks are hashed straight from the piece they are in, and only blocks that span
+        // pieces are put together in the hash buffer
+        CVerusHashV2 &WriteV(const verus_iovec *iov, size_t count);
+
+        // equivalent to calling hashers[i]->Write(data[i], lens[i]) for each i, but interleaves the
+        // haraka chains of all hashers. each hasher must appear only once in the batch
+        static void WriteBatch(CVerusHashV2 *const *hashers, const unsigned char *const *data, const size_t *lens, size_t count);
+
         inline CVerusHashV2 &Reset()
         {
             curBuf = buf1;
@@ -104,6 +183,20 @@ class CVerusHashV2
             return *this;
         }
 
+        void GetMidstate(Midstate &midstate) const;
+
+        // restores the chaining state. returns false and leaves this hasher as it was if the
+        // midstate is of another hash version, which needs the hasher of that version
+        bool SetMidstate(const Midstate &midstate);
+
+        // returns the number of bytes written, or 0 if blobLen is too small
+        size_t ExportMidstate(unsigned char *blob, size_t blobLen) const;
+
+        // returns false if the blob is short or malformed, or of another hash version
+        bool ImportMidstate(const unsigned char *blob, size_t blobLen);
+
+        inline int GetSolutionVersion() const { return solutionVersion; }
+
         inline int64_t *ExtraI64Ptr() { return (int64_t *)(curBuf + 32); }
         inline void ClearExtra()
         {
@@ -139,47 +232,74 @@ class CVerusHashV2
             }
             else
                 std::memcpy(hash, curBuf, 32);
+
+            if (CVerusStats::IsEnabled())
+            {
+                CVerusStats::Count(VERUS_STAT_HASHES_V2);
+            }
         }
 
-        // chains Haraka256 from 32 bytes to fill the key
+        // chains Haraka256 from 32 bytes to fill the calling thread's key
         static u128 *GenNewCLKey(unsigned char *seedBytes32)
         {
-            unsigned char *key = (unsigned char *)verusclhasher_key.get();
-            verusclhash_descr *pdesc = (verusclhash_descr *)verusclhasher_descr.get();
+            return GenNewCLKey(seedBytes32, (unsigned char *)verusclhasher_key.get(), (verusclhash_descr *)verusclhasher_descr.get());
+        }
+
+        // chains Haraka256 from 32 bytes to fill the key in the given key storage
+        static u128 *GenNewCLKey(unsigned char *seedBytes32, unsigned char *key, verusclhash_descr *pdesc)
+        {
             int size = pdesc->keySizeInBytes;
-            int refreshsize = verusclhasher::keymask(size) + 1;
             // skip keygen if it is the current key
             if (pdesc->seed != *((uint256 *)seedBytes32))
             {
-                // generate a new key by chain hashing with Haraka256 from the last curbuf
-                int n256blks = size >> 5;
-                int nbytesExtra = size & 0x1f;
-                unsigned char *pkey = key;
-                unsigned char *psrc = seedBytes32;
-                for (int i = 0; i < n256blks; i++)
+                // another thread may have generated this key already
+                CVerusKeyCache &keyCache = CVerusKeyCache::Shared();
+                if (keyCache.Lookup(*((uint256 *)seedBytes32), size, key))
                 {
-                    (*haraka256Function)(pkey, psrc);
-                    psrc = pkey;
-                    pkey += 32;
+                    if (CVerusStats::IsEnabled())
+                    {
+                        CVerusStats::Count(VERUS_STAT_KEYS_CACHED);
+                    }
                 }
-                if (nbytesExtra)
+                else
                 {
-                    unsigned char buf[32];
-                    (*haraka256Function)(buf, psrc);
-                    memcpy(pkey, buf, nbytesExtra);
+                    // generate a new key by chain hashing with Haraka256 from the last curbuf
+                    int n256blks = size >> 5;
+                    int nbytesExtra = size & 0x1f;
+                    unsigned char *pkey = key;
+                    unsigned char *psrc = seedBytes32;
+                    for (int i = 0; i < n256blks; i++)
+                    {
+                        (*haraka256Function)(pkey, psrc);
+                        psrc = pkey;
+                        pkey += 32;
+                    }
+                    if (nbytesExtra)
+                    {
+                        unsigned char buf[32];
+                        (*haraka256Function)(buf, psrc);
+                        memcpy(pkey, buf, nbytesExtra);
+                    }
+                    keyCache.Insert(*((uint256 *)seedBytes32), size, key);
+                    if (CVerusStats::IsEnabled())
+                    {
+                        CVerusStats::Count(VERUS_STAT_KEYS_GENERATED);
+                    }
                 }
-                pdesc->seed = *((uint256 *)seedBytes32);
-                memcpy(key + size, key, refreshsize);
+                SetCLKeySeed(seedBytes32, key, pdesc);
             }
             else
             {
-                memcpy(key, key + size, refreshsize);
+                RestoreCLKey(key, pdesc);
             }
-
-            memset((unsigned char *)key + (size + refreshsize), 0, size - refreshsize);
             return (u128 *)key;
         }
 
+        // equivalent to GenNewCLKey(seeds[i], keys[i], descrs[i]) for each i, for keys of the same
+        // size in separate key storage. the Haraka256 chains of keys that have to be generated are
+        // run side by side through the 4 and 8 lane functions
+        static void GenNewCLKeys(unsigned char *const *seeds, unsigned char *const *keys, verusclhash_descr *const *descrs, size_t count);
+
         inline uint64_t IntermediateTo128Offset(uint64_t intermediate)
         {
             // the mask is where we wrap
@@ -199,12 +319,39 @@ class CVerusHashV2
             printf("Curbuf: %s%s\n", bhalf1->GetHex().c_str(), bhalf2->GetHex().c_str());
 #endif
 
+            bool fStats = CVerusStats::IsEnabled();
+
+#ifndef VERUSHASHDEBUG
+            if (!fStats)
+            {
+                // the clhash and keyed haraka in one call, specialized for the clhash version
+                u128 *key = GenNewCLKey(curBuf, vclh.key, vclh.descr);
+                (*vclh.verushash2bfinishfunction)(hash, curBuf, curPos, key, vclh.keyMask,
+                                                  (__m128i **)((unsigned char *)key + vclh.descr->keySizeInBytes + vclh.keyrefreshsize()));
+                return;
+            }
+#endif
+
+            uint64_t start = fStats ? CVerusStats::Timestamp() : 0;
+
             // gen new key with what is last in buffer
-            u128 *key = GenNewCLKey(curBuf);
+            u128 *key = GenNewCLKey(curBuf, vclh.key, vclh.descr);
+
+            if (fStats)
+            {
+                CVerusStats::Stage(VERUS_STAGE_KEYGEN, start);
+                start = CVerusStats::Timestamp();
+            }
 
             // run verusclhash on the buffer
             uint64_t intermediate = vclh(curBuf, key);
 
+            if (fStats)
+            {
+                CVerusStats::Stage(VERUS_STAGE_CLHASH, start);
+                start = CVerusStats::Timestamp();
+            }
+
             // fill buffer to the end with the result
             FillExtra(&intermediate);
 
@@ -218,18 +365,65 @@ class CVerusHashV2
 
             // get the final hash with a mutated dynamic key for each hash result
             (*haraka512KeyedFunction)(hash, curBuf, key + IntermediateTo128Offset(intermediate));
+
+            if (fStats)
+            {
+                CVerusStats::Stage(VERUS_STAGE_FINAL_HARAKA, start);
+                CVerusStats::CountSolution(solutionVersion);
+            }
         }
 
+        // equivalent to hashers[i]->Finalize2b(hashes[i]) for each i, but runs the clhash and final
+        // haraka of up to BATCH_LANES hashers with the same solution version through one call,
+        // which interleaves them where the tier supports it. hashers with their own key storage,
+        // such as those of different contexts, can share a call
+        static void Finalize2bBatch(CVerusHashV2 *const *hashers, unsigned char *const *hashes, size_t count);
+
         inline unsigned char *CurBuffer()
         {
             return curBuf;
         }
 
     private:
+        // runs haraka512 over nLanes contiguous 64 byte inputs in a buffer of BATCH_LANES inputs
+        static void HarakaLanes(unsigned char *out, const unsigned char *in, int nLanes);
+        static void Haraka256Lanes(unsigned char *out, const unsigned char *in, int nLanes);
+
+        // records a newly generated or copied key as the current one, and makes its refresh copy
+        static void SetCLKeySeed(const unsigned char *seedBytes32, unsigned char *key, verusclhash_descr *pdesc)
+        {
+            int size = pdesc->keySizeInBytes;
+            int refreshsize = verusclhasher::keymask(size) + 1;
+            pdesc->seed = *((uint256 *)seedBytes32);
+            memcpy(key + size, key, refreshsize);
+            memset((unsigned char *)key + (size + refreshsize), 0, size - refreshsize);
+        }
+
+        // restores only the entries of the current key mutated by the last clhash, which recorded
+        // them in the NULL terminated move scratch, then empties the scratch for the next pass
+        static void RestoreCLKey(unsigned char *key, verusclhash_descr *pdesc)
+        {
+            int size = pdesc->keySizeInBytes;
+            int refreshsize = verusclhasher::keymask(size) + 1;
+            __m128i **ppfixup = (__m128i **)(key + size + refreshsize);
+            uint32_t ofs = size >> 4;
+            for (__m128i **pp = ppfixup; *pp; pp++)
+            {
+                **pp = *(*pp + ofs);
+            }
+            *ppfixup = NULL;
+            if (CVerusStats::IsEnabled())
+            {
+                CVerusStats::Count(VERUS_STAT_KEYS_REUSED);
+            }
+        }
+
         // only buf1, the first source, needs to be zero initialized
         alignas(32) unsigned char buf1[64] = {0}, buf2[64];
         unsigned char *curBuf = buf1, *result = buf2;
         size_t curPos = 0;
+        size_t (*writeFunction)(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len);
+        int solutionVersion;
 };
 
 extern void verus_hash(void *result, const void *data, size_t len);
@@ -0,0 +1,84 @@
+/*
+ * ISA variants of the Haraka and clhash kernels.
+ *
+ * CMake compiles haraka.c and verus_clhash.cpp once more for each CPU tier above
+ * AES-NI, with that tier's instruction set flags, VERUS_ISA_SUFFIX defined to a
+ * name suffix and this header forced in ahead of everything else. The renames
+ * below give each variant's kernels their own names, and the variant builds leave
+ * out the shared data and helpers, which only the base build defines. The kernel
+ * dispatch table in verus_dispatch.cpp declares the variants with
+ * VERUS_ISA_DECLARE_KERNELS and picks between them at runtime.
+ *
+ * Only kernels may be renamed here. Inline functions in shared headers must not
+ * refer to them, or the variant builds would emit differing copies of those
+ * inline functions. Shared headers must also keep namespace scope objects with
+ * constructors out of the variant builds, behind #ifndef VERUS_ISA_VARIANT, as
+ * their static initializers would run the variant's instructions at load time, on
+ * any CPU. The build checks the variant objects for static initializers with
+ * cmake/CheckNoInitArray.cmake.
+ */
+#ifndef VERUS_ISA_H_
+#define VERUS_ISA_H_
+
+#define VERUS_ISA_CAT_(name, suffix) name##suffix
+#define VERUS_ISA_CAT(name, suffix) VERUS_ISA_CAT_(name, suffix)
+
+#ifdef VERUS_ISA_SUFFIX
+#define VERUS_ISA_VARIANT 1
+
+// haraka.c
+#define haraka256 VERUS_ISA_CAT(haraka256, VERUS_ISA_SUFFIX)
+#define haraka256_keyed VERUS_ISA_CAT(haraka256_keyed, VERUS_ISA_SUFFIX)
+#define haraka256_4x VERUS_ISA_CAT(haraka256_4x, VERUS_ISA_SUFFIX)
+#define haraka256_8x VERUS_ISA_CAT(haraka256_8x, VERUS_ISA_SUFFIX)
+#define haraka512 VERUS_ISA_CAT(haraka512, VERUS_ISA_SUFFIX)
+#define haraka512_zero VERUS_ISA_CAT(haraka512_zero, VERUS_ISA_SUFFIX)
+#define haraka512_keyed VERUS_ISA_CAT(haraka512_keyed, VERUS_ISA_SUFFIX)
+#define haraka512_4x VERUS_ISA_CAT(haraka512_4x, VERUS_ISA_SUFFIX)
+#define haraka512_8x VERUS_ISA_CAT(haraka512_8x, VERUS_ISA_SUFFIX)
+#define verushash2_write VERUS_ISA_CAT(verushash2_write, VERUS_ISA_SUFFIX)
+
+// verus_clhash.cpp
+#define __verusclmulwithoutreduction64alignedrepeat VERUS_ISA_CAT(__verusclmulwithoutreduction64alignedrepeat, VERUS_ISA_SUFFIX)
+#define __verusclmulwithoutreduction64alignedrepeat_sv2_1 VERUS_ISA_CAT(__verusclmulwithoutreduction64alignedrepeat_sv2_1, VERUS_ISA_SUFFIX)
+#define __verusclmulwithoutreduction64alignedrepeat_sv2_2 VERUS_ISA_CAT(__verusclmulwithoutreduction64alignedrepeat_sv2_2, VERUS_ISA_SUFFIX)
+#define verusclhash VERUS_ISA_CAT(verusclhash, VERUS_ISA_SUFFIX)
+#define verusclhash_sv2_1 VERUS_ISA_CAT(verusclhash_sv2_1, VERUS_ISA_SUFFIX)
+#define verusclhash_sv2_2 VERUS_ISA_CAT(verusclhash_sv2_2, VERUS_ISA_SUFFIX)
+#define verushash2b_finish VERUS_ISA_CAT(verushash2b_finish, VERUS_ISA_SUFFIX)
+#define verushash2b_finish_sv2_1 VERUS_ISA_CAT(verushash2b_finish_sv2_1, VERUS_ISA_SUFFIX)
+#define verushash2b_finish_sv2_2 VERUS_ISA_CAT(verushash2b_finish_sv2_2, VERUS_ISA_SUFFIX)
+#define verushash2b_finish_lanes VERUS_ISA_CAT(verushash2b_finish_lanes, VERUS_ISA_SUFFIX)
+#define verushash2b_finish_sv2_1_lanes VERUS_ISA_CAT(verushash2b_finish_sv2_1_lanes, VERUS_ISA_SUFFIX)
+#define verushash2b_finish_sv2_2_lanes VERUS_ISA_CAT(verushash2b_finish_sv2_2_lanes, VERUS_ISA_SUFFIX)
+
+#else
+
+// declares one variant's kernels, with C linkage, for the dispatch table
+#define VERUS_ISA_DECLARE_KERNELS(suffix) \
+    void haraka256##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka256_keyed##suffix(unsigned char *out, const unsigned char *in, const u128 *rc); \
+    void haraka256_4x##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka256_8x##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka512##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka512_zero##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka512_keyed##suffix(unsigned char *out, const unsigned char *in, const u128 *rc); \
+    void haraka512_4x##suffix(unsigned char *out, const unsigned char *in); \
+    void haraka512_8x##suffix(unsigned char *out, const unsigned char *in); \
+    __m128i __verusclmulwithoutreduction64alignedrepeat##suffix(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch); \
+    __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_1##suffix(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch); \
+    __m128i __verusclmulwithoutreduction64alignedrepeat_sv2_2##suffix(__m128i *randomsource, const __m128i buf[4], uint64_t keyMask, __m128i **pMoveScratch); \
+    uint64_t verusclhash##suffix(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch); \
+    uint64_t verusclhash_sv2_1##suffix(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch); \
+    uint64_t verusclhash_sv2_2##suffix(void * random, const unsigned char buf[64], uint64_t keyMask, __m128i **pMoveScratch); \
+    size_t verushash2_write##suffix(unsigned char *curBuf, size_t curPos, const unsigned char *data, size_t len); \
+    void verushash2b_finish##suffix(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch); \
+    void verushash2b_finish_sv2_1##suffix(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch); \
+    void verushash2b_finish_sv2_2##suffix(unsigned char hash[32], unsigned char *curBuf, size_t curPos, void *key, uint64_t keyMask, __m128i **pMoveScratch); \
+    void verushash2b_finish_lanes##suffix(struct verushash2b_lane *lanes, int count, uint64_t keyMask); \
+    void verushash2b_finish_sv2_1_lanes##suffix(struct verushash2b_lane *lanes, int count, uint64_t keyMask); \
+    void verushash2b_finish_sv2_2_lanes##suffix(struct verushash2b_lane *lanes, int count, uint64_t keyMask);
+
+#endif // VERUS_ISA_SUFFIX
+
+#endif // VERUS_ISA_H_
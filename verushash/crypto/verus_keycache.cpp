@@ -0,0 +1,198 @@
+#include "verus_keycache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" void *alloc_aligned_buffer(uint64_t bufSize);
+
+CVerusKeyCache &CVerusKeyCache::Shared()
+{
+    static CVerusKeyCache cache;
+    return cache;
+}
+
+CVerusKeyCache::~CVerusKeyCache()
+{
+    for (int i = 0; i < MAX_ENTRIES; i++)
+    {
+        free(entries[i].key);
+    }
+}
+
+void CVerusKeyCache::SetCapacity(uint32_t newCapacity)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (newCapacity > MAX_ENTRIES)
+    {
+        newCapacity = MAX_ENTRIES;
+    }
+    // buffers stay allocated, a reader may still be copying out of one
+    for (uint32_t i = newCapacity; i < MAX_ENTRIES; i++)
+    {
+        entries[i].tag.store(0, std::memory_order_relaxed);
+    }
+    capacity.store(newCapacity, std::memory_order_relaxed);
+}
+
+bool CVerusKeyCache::Lookup(const uint256 &seed, uint32_t keySizeInBytes, unsigned char *key)
+{
+    uint32_t cap = capacity.load(std::memory_order_relaxed);
+    if (!cap)
+    {
+        return false;
+    }
+
+    uint64_t tag = Tag(seed);
+    for (uint32_t i = 0; i < cap; i++)
+    {
+        Entry &e = entries[i];
+        if (e.tag.load(std::memory_order_relaxed) != tag)
+        {
+            continue;
+        }
+
+        // pin it, unless it is being replaced. the acquire pairs with the release that ends
+        // the write, so the seed and key it wrote are visible from here on
+        uint32_t state = e.state.load(std::memory_order_relaxed);
+        do
+        {
+            if (state & WRITING)
+            {
+                break;
+            }
+        } while (!e.state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        if (state & WRITING)
+        {
+            continue;
+        }
+
+        // the tag may have been for an entry replaced since, and only covers part of the seed
+        bool found = e.tag.load(std::memory_order_relaxed) == tag && e.keySizeInBytes == keySizeInBytes && e.seed == seed;
+        if (found)
+        {
+            memcpy(key, e.key, keySizeInBytes);
+            uint64_t now = tick.load(std::memory_order_relaxed);
+            if (e.lastUsed.load(std::memory_order_relaxed) != now)
+            {
+                e.lastUsed.store(now, std::memory_order_relaxed);
+            }
+        }
+        e.state.fetch_sub(1, std::memory_order_release);
+        if (found)
+        {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void CVerusKeyCache::Insert(const uint256 &seed, uint32_t keySizeInBytes, const unsigned char *key)
+{
+    if (!keySizeInBytes || !capacity.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    // inserts follow a key generation, which costs far more than holding the lock for the copy
+    std::lock_guard<std::mutex> lock(cs);
+    uint32_t cap = capacity.load(std::memory_order_relaxed);
+    uint64_t tag = Tag(seed);
+
+    // only inserts write entries, and they hold the lock, so entries can be read here
+    Entry *pentry = NULL;
+    for (uint32_t i = 0; i < cap; i++)
+    {
+        Entry &e = entries[i];
+        uint64_t eTag = e.tag.load(std::memory_order_relaxed);
+        if (eTag == tag && e.keySizeInBytes == keySizeInBytes && e.seed == seed)
+        {
+            return;
+        }
+        // prefer an empty entry, then the least recently used one
+        if (!pentry || (pentry->tag.load(std::memory_order_relaxed) && (!eTag || e.lastUsed.load(std::memory_order_relaxed) < pentry->lastUsed.load(std::memory_order_relaxed))))
+        {
+            pentry = &e;
+        }
+    }
+    if (!pentry)
+    {
+        return;
+    }
+
+    // an entry a reader has pinned is left alone, and the key is not cached this time
+    uint32_t idle = 0;
+    if (!pentry->state.compare_exchange_strong(idle, WRITING, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        return;
+    }
+    bool evicted = pentry->tag.load(std::memory_order_relaxed) != 0;
+    pentry->tag.store(0, std::memory_order_relaxed);
+
+    bool ok = true;
+    if (pentry->allocated < keySizeInBytes)
+    {
+        free(pentry->key);
+        pentry->allocated = 0;
+        if ((pentry->key = (unsigned char *)alloc_aligned_buffer(keySizeInBytes)) != NULL)
+        {
+            pentry->allocated = keySizeInBytes;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    if (ok)
+    {
+        memcpy(pentry->key, key, keySizeInBytes);
+        pentry->seed = seed;
+        pentry->keySizeInBytes = keySizeInBytes;
+        pentry->lastUsed.store(tick.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        pentry->tag.store(tag, std::memory_order_relaxed);
+    }
+    pentry->state.store(0, std::memory_order_release);
+
+    if (ok)
+    {
+        inserts.fetch_add(1, std::memory_order_relaxed);
+        if (evicted)
+        {
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CVerusKeyCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    for (int i = 0; i < MAX_ENTRIES; i++)
+    {
+        entries[i].tag.store(0, std::memory_order_relaxed);
+    }
+}
+
+CVerusKeyCache::Stats CVerusKeyCache::GetStats()
+{
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.inserts = inserts.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    stats.capacity = capacity.load(std::memory_order_relaxed);
+    stats.entries = 0;
+    for (uint32_t i = 0; i < stats.capacity; i++)
+    {
+        stats.entries += entries[i].tag.load(std::memory_order_relaxed) != 0;
+    }
+    return stats;
+}
+
+void CVerusKeyCache::ResetStats()
+{
+    hits.store(0, std::memory_order_relaxed);
+    misses.store(0, std::memory_order_relaxed);
+    inserts.store(0, std::memory_order_relaxed);
+    evictions.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+/*
+A bounded cache of VerusCLHash key templates keyed by seed, shared by all threads.
+
+Generating a key chains several hundred Haraka256 calls, while copying a cached template is
+a memcpy. Each thread still mutates its own working copy of the key, restored from the cache
+when the seed is not the one that thread used last. The cache pays off when threads hash the
+same data, such as several workers verifying the same headers. The seed of a VerusHash 2b key
+follows the nonce, so mining one header sees no hits, and the cache is off until given a
+capacity.
+
+Lookups take no lock. A reader finds an entry by a 64 bit tag of the seed, pins it by raising
+its reader count, which keeps writers off it, and then checks the whole seed before copying.
+Inserts, which follow generating a key, are serialized by a mutex and only replace an entry
+that no reader has pinned.
+*/
+#ifndef VERUS_KEYCACHE_H_
+#define VERUS_KEYCACHE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#include "uint256.h"
+
+class CVerusKeyCache
+{
+    public:
+        // most entries a cache can hold, each one VERUSKEYSIZE bytes
+        enum { MAX_ENTRIES = 64 };
+
+        struct Stats
+        {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t inserts;
+            uint64_t evictions;
+            uint32_t capacity;
+            uint32_t entries;
+        };
+
+        // the cache GenNewCLKey uses
+        static CVerusKeyCache &Shared();
+
+        CVerusKeyCache() : capacity(0), tick(0), hits(0), misses(0), inserts(0), evictions(0) { }
+        ~CVerusKeyCache();
+
+        // capacity 0 disables the cache, capacities above MAX_ENTRIES are clamped. shrinking
+        // drops the entries above the new capacity.
+        void SetCapacity(uint32_t entries);
+        uint32_t GetCapacity() const { return capacity.load(std::memory_order_relaxed); }
+
+        // copies the template for seed into key if it is cached, counting a hit or a miss
+        bool Lookup(const uint256 &seed, uint32_t keySizeInBytes, unsigned char *key);
+
+        // adds a freshly generated template, replacing the least recently used entry
+        void Insert(const uint256 &seed, uint32_t keySizeInBytes, const unsigned char *key);
+
+        void Clear();
+
+        Stats GetStats();
+        void ResetStats();
+
+    private:
+        // the state of an entry being replaced, with no readers
+        enum { WRITING = 0x80000000 };
+
+        // on its own cache line, since readers write to the state of the entry they copy
+        struct alignas(64) Entry
+        {
+            std::atomic<uint64_t> tag;          // Tag of the seed, 0 while empty or being written
+            std::atomic<uint32_t> state;        // copies in progress, or WRITING
+            std::atomic<uint64_t> lastUsed;
+            // written only by the insert holding the entry in WRITING
+            uint256 seed;
+            uint32_t keySizeInBytes = 0;
+            unsigned char *key = NULL;
+            uint32_t allocated = 0;
+
+            Entry() : tag(0), state(0), lastUsed(0) { }
+        };
+
+        static uint64_t Tag(const uint256 &seed) { return seed.GetCheapHash() | 1; }
+
+        std::mutex cs;
+        Entry entries[MAX_ENTRIES];
+        std::atomic<uint32_t> capacity;
+        std::atomic<uint64_t> tick;             // advanced by inserts, stamps entries as they are used
+        std::atomic<uint64_t> hits, misses, inserts, evictions;
+};
+
+#endif // VERUS_KEYCACHE_H_
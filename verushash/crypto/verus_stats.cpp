@@ -0,0 +1,122 @@
+#include "verus_stats.h"
+
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+std::atomic<bool> CVerusStats::enabled(false);
+std::atomic<CVerusStats::ThreadBlock *> CVerusStats::blocks(NULL);
+
+namespace {
+
+// totals at the last Reset, subtracted from every snapshot
+std::mutex baselineLock;
+CVerusStatsSnapshot baseline;
+
+}
+
+CVerusStats::ThreadOwner::ThreadOwner()
+{
+    // take over the block of a thread that has exited, or push a new one onto the list
+    for (block = blocks.load(std::memory_order_acquire); block; block = block->next)
+    {
+        bool expected = false;
+        if (!block->inUse.load(std::memory_order_relaxed) &&
+            block->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            return;
+        }
+    }
+
+    block = new ThreadBlock();
+    for (auto &c : block->counters) c.store(0, std::memory_order_relaxed);
+    for (auto &c : block->hashesBySolution) c.store(0, std::memory_order_relaxed);
+    for (auto &c : block->stageCalls) c.store(0, std::memory_order_relaxed);
+    for (auto &c : block->stageCycles) c.store(0, std::memory_order_relaxed);
+    for (auto &stage : block->stageBuckets)
+    {
+        for (auto &c : stage) c.store(0, std::memory_order_relaxed);
+    }
+    block->inUse.store(true, std::memory_order_relaxed);
+    block->next = blocks.load(std::memory_order_relaxed);
+    while (!blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+CVerusStats::ThreadOwner::~ThreadOwner()
+{
+    block->inUse.store(false, std::memory_order_release);
+}
+
+void CVerusStats::Sum(CVerusStatsSnapshot &snapshot)
+{
+    memset(&snapshot, 0, sizeof(snapshot));
+    for (ThreadBlock *block = blocks.load(std::memory_order_acquire); block; block = block->next)
+    {
+        for (int i = 0; i < VERUS_STAT_COUNTERS; i++)
+        {
+            snapshot.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < VERUS_STAT_SOLUTION_VERSIONS; i++)
+        {
+            snapshot.hashesBySolution[i] += block->hashesBySolution[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < VERUS_STAGE_COUNT; i++)
+        {
+            snapshot.stageCalls[i] += block->stageCalls[i].load(std::memory_order_relaxed);
+            snapshot.stageCycles[i] += block->stageCycles[i].load(std::memory_order_relaxed);
+            for (int j = 0; j < VERUS_STAT_BUCKETS; j++)
+            {
+                snapshot.stageBuckets[i][j] += block->stageBuckets[i][j].load(std::memory_order_relaxed);
+            }
+        }
+        snapshot.threads += block->inUse.load(std::memory_order_relaxed);
+    }
+}
+
+void CVerusStats::Snapshot(CVerusStatsSnapshot &snapshot)
+{
+    Sum(snapshot);
+
+    std::lock_guard<std::mutex> lock(baselineLock);
+    for (int i = 0; i < VERUS_STAT_COUNTERS; i++)
+    {
+        snapshot.counters[i] -= baseline.counters[i];
+    }
+    for (int i = 0; i < VERUS_STAT_SOLUTION_VERSIONS; i++)
+    {
+        snapshot.hashesBySolution[i] -= baseline.hashesBySolution[i];
+    }
+    for (int i = 0; i < VERUS_STAGE_COUNT; i++)
+    {
+        snapshot.stageCalls[i] -= baseline.stageCalls[i];
+        snapshot.stageCycles[i] -= baseline.stageCycles[i];
+        for (int j = 0; j < VERUS_STAT_BUCKETS; j++)
+        {
+            snapshot.stageBuckets[i][j] -= baseline.stageBuckets[i][j];
+        }
+    }
+}
+
+void CVerusStats::Reset()
+{
+    CVerusStatsSnapshot totals;
+    Sum(totals);
+
+    std::lock_guard<std::mutex> lock(baselineLock);
+    baseline = totals;
+}
+
+double CVerusStats::TicksPerSecond()
+{
+    static double ticksPerSecond = []() {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startTicks = Timestamp();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t ticks = Timestamp() - startTicks;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return ticks / seconds;
+    }();
+    return ticksPerSecond;
+}
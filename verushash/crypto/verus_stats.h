@@ -0,0 +1,158 @@
+/*
+Opt-in counters and stage timings for the VerusHash hot path.
+
+Each thread that hashes while stats are enabled gets its own block of counters, which only that
+thread writes, so recording is a relaxed load and store with no lock or shared cache line. A
+block is never freed: when its thread exits it is left for the next new thread to take over, and
+its counts carry on adding up. A snapshot walks every block and sums it without stopping the
+hashing threads, and a reset only moves the baseline that snapshots are taken against.
+
+Stage timings are in TSC cycles, kept as a total and a histogram of power of 2 buckets, bucket n
+counting calls of 2^(n-1) to 2^n - 1 cycles. With stats disabled, which is the default, each
+instrumented point costs one load and a predicted branch.
+*/
+#ifndef VERUS_STATS_H_
+#define VERUS_STATS_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#include "verus_aligned.h"
+
+#if !defined(__arm__) && !defined(__aarch64__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <chrono>
+#endif
+
+enum {
+    VERUS_STAT_SOLUTION_VERSIONS = 16   // VerusHash 2b hashes are counted by solution version below this
+};
+
+// event counters
+enum {
+    VERUS_STAT_HASHES_V1 = 0,           // VerusHash 1 hashes
+    VERUS_STAT_HASHES_V2,               // VerusHash 2 hashes, without the clhash finalization
+    VERUS_STAT_BYTES_HASHED,            // bytes written to VerusHash 1 and 2 hashers
+    VERUS_STAT_KEYS_GENERATED,          // keys generated by GenNewCLKey
+    VERUS_STAT_KEYS_CACHED,             // keys copied from the shared key cache
+    VERUS_STAT_KEYS_REUSED,             // keys restored because the seed was the last one used
+    VERUS_STAT_DESERIALIZE_FAILURES,    // serialized headers that were incomplete or invalid
+    VERUS_STAT_COUNTERS
+};
+
+// timed stages
+enum {
+    VERUS_STAGE_DESERIALIZE = 0,        // parsing a serialized header
+    VERUS_STAGE_CLEAR_NONCANONICAL,     // copying a header and clearing its non-canonical data
+    VERUS_STAGE_HARAKA_CHAIN,           // a CVerusHashV2::Write, timed per call
+    VERUS_STAGE_KEYGEN,                 // GenNewCLKey, whether generated, cached or reused
+    VERUS_STAGE_CLHASH,
+    VERUS_STAGE_FINAL_HARAKA,           // the keyed Haraka512 at the end of Finalize2b
+    VERUS_STAGE_COUNT
+};
+
+enum {
+    VERUS_STAT_BUCKETS = 40
+};
+
+struct CVerusStatsSnapshot
+{
+    uint64_t counters[VERUS_STAT_COUNTERS];
+    uint64_t hashesBySolution[VERUS_STAT_SOLUTION_VERSIONS];
+    uint64_t stageCalls[VERUS_STAGE_COUNT];
+    uint64_t stageCycles[VERUS_STAGE_COUNT];
+    uint64_t stageBuckets[VERUS_STAGE_COUNT][VERUS_STAT_BUCKETS];
+    uint32_t threads;                   // counter blocks in use by live threads
+};
+
+class CVerusStats
+{
+    public:
+        struct alignas(64) ThreadBlock : CAlignedNew<ThreadBlock>
+        {
+            std::atomic<uint64_t> counters[VERUS_STAT_COUNTERS];
+            std::atomic<uint64_t> hashesBySolution[VERUS_STAT_SOLUTION_VERSIONS];
+            std::atomic<uint64_t> stageCalls[VERUS_STAGE_COUNT];
+            std::atomic<uint64_t> stageCycles[VERUS_STAGE_COUNT];
+            std::atomic<uint64_t> stageBuckets[VERUS_STAGE_COUNT][VERUS_STAT_BUCKETS];
+            std::atomic<bool> inUse;
+            ThreadBlock *next;
+        };
+
+        static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+        static void Enable(bool fEnable) { enabled.store(fEnable, std::memory_order_relaxed); }
+
+        static inline uint64_t Timestamp()
+        {
+#if !defined(__arm__) && !defined(__aarch64__)
+            return __rdtsc();
+#elif defined(__aarch64__)
+            uint64_t ticks;
+            __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r"(ticks));
+            return ticks;
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        static inline void Count(int counter, uint64_t n=1)
+        {
+            Add(Block().counters[counter], n);
+        }
+
+        static inline void CountSolution(int solutionVersion)
+        {
+            if (solutionVersion < 0 || solutionVersion >= VERUS_STAT_SOLUTION_VERSIONS)
+            {
+                solutionVersion = VERUS_STAT_SOLUTION_VERSIONS - 1;
+            }
+            Add(Block().hashesBySolution[solutionVersion], 1);
+        }
+
+        // records a stage that started at the given Timestamp()
+        static inline void Stage(int stage, uint64_t start)
+        {
+            uint64_t cycles = Timestamp() - start;
+            ThreadBlock &block = Block();
+            Add(block.stageCalls[stage], 1);
+            Add(block.stageCycles[stage], cycles);
+            int bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+            Add(block.stageBuckets[stage][bucket < VERUS_STAT_BUCKETS ? bucket : VERUS_STAT_BUCKETS - 1], 1);
+        }
+
+        // totals since the last Reset
+        static void Snapshot(CVerusStatsSnapshot &snapshot);
+        static void Reset();
+
+        // rate of Timestamp(), measured against the steady clock on the first call
+        static double TicksPerSecond();
+
+    private:
+        // only the owning thread writes its block, so an increment needs no locked instruction
+        static inline void Add(std::atomic<uint64_t> &counter, uint64_t n)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        static inline ThreadBlock &Block()
+        {
+            static thread_local ThreadOwner owner;
+            return *owner.block;
+        }
+
+        // claims a block when its thread first records, and hands it back when the thread exits
+        struct ThreadOwner
+        {
+            ThreadBlock *block;
+            ThreadOwner();
+            ~ThreadOwner();
+        };
+
+        static void Sum(CVerusStatsSnapshot &snapshot);
+
+        static std::atomic<bool> enabled;
+        static std::atomic<ThreadBlock *> blocks;
+};
+
+#endif // VERUS_STATS_H_
@@ -0,0 +1,49 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+import (
+	"errors"
+	"unsafe"
+)
+
+// ErrInvalidCompact is returned for an nBits that is negative, overflows or is zero, none of
+// which a hash can meet.
+var ErrInvalidCompact = errors.New("verushash: invalid compact target")
+
+// Hashes and targets below are HashSize bytes, little endian as the hash functions write them,
+// and compare as 256 bit numbers.
+
+func hashPtr(b []byte, what string) *C.uchar {
+	if len(b) < HashSize {
+		panic("verushash: " + what + " shorter than HashSize")
+	}
+	return (*C.uchar)(unsafe.Pointer(&b[0]))
+}
+
+// CompactToTarget expands nBits into the first HashSize bytes of dst.
+func CompactToTarget(dst []byte, nBits uint32) error {
+	if C.verushash_compact_to_target(C.uint32_t(nBits), hashPtr(dst, "destination")) == 0 {
+		return ErrInvalidCompact
+	}
+	return nil
+}
+
+// TargetToCompact returns the nBits form of target, rounded down.
+func TargetToCompact(target []byte) uint32 {
+	return uint32(C.verushash_target_to_compact(hashPtr(target, "target")))
+}
+
+// MeetsTarget reports whether hash is at or below target.
+func MeetsTarget(hash, target []byte) bool {
+	return C.verushash_hash_meets_target(hashPtr(hash, "hash"), hashPtr(target, "target")) != 0
+}
+
+// HashDifficulty returns diff1Target / hash, the difficulty a share with the hash is credited
+// with. A zero hash gives +Inf.
+func HashDifficulty(hash, diff1Target []byte) float64 {
+	return float64(C.verushash_hash_difficulty(hashPtr(hash, "hash"), hashPtr(diff1Target, "target")))
+}
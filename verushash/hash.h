@@ -9,6 +9,7 @@
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
 #include "crypto/verus_hash.h"
+#include "crypto/verus_context.h"
 #include "crypto/uint256.h"
 #include "crypto/sodium.h"
 #include "prevector.h"
@@ -280,6 +281,12 @@ public:
         return (*this);
     }
 
+    // writes several pieces, as one write of them joined together
+    CVerusHashWriter& writev(const verus_iovec *iov, size_t count) {
+        state.WriteV(iov, count);
+        return (*this);
+    }
+
     // invalidates the object for further writing
     uint256 GetHash() {
         uint256 result;
@@ -316,6 +323,12 @@ public:
         return (*this);
     }
 
+    // writes several pieces, as one write of them joined together
+    CVerusHashV2Writer& writev(const verus_iovec *iov, size_t count) {
+        state.WriteV(iov, count);
+        return (*this);
+    }
+
     // invalidates the object for further writing
     uint256 GetHash() {
         uint256 result;
@@ -347,6 +360,10 @@ public:
     CVerusHashV2bWriter(int nTypeIn, int nVersionIn, int solutionVersion=SOLUTION_VERUSHHASH_V2, uint64_t keysize=VERUSKEYSIZE) : 
         nType(nTypeIn), nVersion(nVersionIn), state(solutionVersion) {}
 
+    // hashes with the context's key storage rather than the calling thread's
+    CVerusHashV2bWriter(int nTypeIn, int nVersionIn, CVerusHashContext &context, int solutionVersion=SOLUTION_VERUSHHASH_V2) :
+        nType(nTypeIn), nVersion(nVersionIn), state(context.GetKey(), context.GetDescr(), solutionVersion) {}
+
     void Reset() { state.Reset(); }
 
     CVerusHashV2bWriter& write(const char *pch, size_t size) {
@@ -354,6 +371,12 @@ public:
         return (*this);
     }
 
+    // writes several pieces, as one write of them joined together
+    CVerusHashV2bWriter& writev(const verus_iovec *iov, size_t count) {
+        state.WriteV(iov, count);
+        return (*this);
+    }
+
     // invalidates the object for further writing
     uint256 GetHash() {
         uint256 result;
@@ -364,6 +387,12 @@ public:
     inline int64_t *xI64p() { return state.ExtraI64Ptr(); }
     CVerusHashV2 &GetState() { return state; }
 
+    // snapshot after serializing a shared prefix, and resume from it for each hash that shares it
+    void GetMidstate(CVerusHashV2::Midstate &midstate) const { state.GetMidstate(midstate); }
+    bool SetMidstate(const CVerusHashV2::Midstate &midstate) { return state.SetMidstate(midstate); }
+    size_t ExportMidstate(unsigned char *blob, size_t blobLen) const { return state.ExportMidstate(blob, blobLen); }
+    bool ImportMidstate(const unsigned char *blob, size_t blobLen) { return state.ImportMidstate(blob, blobLen); }
+
     template<typename T>
     CVerusHashV2bWriter& operator<<(const T& obj) {
         // Serialize to this stream
@@ -410,6 +439,14 @@ uint256 SerializeVerusHashV2b(const T& obj, int solutionVersion=SOLUTION_VERUSHH
     return ss.GetHash();
 }
 
+template<typename T>
+uint256 SerializeVerusHashV2b(const T& obj, CVerusHashContext &context, int solutionVersion=SOLUTION_VERUSHHASH_V2, int nType=SER_GETHASH, int nVersion=170009)
+{
+    CVerusHashV2bWriter ss(nType, nVersion, context, solutionVersion);
+    ss << obj;
+    return ss.GetHash();
+}
+
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
@@ -0,0 +1,63 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+import (
+	"errors"
+	"unsafe"
+)
+
+// HashSize is the size of every VerusHash result.
+const HashSize = 32
+
+// ErrInvalidHeader is returned by HashV2b2Into for input that is not a complete serialized
+// block header.
+var ErrInvalidHeader = errors.New("verushash: incomplete or malformed block header")
+
+// The functions below hash src into the first HashSize bytes of dst, which must be at least
+// that long. They call the C++ hashes directly with pointers into the Go slices, so nothing
+// is copied or allocated per call, and hash with the calling OS thread's context.
+
+func HashInto(dst, src []byte) {
+	d, s, n := hashArgs(dst, src)
+	C.verushash_hash_into(d, s, n)
+}
+
+func HashV2Into(dst, src []byte) {
+	d, s, n := hashArgs(dst, src)
+	C.verushash_v2_hash_into(d, s, n)
+}
+
+func HashV2bInto(dst, src []byte) {
+	d, s, n := hashArgs(dst, src)
+	C.verushash_v2b_hash_into(d, s, n)
+}
+
+func HashV2b1Into(dst, src []byte) {
+	d, s, n := hashArgs(dst, src)
+	C.verushash_v2b1_hash_into(d, s, n)
+}
+
+// HashV2b2Into hashes a serialized block header. It zeroes dst and returns ErrInvalidHeader
+// if src is not a complete header.
+func HashV2b2Into(dst, src []byte) error {
+	d, s, n := hashArgs(dst, src)
+	if C.verushash_v2b2_hash_into(d, s, n) == 0 {
+		return ErrInvalidHeader
+	}
+	return nil
+}
+
+func hashArgs(dst, src []byte) (*C.uchar, *C.uchar, C.int) {
+	if len(dst) < HashSize {
+		panic("verushash: destination shorter than HashSize")
+	}
+	var s *C.uchar
+	if len(src) > 0 {
+		s = (*C.uchar)(unsafe.Pointer(&src[0]))
+	}
+	return (*C.uchar)(unsafe.Pointer(&dst[0])), s, C.int(len(src))
+}
@@ -0,0 +1,161 @@
+#include "headerverify.h"
+
+#include <string.h>
+
+#include "arith_uint256.h"
+#include "solutiondata.h"
+
+// offset of nBits in a serialized header
+static const size_t HEADER_BITS_OFFSET = 104;
+
+CVerusHeaderVerifier::CVerusHeaderVerifier(int nThreads) :
+    pool(nThreads < 1 ? 1 : nThreads), generation(0), busyWorkers(0), shutdown(false), nextIndex(0), nPassed(0)
+{
+    if (nThreads < 1)
+    {
+        nThreads = 1;
+    }
+    for (int i = 0; i < nThreads; i++)
+    {
+        contexts.emplace_back(new CVerusHashContext(&pool));
+    }
+    for (int i = 1; i < nThreads; i++)
+    {
+        workers.emplace_back(&CVerusHeaderVerifier::WorkerThread, this, i);
+    }
+}
+
+CVerusHeaderVerifier::~CVerusHeaderVerifier()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        shutdown = true;
+    }
+    jobReady.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    // contexts give their key storage back to the pool, so must go first
+    contexts.clear();
+}
+
+size_t CVerusHeaderVerifier::RunChunks(CVerusHashContext &context)
+{
+    size_t passedHere = 0;
+    size_t start;
+    while ((start = nextIndex.fetch_add(CHUNK_SIZE, std::memory_order_relaxed)) < job.count)
+    {
+        size_t end = start + CHUNK_SIZE < job.count ? start + CHUNK_SIZE : job.count;
+        for (size_t i = start; i < end; i++)
+        {
+            const unsigned char *pheader = job.headers[i];
+            if (!CBlockHeader::GetVerusV2Hash(pheader, job.lens[i], context, job.hashes[i]))
+            {
+                job.hashes[i].SetNull();
+                continue;
+            }
+            if (job.complete)
+            {
+                job.complete[i >> 3] |= 1 << (i & 7);
+            }
+
+            arith_uint256 target;
+            if (job.targets && !job.targets[i].IsNull())
+            {
+                target = UintToArith256(job.targets[i]);
+            }
+            else
+            {
+                // a negative, overflowing or zero target cannot be met, as in CheckProofOfWork
+                const unsigned char *pbits = pheader + HEADER_BITS_OFFSET;
+                uint32_t nBits = pbits[0] | (pbits[1] << 8) | (pbits[2] << 16) | ((uint32_t)pbits[3] << 24);
+                bool fNegative, fOverflow;
+                target.SetCompact(nBits, &fNegative, &fOverflow);
+                if (fNegative || fOverflow || target == 0)
+                {
+                    continue;
+                }
+            }
+            if (UintToArith256(job.hashes[i]) <= target)
+            {
+                job.passed[i >> 3] |= 1 << (i & 7);
+                passedHere++;
+            }
+        }
+    }
+    return passedHere;
+}
+
+void CVerusHeaderVerifier::WorkerThread(int index)
+{
+    CVerusHashContext &context = *contexts[index];
+    uint64_t lastGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            jobReady.wait(lock, [&]{ return shutdown || generation != lastGeneration; });
+            if (shutdown)
+            {
+                return;
+            }
+            lastGeneration = generation;
+        }
+
+        size_t passedHere = RunChunks(context);
+        nPassed.fetch_add(passedHere, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(cs);
+        if (--busyWorkers == 0)
+        {
+            jobDone.notify_one();
+        }
+    }
+}
+
+size_t CVerusHeaderVerifier::Verify(const unsigned char *const *headers, const size_t *lens, size_t count,
+                                    const uint256 *targets, uint256 *hashes, unsigned char *passed,
+                                    unsigned char *complete)
+{
+    memset(passed, 0, (count + 7) >> 3);
+    if (complete)
+    {
+        memset(complete, 0, (count + 7) >> 3);
+    }
+    if (!count)
+    {
+        return 0;
+    }
+
+    job.headers = headers;
+    job.lens = lens;
+    job.count = count;
+    job.targets = targets;
+    job.hashes = hashes;
+    job.passed = passed;
+    job.complete = complete;
+    nextIndex.store(0, std::memory_order_relaxed);
+    nPassed.store(0, std::memory_order_relaxed);
+
+    // only wake the workers if there is more than one chunk to share
+    bool shared = !workers.empty() && count > CHUNK_SIZE;
+    if (shared)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            busyWorkers = workers.size();
+            generation++;
+        }
+        jobReady.notify_all();
+    }
+
+    size_t passedHere = RunChunks(*contexts[0]);
+
+    if (shared)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        jobDone.wait(lock, [&]{ return busyWorkers == 0; });
+    }
+    return passedHere + nPassed.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+/*
+Batch verification of serialized block headers.
+
+A pool checking shares one at a time pays for a call into the library, a target decode and a
+256 bit compare in the caller for every share. CVerusHeaderVerifier takes any number of
+serialized headers at once, hashes each in place with the zero-copy header path, and compares
+the hash against either a target supplied with the header or the target in the header's own
+nBits. The headers are split across the calling thread and a fixed set of worker threads, each
+with its own hashing context.
+*/
+#ifndef VERUS_HEADERVERIFY_H_
+#define VERUS_HEADERVERIFY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "crypto/uint256.h"
+#include "crypto/verus_context.h"
+
+class CVerusHeaderVerifier
+{
+    public:
+        enum {
+            // headers claimed by a thread at a time. a multiple of 8, so each byte of the pass
+            // bitmap is only written by one thread
+            CHUNK_SIZE = 16
+        };
+
+        // nThreads includes the calling thread, so 1 hashes everything on the caller
+        explicit CVerusHeaderVerifier(int nThreads=1);
+        ~CVerusHeaderVerifier();
+
+        int Threads() const { return (int)contexts.size(); }
+
+        // hashes count headers, headers[i] of lens[i] bytes, into hashes[i], and sets bit i % 8
+        // of passed[i / 8] if header i is complete and its hash meets its target. the target of
+        // header i is targets[i], or the header's nBits if targets is NULL or targets[i] is null.
+        // passed must have room for (count + 7) / 8 bytes. if complete is not NULL, it gets the
+        // same bitmap of which headers were complete and hashed. returns the number that passed.
+        // calls must not overlap.
+        size_t Verify(const unsigned char *const *headers, const size_t *lens, size_t count,
+                      const uint256 *targets, uint256 *hashes, unsigned char *passed,
+                      unsigned char *complete=NULL);
+
+    private:
+        CVerusHeaderVerifier(const CVerusHeaderVerifier &) = delete;
+        CVerusHeaderVerifier &operator=(const CVerusHeaderVerifier &) = delete;
+
+        struct Job
+        {
+            const unsigned char *const *headers;
+            const size_t *lens;
+            size_t count;
+            const uint256 *targets;
+            uint256 *hashes;
+            unsigned char *passed;
+            unsigned char *complete;
+        };
+
+        void WorkerThread(int index);
+        size_t RunChunks(CVerusHashContext &context);
+
+        CVerusHashContextPool pool;
+        std::vector<std::unique_ptr<CVerusHashContext>> contexts;
+        std::vector<std::thread> workers;
+
+        std::mutex cs;
+        std::condition_variable jobReady, jobDone;
+        uint64_t generation;
+        int busyWorkers;
+        bool shutdown;
+
+        Job job;
+        std::atomic<size_t> nextIndex;
+        std::atomic<size_t> nPassed;
+};
+
+#endif // VERUS_HEADERVERIFY_H_
@@ -0,0 +1,195 @@
+#include "jobtemplates.h"
+
+#include <string.h>
+#include <thread>
+
+#include "crypto/common.h"
+
+// offsets of nTime and nBits in a serialized header
+static const size_t HEADER_TIME_OFFSET = 100;
+static const size_t HEADER_BITS_OFFSET = 104;
+
+static const int SERIALIZE_VERSION = 170009;
+
+CVerusJobTemplates::CVerusJobTemplates(int capacity) :
+    capacity(capacity < 1 ? 1 : capacity), slots(new Slot[capacity < 1 ? 1 : capacity])
+{
+}
+
+bool CVerusJobTemplates::Register(uint64_t id, const unsigned char *pheader, size_t len, size_t tailOffset,
+                                  const uint256 *target)
+{
+    CBlockHeader header;
+    try
+    {
+        CDataStream s((const char *)pheader, (const char *)pheader + len, SER_NETWORK, SERIALIZE_VERSION);
+        s >> header;
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+    if (header.nVersion != CBlockHeader::VERUS_V2 || header.hashPrevBlock.IsNull() ||
+        tailOffset < MIN_TAIL_OFFSET || tailOffset > header.nSolution.size())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registering);
+    if (Slot *live = Acquire(id))
+    {
+        Release(live);
+        return false;
+    }
+
+    // claim the first free slot from the job's home slot on
+    Slot *slot = NULL;
+    for (size_t i = 0, home = Home(id); i < (size_t)capacity; i++)
+    {
+        Slot &candidate = slots[(home + i) % capacity];
+        uint32_t expected = SLOT_FREE;
+        if (candidate.state.load(std::memory_order_relaxed) == SLOT_FREE &&
+            candidate.state.compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acquire))
+        {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (!slot)
+    {
+        return false;
+    }
+
+    Template &job = slot->job;
+    job.header = header;
+    job.nTime = header.nTime;
+    job.solutionVersion = CConstVerusSolutionVector::Version(header.nSolution);
+
+    CBlockHeader canonical(header);
+    canonical.ClearNonCanonicalData();
+    CDataStream ss(SER_GETHASH, SERIALIZE_VERSION);
+    ss << canonical;
+    job.canonical.assign(ss.begin(), ss.end());
+    job.tailStart = job.canonical.size() - header.nSolution.size() + tailOffset;
+
+    if (target && !target->IsNull())
+    {
+        job.target = UintToArith256(*target);
+        job.fTarget = true;
+    }
+    else
+    {
+        // a negative, overflowing or zero target cannot be met, as in CheckProofOfWork
+        bool fNegative, fOverflow;
+        job.target.SetCompact(header.nBits, &fNegative, &fOverflow);
+        job.fTarget = !fNegative && !fOverflow && job.target != 0;
+    }
+
+    // the midstates only depend on the template, so any hasher of the version can make them
+    CVerusHashV2 &vh2 = CVerusHashContext::ThreadContext().GetHasher(job.solutionVersion);
+    vh2.Reset();
+    vh2.Write(&job.canonical[0], HEADER_TIME_OFFSET);
+    vh2.GetMidstate(job.prefix);
+    vh2.Write(&job.canonical[HEADER_TIME_OFFSET], job.tailStart - HEADER_TIME_OFFSET);
+    vh2.GetMidstate(job.body);
+
+    slot->id.store(id, std::memory_order_relaxed);
+    slot->state.store(SLOT_LIVE, std::memory_order_release);
+    return true;
+}
+
+CVerusJobTemplates::Slot *CVerusJobTemplates::Acquire(uint64_t id)
+{
+    for (size_t i = 0, home = Home(id); i < (size_t)capacity; i++)
+    {
+        Slot &slot = slots[(home + i) % capacity];
+        if (slot.id.load(std::memory_order_relaxed) != id || slot.state.load(std::memory_order_relaxed) != SLOT_LIVE)
+        {
+            continue;
+        }
+        // a retire that has not seen this reader sees it before freeing the slot, and one that
+        // has already begun is seen here
+        slot.readers.fetch_add(1, std::memory_order_seq_cst);
+        if (slot.state.load(std::memory_order_seq_cst) == SLOT_LIVE && slot.id.load(std::memory_order_relaxed) == id)
+        {
+            return &slot;
+        }
+        Release(&slot);
+    }
+    return NULL;
+}
+
+bool CVerusJobTemplates::Retire(uint64_t id)
+{
+    // holding the slot keeps it from being freed and taken by another job, so the ID cannot
+    // change between finding the slot and marking it retiring
+    Slot *slot = Acquire(id);
+    if (!slot)
+    {
+        return false;
+    }
+    uint32_t expected = SLOT_LIVE;
+    bool fRetired = slot->state.compare_exchange_strong(expected, SLOT_RETIRING, std::memory_order_seq_cst);
+    Release(slot);
+    if (!fRetired)
+    {
+        // another retire of the same job got there first
+        return false;
+    }
+    while (slot->readers.load(std::memory_order_seq_cst))
+    {
+        std::this_thread::yield();
+    }
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+    return true;
+}
+
+CVerusJobTemplates::SubmitResult CVerusJobTemplates::Submit(uint64_t id, uint32_t nTime, const unsigned char *tail,
+                                                            size_t tailLen, CVerusHashContext &context, uint256 &hash)
+{
+    Slot *slot = Acquire(id);
+    if (!slot)
+    {
+        hash.SetNull();
+        return SUBMIT_UNKNOWN_JOB;
+    }
+    const Template &job = slot->job;
+    if (tailLen != job.canonical.size() - job.tailStart)
+    {
+        Release(slot);
+        hash.SetNull();
+        return SUBMIT_INVALID;
+    }
+
+    CVerusHashV2 &vh2 = context.GetHasher(job.solutionVersion);
+    if (nTime == job.nTime)
+    {
+        vh2.SetMidstate(job.body);
+    }
+    else
+    {
+        unsigned char time[4];
+        WriteLE32(time, nTime);
+        vh2.SetMidstate(job.prefix);
+        vh2.Write(time, sizeof(time));
+        vh2.Write(&job.canonical[HEADER_BITS_OFFSET], job.tailStart - HEADER_BITS_OFFSET);
+    }
+    vh2.Write(tail, tailLen);
+    vh2.Finalize2b(hash.begin());
+
+    SubmitResult result = job.fTarget && UintToArith256(hash) <= job.target ? SUBMIT_PASSED : SUBMIT_REJECTED;
+    Release(slot);
+    return result;
+}
+
+bool CVerusJobTemplates::GetHeader(uint64_t id, CBlockHeader &header)
+{
+    Slot *slot = Acquire(id);
+    if (!slot)
+    {
+        return false;
+    }
+    header = slot->job.header;
+    Release(slot);
+    return true;
+}
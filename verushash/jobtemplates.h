@@ -0,0 +1,122 @@
+/*
+Job templates for checking shares from only the fields a miner changes.
+
+A pool hands out a job as a block header, and every share for it comes back as the same header
+with a new nTime and nNonce and the end of nSolution changed. CVerusJobTemplates keeps the
+canonical form of each live job's header, keyed by job ID, with the hashing state after its
+unchanging prefix and its target, so a share is hashed from the fields that change instead of
+a whole serialized header.
+
+The nonce is one of the fields cleared before hashing, so it is not needed to hash a share. The
+template's solution descriptor, and so its solution version, is fixed for all of its shares.
+
+Templates live in a fixed table of slots. Submitting looks a job up and holds its slot with a
+count of readers, without locking, so any number of threads can check shares at once.
+Registering claims a free slot under a lock that only other registrations take, and retiring
+waits for the readers of a slot to finish before freeing it, neither of which blocks submits to
+other jobs.
+*/
+#ifndef VERUS_JOBTEMPLATES_H_
+#define VERUS_JOBTEMPLATES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "arith_uint256.h"
+#include "solutiondata.h"
+#include "crypto/uint256.h"
+#include "crypto/verus_context.h"
+
+class CVerusJobTemplates
+{
+    public:
+        enum {
+            DEFAULT_CAPACITY = 64,
+            // shares may not change the solution descriptor, which sets the solution version
+            // and whether the MMR roots are cleared
+            MIN_TAIL_OFFSET = sizeof(CPBaaSSolutionDescriptor)
+        };
+
+        enum SubmitResult {
+            SUBMIT_UNKNOWN_JOB = -2,    // no live job has the ID
+            SUBMIT_INVALID = -1,        // the tail does not fit the job's solution
+            SUBMIT_REJECTED = 0,        // hashed, above the target
+            SUBMIT_PASSED = 1           // hashed, at or below the target
+        };
+
+        explicit CVerusJobTemplates(int capacity=DEFAULT_CAPACITY);
+
+        int Capacity() const { return capacity; }
+
+        // adds a job from its serialized header, which must be a complete VerusHash 2 header,
+        // not a genesis header. shares replace the bytes of the solution from tailOffset on,
+        // which must be at least MIN_TAIL_OFFSET. the target is used if not NULL or null, and
+        // the header's nBits otherwise. returns false for a header that cannot be a template,
+        // an ID that is already live, or if every slot is in use. registrations are serialized
+        // with each other, so the same ID registered by two threads at once is added once.
+        bool Register(uint64_t id, const unsigned char *pheader, size_t len, size_t tailOffset,
+                      const uint256 *target=NULL);
+
+        // removes a job, once submits already hashing against it have finished. returns false
+        // if no live job has the ID.
+        bool Retire(uint64_t id);
+
+        // hashes the job's header with nTime and the end of the solution replaced by tail,
+        // with the context's hasher, into hash, and checks the hash against the job's target
+        SubmitResult Submit(uint64_t id, uint32_t nTime, const unsigned char *tail, size_t tailLen,
+                            CVerusHashContext &context, uint256 &hash);
+
+        // the job's header as registered, without the non-canonical fields cleared. returns
+        // false if no live job has the ID.
+        bool GetHeader(uint64_t id, CBlockHeader &header);
+
+    private:
+        CVerusJobTemplates(const CVerusJobTemplates &) = delete;
+        CVerusJobTemplates &operator=(const CVerusJobTemplates &) = delete;
+
+        enum {
+            SLOT_FREE = 0,
+            SLOT_WRITING,
+            SLOT_LIVE,
+            SLOT_RETIRING
+        };
+
+        struct Template
+        {
+            CBlockHeader header;
+            std::vector<unsigned char> canonical;   // serialized with the non-canonical data cleared
+            size_t tailStart;                       // offset of the tail in canonical
+            uint32_t nTime;
+            int solutionVersion;
+            arith_uint256 target;
+            bool fTarget;                           // false if the target cannot be met
+            CVerusHashV2::Midstate prefix;          // through the bytes before nTime
+            CVerusHashV2::Midstate body;            // through the bytes before the tail
+        };
+
+        struct Slot : CAlignedNew<Slot>
+        {
+            std::atomic<uint32_t> state;
+            std::atomic<uint64_t> id;
+            std::atomic<uint32_t> readers;      // submits holding the slot
+            Template job;
+
+            Slot() : state(SLOT_FREE), id(0), readers(0) { }
+        };
+
+        // returns the live slot for id, held for reading, or NULL
+        Slot *Acquire(uint64_t id);
+        static void Release(Slot *slot) { slot->readers.fetch_sub(1, std::memory_order_release); }
+
+        size_t Home(uint64_t id) const { return (id * 0x9e3779b97f4a7c15ULL) % capacity; }
+
+        int capacity;
+        std::unique_ptr<Slot[]> slots;
+        std::mutex registering;                 // held from the live check until the slot is live
+};
+
+#endif // VERUS_JOBTEMPLATES_H_
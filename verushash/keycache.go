@@ -0,0 +1,48 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+// KeyCacheMaxEntries is the most keys the shared key cache holds.
+const KeyCacheMaxEntries = C.VERUSHASH_KEYCACHE_MAX_ENTRIES
+
+// KeyCacheStats holds the counters of the key cache that every context shares, since the last
+// ResetKeyCacheStats, with its capacity and the keys it holds now. They are kept whether or
+// not EnableStats is on.
+type KeyCacheStats struct {
+	Hits      uint64
+	Misses    uint64
+	Inserts   uint64
+	Evictions uint64
+	Capacity  int
+	Entries   int
+}
+
+// SetKeyCacheCapacity sets how many generated VerusCLHash keys the shared cache holds, and
+// returns the capacity set, which is at most KeyCacheMaxEntries. The cache is off, at 0, by
+// default. It saves regenerating a key when several contexts hash the same data, such as
+// workers verifying the same headers, but mining a header sees no hits, since the key
+// changes with the nonce.
+func SetKeyCacheCapacity(entries int) int {
+	return int(C.verushash_keycache_set_capacity(C.int(entries)))
+}
+
+// ReadKeyCacheStats fills stats without taking a lock or slowing down hashing.
+func ReadKeyCacheStats(stats *KeyCacheStats) {
+	var cs C.verushash_keycache_stats
+	C.verushash_keycache_stats_snapshot(&cs)
+
+	stats.Hits = uint64(cs.hits)
+	stats.Misses = uint64(cs.misses)
+	stats.Inserts = uint64(cs.inserts)
+	stats.Evictions = uint64(cs.evictions)
+	stats.Capacity = int(cs.capacity)
+	stats.Entries = int(cs.entries)
+}
+
+// ResetKeyCacheStats starts the key cache counters over from zero.
+func ResetKeyCacheStats() {
+	C.verushash_keycache_stats_reset()
+}
@@ -0,0 +1,147 @@
+package VH
+
+/*
+#include <stdint.h>
+#include "verushash_c.h"
+
+// the worker holds its context as an integer, because Go boxes pointers to incomplete C types
+// on every cgo call that takes them
+static inline int verushash_worker_hash_into(uintptr_t ctx, int version, unsigned char *dst,
+                                             const unsigned char *src, int length)
+{
+    return verushash_context_hash_into((verushash_context *)ctx, version, dst, src, length);
+}
+*/
+import "C"
+
+import (
+	"errors"
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+// Version selects the hash a Pool job runs.
+type Version int
+
+const (
+	V1   Version = C.VERUSHASH_V1
+	V2   Version = C.VERUSHASH_V2
+	V2b  Version = C.VERUSHASH_V2B
+	V2b1 Version = C.VERUSHASH_V2B1
+	V2b2 Version = C.VERUSHASH_V2B2
+)
+
+// ErrPoolClosed is returned for jobs submitted to a Pool after Close.
+var ErrPoolClosed = errors.New("verushash: pool is closed")
+
+// ErrUnknownVersion is set on jobs with a Version the library does not have.
+var ErrUnknownVersion = errors.New("verushash: unknown hash version")
+
+// Job is one hash for a Pool. The worker hashes Src into the first 32 bytes of Dst, sets Err,
+// and then sends the job to Done.
+type Job struct {
+	Version Version
+	Dst     []byte
+	Src     []byte
+	Err     error
+	Done    chan<- *Job
+}
+
+// Pool hashes on a fixed set of workers. Each worker stays locked to its own OS thread and
+// owns a native hashing context, so generated keys and key storage stay with the worker
+// instead of following the goroutine scheduler from thread to thread.
+type Pool struct {
+	jobs    chan *Job
+	mu      sync.RWMutex
+	closed  bool
+	workers sync.WaitGroup
+	syncs   sync.Pool
+}
+
+// NewPool starts workers workers.
+func NewPool(workers int) *Pool {
+	if workers < 1 {
+		workers = 1
+	}
+	p := &Pool{jobs: make(chan *Job, workers)}
+	p.syncs.New = func() interface{} {
+		done := make(chan *Job, 1)
+		return &syncJob{Job: Job{Done: done}, done: done}
+	}
+	p.workers.Add(workers)
+	for i := 0; i < workers; i++ {
+		go p.work()
+	}
+	return p
+}
+
+func (p *Pool) work() {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+	defer p.workers.Done()
+
+	native := C.verushash_context_new()
+	defer C.verushash_context_free(native)
+	ctx := C.uintptr_t(uintptr(unsafe.Pointer(native)))
+
+	for job := range p.jobs {
+		dst, src, n := hashArgs(job.Dst, job.Src)
+		job.Err = nil
+		if C.verushash_worker_hash_into(ctx, C.int(job.Version), dst, src, n) == 0 {
+			if job.Version == V2b2 {
+				job.Err = ErrInvalidHeader
+			} else {
+				job.Err = ErrUnknownVersion
+			}
+		}
+		job.Done <- job
+	}
+}
+
+// Submit queues a job, blocking while every worker is busy and the queue is full. The job is
+// sent to job.Done when it is finished, so Done needs room for it or a reader.
+func (p *Pool) Submit(job *Job) error {
+	if len(job.Dst) < HashSize {
+		// checked here, where it panics in the caller rather than in a worker
+		panic("verushash: destination shorter than HashSize")
+	}
+	p.mu.RLock()
+	defer p.mu.RUnlock()
+	if p.closed {
+		return ErrPoolClosed
+	}
+	p.jobs <- job
+	return nil
+}
+
+type syncJob struct {
+	Job
+	done chan *Job
+}
+
+// Hash runs one hash on the pool and waits for it.
+func (p *Pool) Hash(version Version, dst, src []byte) error {
+	sj := p.syncs.Get().(*syncJob)
+	sj.Version, sj.Dst, sj.Src = version, dst, src
+	err := p.Submit(&sj.Job)
+	if err == nil {
+		<-sj.done
+		err = sj.Err
+	}
+	sj.Dst, sj.Src = nil, nil
+	p.syncs.Put(sj)
+	return err
+}
+
+// Close lets the workers finish the jobs already queued, then stops them and frees their
+// native contexts. Later submissions fail with ErrPoolClosed.
+func (p *Pool) Close() {
+	p.mu.Lock()
+	if !p.closed {
+		p.closed = true
+		close(p.jobs)
+	}
+	p.mu.Unlock()
+	p.workers.Wait()
+}
@@ -301,6 +301,14 @@ public:
         return *item_ptr(pos);
     }
 
+    value_type* data() {
+        return item_ptr(0);
+    }
+
+    const value_type* data() const {
+        return item_ptr(0);
+    }
+
     void resize(size_type new_size) {
         while (size() > new_size) {
             item_ptr(size() - 1)->~T();
@@ -315,6 +323,20 @@ public:
         }
     }
 
+    /** Changes the size without constructing or clearing the added elements, which the caller
+     *  must write before reading them. This is for types like unsigned char that are filled
+     *  straight from a stream. */
+    void resize_uninitialized(size_type new_size) {
+        if (new_size < size()) {
+            resize(new_size);
+            return;
+        }
+        if (new_size > capacity()) {
+            change_capacity(new_size);
+        }
+        _size += new_size - size();
+    }
+
     void reserve(size_type new_capacity) {
         if (new_capacity > capacity()) {
             change_capacity(new_capacity);
@@ -8,6 +8,7 @@
 #include "crypto/uint256.h"
 #include "limits.h"
 #include "hash.h"
+#include "prevector.h"
 #include "streams.h"
 #include "tinyformat.h"
 
@@ -243,7 +244,8 @@ class CPBaaSSolutionDescriptor
             version(ver), descrBits(descr), numPBaaSHeaders(numSubHeaders), extraDataSize(sSize), hashPrevMMRRoot(PrevMMRRoot), hashBlockMMRRoot(TransactionMMRRoot)
         {}
 
-        CPBaaSSolutionDescriptor(const std::vector<unsigned char> &vch)
+        template <typename V>
+        CPBaaSSolutionDescriptor(const V &vch)
         {
             assert(vch.size() >= sizeof(*this));
 
@@ -256,7 +258,8 @@ class CPBaaSSolutionDescriptor
             memcpy(hashBlockMMRRoot.begin(), &(vch[8 + sizeof(hashBlockMMRRoot)]), sizeof(hashBlockMMRRoot));
         }
 
-        void SetVectorBase(std::vector<unsigned char> &vch)
+        template <typename V>
+        void SetVectorBase(V &vch)
         {
             if (vch.size() >= sizeof(*this))
             {
@@ -275,6 +278,7 @@ class CPBaaSSolutionDescriptor
         }
 };
 
+// the helpers work on any byte container with size() and [], a header's solution or a std::vector
 class CConstVerusSolutionVector
 {
     public:
@@ -292,7 +296,8 @@ class CConstVerusSolutionVector
             return activationHeight.ActiveVersion(height);
         }
 
-        static uint32_t Version(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static uint32_t Version(const V &vch)
         {
             if (activationHeight.ActiveVersion(0x7fffffff) > 0)
             {
@@ -304,7 +309,8 @@ class CConstVerusSolutionVector
             }
         }
 
-        static bool SetVersion(std::vector<unsigned char> &vch, uint32_t v)
+        template <typename V>
+        static bool SetVersion(V &vch, uint32_t v)
         {
             CPBaaSSolutionDescriptor psd = CPBaaSSolutionDescriptor(vch);
             psd.version = v;
@@ -319,39 +325,46 @@ class CConstVerusSolutionVector
             }
         }
 
-        static bool SetVersionByHeight(std::vector<unsigned char> &vch, uint32_t height)
+        template <typename V>
+        static bool SetVersionByHeight(V &vch, uint32_t height)
         {
             return SetVersion(vch, activationHeight.ActiveVersion(height));
         }
 
-        static void SetDescriptor(std::vector<unsigned char> &vch, CPBaaSSolutionDescriptor d)
+        template <typename V>
+        static void SetDescriptor(V &vch, CPBaaSSolutionDescriptor d)
         {
             d.SetVectorBase(vch);
         }
 
-        static CPBaaSSolutionDescriptor GetDescriptor(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static CPBaaSSolutionDescriptor GetDescriptor(const V &vch)
         {
             return CPBaaSSolutionDescriptor(vch);
         }
 
-        static uint32_t DescriptorBits(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static uint32_t DescriptorBits(const V &vch)
         {
             return GetDescriptor(vch).descrBits;
         }
 
-        static uint32_t GetNumPBaaSHeaders(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static uint32_t GetNumPBaaSHeaders(const V &vch)
         {
             return GetDescriptor(vch).numPBaaSHeaders;
         }
 
-        static uint32_t MaxPBaaSHeaders(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static uint32_t MaxPBaaSHeaders(const V &vch)
         {
             auto descr = GetDescriptor(vch);
 
             return descr.extraDataSize ? descr.numPBaaSHeaders : descr.numPBaaSHeaders + (uint32_t)(ExtraDataLen(vch) / sizeof(CPBaaSBlockHeader));
         }
 
-        static bool SetDescriptorBits(std::vector<unsigned char> &vch, uint8_t dBits)
+        template <typename V>
+        static bool SetDescriptorBits(V &vch, uint8_t dBits)
         {
             CPBaaSSolutionDescriptor psd = CPBaaSSolutionDescriptor(vch);
             psd.descrBits = dBits;
@@ -367,7 +380,8 @@ class CConstVerusSolutionVector
         }
 
         // returns 0 if not PBaaS, 1 if PBaaS PoW, -1 if PBaaS PoS
-        static int32_t IsAdvancedSolution(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static int32_t IsAdvancedSolution(const V &vch)
         {
             if (Version(vch) >= CActivationHeight::ACTIVATE_PBAAS)
             {
@@ -376,7 +390,8 @@ class CConstVerusSolutionVector
             return 0;
         }
 
-        static int32_t HasPBaaSHeader(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static int32_t HasPBaaSHeader(const V &vch)
         {
             if (Version(vch) >= CActivationHeight::ACTIVATE_PBAAS_HEADER)
             {
@@ -385,19 +400,23 @@ class CConstVerusSolutionVector
             return 0;
         }
 
-        static const CPBaaSBlockHeader *GetFirstPBaaSHeader(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static const CPBaaSBlockHeader *GetFirstPBaaSHeader(const V &vch)
         {
             return (CPBaaSBlockHeader *)(&vch[0] + sizeof(CPBaaSSolutionDescriptor)); // any headers present are right after descriptor
         }
 
-        static void SetPBaaSHeader(std::vector<unsigned char> &vch, const CPBaaSBlockHeader &pbh, int32_t idx);
+        template <typename V>
+        static void SetPBaaSHeader(V &vch, const CPBaaSBlockHeader &pbh, int32_t idx);
 
-        static uint32_t HeadersOverheadSize(const std::vector<unsigned char> &vch)
+        template <typename V>
+        static uint32_t HeadersOverheadSize(const V &vch)
         {
             return GetDescriptor(vch).numPBaaSHeaders * sizeof(CPBaaSBlockHeader) + OVERHEAD_SIZE;
         }
 
-        static uint32_t ExtraDataLen(const std::vector<unsigned char> &vch, bool allowPBaaSHeader=false)
+        template <typename V>
+        static uint32_t ExtraDataLen(const V &vch, bool allowPBaaSHeader=false)
         {
             int len;
 
@@ -415,7 +434,8 @@ class CConstVerusSolutionVector
         }
 
         // return a pointer to the bytes that contain the internal data for this solution vector
-        const unsigned char *ExtraDataPtr(const std::vector<unsigned char> &vch)
+        template <typename V>
+        const unsigned char *ExtraDataPtr(const V &vch)
         {
             if (ExtraDataLen(vch))
             {
@@ -429,15 +449,19 @@ class CConstVerusSolutionVector
 };
 
 
+// the solution of a block header. the standard size solution is kept inline, so a header can be
+// deserialized, copied, and cleared again and again without allocating. longer ones go on the heap
+typedef prevector<CConstVerusSolutionVector::SOLUTION_SIZE, unsigned char> CBlockSolution;
+
 class CVerusSolutionVector
 {
     private:
-        std::vector<unsigned char> &vch;
+        CBlockSolution &vch;
 
     public:
         static CConstVerusSolutionVector solutionTools;
 
-        CVerusSolutionVector(std::vector<unsigned char> &_vch) : vch(_vch) { }
+        CVerusSolutionVector(CBlockSolution &_vch) : vch(_vch) { }
 
         static uint32_t GetVersionByHeight(uint32_t height)
         {
@@ -615,7 +639,7 @@ public:
     uint32_t nTime;
     uint32_t nBits;
     CPOSNonce nNonce;
-    std::vector<unsigned char> nSolution;
+    CBlockSolution nSolution;
 
     CBlockHeader()
     {
@@ -654,6 +678,13 @@ public:
     }
 
     uint256 GetVerusV2Hash() const;
+    uint256 GetVerusV2Hash(CVerusHashContext &context) const;
+
+    // same result as deserializing a header from the first len bytes at pheader and calling
+    // GetVerusV2Hash on it, but hashes the serialized bytes in place, substituting zeros for the
+    // non-canonical fields as they are written, without copying or allocating. returns false if
+    // the bytes do not hold a complete header, or a VerusHash 2 header holds no solution descriptor.
+    static bool GetVerusV2Hash(const unsigned char *pheader, size_t len, CVerusHashContext &context, uint256 &hash);
 
     int32_t HasPBaaSHeader() const
     {
@@ -667,7 +698,7 @@ public:
     // return a vector of bytes that contains the internal data for this solution vector
     void GetExtraData(std::vector<unsigned char> &dataVec) const
     {
-        std::vector<unsigned char> writeSolution = nSolution;
+        CBlockSolution writeSolution = nSolution;
         CVerusSolutionVector(writeSolution).GetExtraData(dataVec);
     }
 
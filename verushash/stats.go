@@ -0,0 +1,120 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+import (
+	"time"
+	"unsafe"
+)
+
+// Stage is a timed step of hashing a header.
+type Stage int
+
+const (
+	StageDeserialize       Stage = C.VERUSHASH_STAGE_DESERIALIZE
+	StageClearNonCanonical Stage = C.VERUSHASH_STAGE_CLEAR_NONCANONICAL
+	StageHarakaChain       Stage = C.VERUSHASH_STAGE_HARAKA_CHAIN
+	StageKeygen            Stage = C.VERUSHASH_STAGE_KEYGEN
+	StageCLHash            Stage = C.VERUSHASH_STAGE_CLHASH
+	StageFinalHaraka       Stage = C.VERUSHASH_STAGE_FINAL_HARAKA
+	StageCount                   = C.VERUSHASH_STAGES
+)
+
+var stageNames = [StageCount]string{"deserialize", "clear_noncanonical", "haraka_chain", "keygen", "clhash", "final_haraka"}
+
+func (s Stage) String() string {
+	if s < 0 || s >= StageCount {
+		return "unknown"
+	}
+	return stageNames[s]
+}
+
+const (
+	// StatSolutionVersions is the number of solution versions VerusHash 2b hashes are counted
+	// by. Higher versions are counted in the last one.
+	StatSolutionVersions = C.VERUSHASH_STAT_SOLUTION_VERSIONS
+	// StatBuckets is the number of buckets in each stage histogram.
+	StatBuckets = C.VERUSHASH_STAT_BUCKETS
+)
+
+// StageStats holds the timings of one stage, in cycles of the CPU's timestamp counter.
+type StageStats struct {
+	Calls  uint64
+	Cycles uint64
+	// Buckets[n] counts calls that took 2^(n-1) to 2^n - 1 cycles, and the last bucket
+	// everything longer.
+	Buckets [StatBuckets]uint64
+}
+
+// Stats holds the counters and stage timings summed over every thread since the last
+// ResetStats. Only hashing done while stats are enabled is counted.
+type Stats struct {
+	HashesV1            uint64
+	HashesV2            uint64
+	HashesBySolution    [StatSolutionVersions]uint64 // VerusHash 2b hashes
+	BytesHashed         uint64
+	KeysGenerated       uint64
+	KeysCached          uint64 // copied from the shared key cache
+	KeysReused          uint64 // restored because the key was the last one the context used
+	DeserializeFailures uint64
+	Stages              [StageCount]StageStats
+	Threads             int // native threads holding counters
+	CyclesPerSecond     float64
+}
+
+// Duration converts a number of cycles from a stage timing to time.
+func (s *Stats) Duration(cycles uint64) time.Duration {
+	if s.CyclesPerSecond <= 0 {
+		return 0
+	}
+	return time.Duration(float64(cycles) / s.CyclesPerSecond * float64(time.Second))
+}
+
+// EnableStats turns counting on or off for every thread. It is off by default, and costs a
+// load and a branch per instrumented point while off.
+func EnableStats(enable bool) {
+	var e C.int
+	if enable {
+		e = 1
+	}
+	C.verushash_stats_enable(e)
+}
+
+func StatsEnabled() bool {
+	return C.verushash_stats_enabled() != 0
+}
+
+// ReadStats fills stats with the totals since the last ResetStats, without stopping or
+// slowing down hashing on other threads.
+func ReadStats(stats *Stats) {
+	var cs C.verushash_stats
+	C.verushash_stats_snapshot(&cs)
+
+	stats.HashesV1 = uint64(cs.counters[C.VERUSHASH_STAT_HASHES_V1])
+	stats.HashesV2 = uint64(cs.counters[C.VERUSHASH_STAT_HASHES_V2])
+	for i := range stats.HashesBySolution {
+		stats.HashesBySolution[i] = uint64(cs.hashes_by_solution[i])
+	}
+	stats.BytesHashed = uint64(cs.counters[C.VERUSHASH_STAT_BYTES_HASHED])
+	stats.KeysGenerated = uint64(cs.counters[C.VERUSHASH_STAT_KEYS_GENERATED])
+	stats.KeysCached = uint64(cs.counters[C.VERUSHASH_STAT_KEYS_CACHED])
+	stats.KeysReused = uint64(cs.counters[C.VERUSHASH_STAT_KEYS_REUSED])
+	stats.DeserializeFailures = uint64(cs.counters[C.VERUSHASH_STAT_DESERIALIZE_FAILURES])
+	for i := range stats.Stages {
+		stage := &stats.Stages[i]
+		stage.Calls = uint64(cs.stage_calls[i])
+		stage.Cycles = uint64(cs.stage_cycles[i])
+		buckets := (*[StatBuckets]uint64)(unsafe.Pointer(&cs.stage_buckets[i][0]))
+		stage.Buckets = *buckets
+	}
+	stats.Threads = int(cs.threads)
+	stats.CyclesPerSecond = float64(C.verushash_stats_cycles_per_second())
+}
+
+// ResetStats starts the totals over from zero.
+func ResetStats() {
+	C.verushash_stats_reset()
+}
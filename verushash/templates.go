@@ -0,0 +1,120 @@
+package VH
+
+/*
+#include "verushash_c.h"
+*/
+import "C"
+
+import (
+	"errors"
+	"sync"
+	"unsafe"
+)
+
+var (
+	// ErrTemplatesClosed is returned by Templates after Close.
+	ErrTemplatesClosed = errors.New("verushash: templates are closed")
+	// ErrInvalidTemplate is returned by Register for a header that cannot be a job template,
+	// an ID that is already registered, or when every slot is in use.
+	ErrInvalidTemplate = errors.New("verushash: cannot register job template")
+	// ErrUnknownJob is returned by Submit and Retire for an ID with no registered job.
+	ErrUnknownJob = errors.New("verushash: unknown job")
+	// ErrInvalidShare is returned by Submit for a tail that does not fit the job's solution.
+	ErrInvalidShare = errors.New("verushash: share does not fit its job")
+)
+
+// DefaultTemplateCapacity is the number of live jobs NewTemplates(0) has room for.
+const DefaultTemplateCapacity = 64
+
+// Templates checks shares against registered jobs from only the fields a share changes: its
+// nTime and the end of its solution. Each job keeps its canonical header, the hashing state
+// after the part shares do not change, and its target. Submit may be called from any number of
+// goroutines at once, and does not wait on Register or Retire. Register may also be called
+// from several goroutines; registrations wait for each other, so an ID registered twice at once
+// is added once.
+type Templates struct {
+	mu     sync.RWMutex
+	native *C.verushash_templates
+}
+
+// NewTemplates returns Templates with room for capacity live jobs, or
+// DefaultTemplateCapacity if capacity is not positive.
+func NewTemplates(capacity int) *Templates {
+	if capacity <= 0 {
+		capacity = DefaultTemplateCapacity
+	}
+	return &Templates{native: C.verushash_templates_new(C.int(capacity))}
+}
+
+// Close frees the jobs. It waits for submits in progress.
+func (t *Templates) Close() {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if t.native != nil {
+		C.verushash_templates_free(t.native)
+		t.native = nil
+	}
+}
+
+// Register adds job id from a serialized VerusHash 2 header. Shares for it replace the bytes of
+// its solution from tailOffset on, which must be at least 72, past the solution descriptor.
+// target is nil, or a 32 byte little endian target. A nil or all zero target checks shares
+// against the header's own nBits.
+func (t *Templates) Register(id uint64, header []byte, tailOffset int, target []byte) error {
+	if target != nil && len(target) < HashSize {
+		panic("verushash: target shorter than 32 bytes")
+	}
+	var h, ptarget *C.uchar
+	if len(header) > 0 {
+		h = (*C.uchar)(unsafe.Pointer(&header[0]))
+	}
+	if target != nil {
+		ptarget = (*C.uchar)(unsafe.Pointer(&target[0]))
+	}
+
+	t.mu.RLock()
+	defer t.mu.RUnlock()
+	if t.native == nil {
+		return ErrTemplatesClosed
+	}
+	if C.verushash_templates_register(t.native, C.uint64_t(id), h, C.int(len(header)), C.int(tailOffset), ptarget) == 0 {
+		return ErrInvalidTemplate
+	}
+	return nil
+}
+
+// Retire removes job id, once submits hashing against it have finished.
+func (t *Templates) Retire(id uint64) error {
+	t.mu.RLock()
+	defer t.mu.RUnlock()
+	if t.native == nil {
+		return ErrTemplatesClosed
+	}
+	if C.verushash_templates_retire(t.native, C.uint64_t(id)) == 0 {
+		return ErrUnknownJob
+	}
+	return nil
+}
+
+// Submit hashes a share of job id into the first 32 bytes of dst: the job's header with nTime
+// and the solution from the job's tail offset on replaced by tail. It reports whether the hash
+// is at or below the job's target. The share's nNonce is not needed, as it is cleared before
+// hashing. Submit hashes with the calling OS thread's context.
+func (t *Templates) Submit(dst []byte, id uint64, nTime uint32, tail []byte) (bool, error) {
+	d, s, n := hashArgs(dst, tail)
+
+	t.mu.RLock()
+	defer t.mu.RUnlock()
+	if t.native == nil {
+		return false, ErrTemplatesClosed
+	}
+	switch C.verushash_templates_submit(t.native, nil, C.uint64_t(id), C.uint32_t(nTime), s, n, d) {
+	case C.VERUSHASH_SHARE_PASSED:
+		return true, nil
+	case C.VERUSHASH_SHARE_REJECTED:
+		return false, nil
+	case C.VERUSHASH_SHARE_UNKNOWN_JOB:
+		return false, ErrUnknownJob
+	}
+	return false, ErrInvalidShare
+}
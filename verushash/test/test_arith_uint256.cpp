@@ -0,0 +1,244 @@
+/*
+Unit vectors for arith_uint256, the 64 bit limb arithmetic behind targets, nBits and share
+difficulty.
+
+Division is checked against fixed quotients, covering one limb divisors, normalized and
+unnormalized multi-limb divisors and dividends that take the add-back step of Knuth's
+algorithm D, and against a bit by bit long division on random operands. The compact vectors
+are the upstream SetCompact and GetCompact ones. Prints each mismatch and exits non-zero if
+there were any.
+
+    test_arith_uint256
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "arith_uint256.h"
+#include "crypto/uint256.h"
+
+static int testFailures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) \
+        { \
+            printf("ERROR: %s, %s:%d: ", __func__, __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// xorshift64*, only for test data
+static uint64_t testSeed = 0x2545f4914f6cdd1dULL;
+
+static uint64_t TestRand()
+{
+    testSeed ^= testSeed >> 12;
+    testSeed ^= testSeed << 25;
+    testSeed ^= testSeed >> 27;
+    return testSeed * 0x2545f4914f6cdd1dULL;
+}
+
+// limbs that are mostly zero, one or all ones, or random, with the high limbs cleared at random
+static arith_uint256 TestNumber()
+{
+    static const uint64_t edges[] = { 0, 1, 2, ~(uint64_t)0, ~(uint64_t)1, (uint64_t)1 << 63,
+                                      ((uint64_t)1 << 63) - 1, ((uint64_t)1 << 63) + 1 };
+    arith_uint256 n;
+    int limbs = 1 + TestRand() % 4;
+    for (int i = limbs - 1; i >= 0; i--)
+    {
+        uint64_t r = TestRand();
+        n <<= 64;
+        n |= (r & 3) ? edges[(r >> 2) % 8] : TestRand();
+    }
+    return n;
+}
+
+// restoring long division, one bit at a time
+static arith_uint256 LongDivide(const arith_uint256 &a, const arith_uint256 &b, arith_uint256 &rem)
+{
+    arith_uint256 q;
+    rem = 0;
+    for (int i = 255; i >= 0; i--)
+    {
+        rem <<= 1;
+        if (((a >> i) & arith_uint256(1)) != 0)
+        {
+            rem |= 1;
+        }
+        if (rem >= b)
+        {
+            rem -= b;
+            q |= arith_uint256(1) << i;
+        }
+    }
+    return q;
+}
+
+static void TestDivision()
+{
+    static const struct {
+        const char *dividend, *divisor, *quotient;
+    } vectors[] = {
+        // one limb divisors
+        { "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", "0000000000000000000000000000000000000000000000000000000000000003", "5555555555555555555555555555555555555555555555555555555555555555" },
+        { "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", "000000000000000000000000000000000000000000000000ffffffffffffffff", "0000000000000001000000000000000100000000000000010000000000000001" },
+        { "0000000123456789abcdef0fedcba98765432100000000000000000000000000", "0000000000000000000000000000000000000000000000000000000fedcba987", "0000000000000000124924924998d0ea8faf4b7940da913b4bf7b69b4219cb51" },
+        { "8000000000000000000000000000000000000000000000000000000000000000", "0000000000000000000000000000000000000000000000008000000000000000", "0000000000000001000000000000000000000000000000000000000000000000" },
+        // normalized multi-limb divisors, with the top bit of the top limb set
+        { "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", "0000000000000000000000000000000080000000000000000000000000000001", "00000000000000000000000000000001fffffffffffffffffffffffffffffffc" },
+        { "ffffffffffffffffffffffffffffffff7fffffffffffffff0000000100000000", "000000000000000000000000000000008000000000000000ffffffffffffffff", "00000000000000000000000000000001fffffffffffffffc000000000000000a" },
+        { "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", "8000000000000000000000000000000000000000000000000000000000003039", "0000000000000000000000000000000000000000000000000000000000000001" },
+        // unnormalized multi-limb divisor
+        { "deadbeefcafebabe0123456789abcdef00112233445566778899aabbccddeeff", "0000000000000000000000000000000000000001000000000000000000000001", "000000000000000000000000deadbeefcafebabe01234566aafe0eff35126775" },
+        // a dividend below and equal to the divisor
+        { "0000000000000000000000000000001400000000000000000000000000000000", "0000000000000000000000000000001800000000000000000000000000000000", "0000000000000000000000000000000000000000000000000000000000000000" },
+        { "0000000000004200000000000000000000000000000000000000000000000000", "0000000000004200000000000000000000000000000000000000000000000000", "0000000000000000000000000000000000000000000000000000000000000001" },
+        // the quotient limb estimate is one too large even after its correction, so the
+        // divisor is added back
+        { "e01a5a8b4fbd90f50000000000000002a90eeaa6dc36cdc08000000000000001", "000000000000000080000000000000000000000000000001a280bc716564a599", "000000000000000000000000000000000000000000000001c034b5169f7b21e9" },
+        { "ffffffffffffffffffffffffffffffff7fffffffffffffff0000000100000000", "00000000000000007fffffffffffffffffffffffffffffffffffffffffffffff", "000000000000000000000000000000000000000000000001ffffffffffffffff" },
+        { "8000000000000001000000010000000000000000000000013dcbf58bf1e1d89b", "00000000000000008000000000000001000000010000000000000000ffffffff", "000000000000000000000000000000000000000000000000ffffffffffffffff" },
+        { "fffffffffffffffe0000000000000000b3a411047888e6e3e0b596c6208ecc2d", "0000000000000000800000000000000000000000000000007fffffffffffffff", "000000000000000000000000000000000000000000000001fffffffffffffffb" },
+        { "ffffffffffffffff00000000000000028000000000000001fffffffffffffffe", "7fffffffffffffff80000000000000017fed29da94ffd8558000000000000001", "0000000000000000000000000000000000000000000000000000000000000001" },
+        { "fffffffffffffffe00000000000000020052a8d05839a5bd0000000000000002", "0000000000000000fffffffffffffffe0000000000000002384e50e6939762f5", "000000000000000000000000000000000000000000000000ffffffffffffffff" },
+    };
+    for (const auto &v : vectors)
+    {
+        arith_uint256 quotient = arith_uint256(v.dividend) / arith_uint256(v.divisor);
+        CHECK(quotient.GetHex() == v.quotient, "%s / %s gives %s", v.dividend, v.divisor, quotient.GetHex().c_str());
+    }
+
+    bool threw = false;
+    try
+    {
+        arith_uint256(1) / arith_uint256(0);
+    }
+    catch (const uint_error &e)
+    {
+        threw = true;
+    }
+    CHECK(threw, "division by zero did not throw");
+
+    for (int i = 0; i < 20000; i++)
+    {
+        arith_uint256 a = TestNumber(), b = TestNumber(), rem;
+        if (b == 0)
+        {
+            continue;
+        }
+        arith_uint256 expected = LongDivide(a, b, rem), quotient = a / b;
+        CHECK(quotient == expected, "%s / %s gives %s, not %s", a.GetHex().c_str(), b.GetHex().c_str(),
+              quotient.GetHex().c_str(), expected.GetHex().c_str());
+        CHECK(quotient * b + rem == a, "%s / %s does not multiply back", a.GetHex().c_str(), b.GetHex().c_str());
+    }
+}
+
+static void TestMultiplication()
+{
+    static const struct {
+        const char *a, *b, *product;
+    } vectors[] = {
+        { "000000000000000000000000000000000000000000000000ffffffffffffffff", "000000000000000000000000000000000000000000000000ffffffffffffffff", "00000000000000000000000000000000fffffffffffffffe0000000000000001" },
+        { "00000000000000000000000000000000ffffffffffffffffffffffffffffffff", "0000000000000000000000000000000100000000000000000000000000000001", "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff" },
+        { "000000000000000000000000000000000123456789abcdef0123456789abcdef", "00000000000000000000000000000000fedcba9876543210fedcba9876543210", "0121fa00ad77d742247acc9140513b74458fab20783af1222236d88fe5618cf0" },
+        // wraps at 256 bits
+        { "8000000000000000000000000000000000000000000000000000000000000001", "0000000000000000000000000000000000000000000000000000000000000003", "8000000000000000000000000000000000000000000000000000000000000003" },
+    };
+    for (const auto &v : vectors)
+    {
+        arith_uint256 product = arith_uint256(v.a) * arith_uint256(v.b);
+        CHECK(product.GetHex() == v.product, "%s * %s gives %s", v.a, v.b, product.GetHex().c_str());
+    }
+
+    // the 32 bit multiply agrees with the full one
+    for (int i = 0; i < 1000; i++)
+    {
+        arith_uint256 a = TestNumber();
+        uint32_t b = (uint32_t)TestRand();
+        CHECK(a * b == a * arith_uint256(b), "%s * %08x differs from the full multiply", a.GetHex().c_str(), b);
+    }
+}
+
+static void TestCompact()
+{
+    static const struct {
+        uint32_t compact;
+        const char *value;              // the low 64 bits, or NULL for the long value below
+        uint32_t roundTrip;             // GetCompact of the value, with the sign if negative
+        bool fNegative, fOverflow;
+    } vectors[] = {
+        { 0x00000000, "0", 0x00000000, false, false },
+        { 0x00123456, "0", 0x00000000, false, false },
+        { 0x01003456, "0", 0x00000000, false, false },
+        { 0x02000056, "0", 0x00000000, false, false },
+        { 0x03000000, "0", 0x00000000, false, false },
+        { 0x04000000, "0", 0x00000000, false, false },
+        { 0x00923456, "0", 0x00000000, false, false },
+        { 0x01803456, "0", 0x00000000, false, false },
+        { 0x02800056, "0", 0x00000000, false, false },
+        { 0x03800000, "0", 0x00000000, false, false },
+        { 0x04800000, "0", 0x00000000, false, false },
+        { 0x01123456, "12", 0x01120000, false, false },
+        { 0x01fedcba, "7e", 0x01fe0000, true, false },
+        { 0x02123456, "1234", 0x02123400, false, false },
+        { 0x03123456, "123456", 0x03123456, false, false },
+        { 0x04123456, "12345600", 0x04123456, false, false },
+        { 0x04923456, "12345600", 0x04923456, true, false },
+        { 0x05009234, "92340000", 0x05009234, false, false },
+        { 0x20123456, NULL, 0x20123456, false, false },
+    };
+    for (const auto &v : vectors)
+    {
+        bool fNegative, fOverflow;
+        arith_uint256 n;
+        n.SetCompact(v.compact, &fNegative, &fOverflow);
+        arith_uint256 expected(v.value ? v.value : "1234560000000000000000000000000000000000000000000000000000000000");
+        CHECK(n == expected, "%08x gives %s", v.compact, n.GetHex().c_str());
+        CHECK(fNegative == v.fNegative && fOverflow == v.fOverflow, "%08x negative %d overflow %d", v.compact, fNegative, fOverflow);
+        CHECK(n.GetCompact(fNegative) == v.roundTrip, "%08x compacts to %08x", v.compact, n.GetCompact(fNegative));
+    }
+
+    bool fNegative, fOverflow;
+    arith_uint256 n;
+    n.SetCompact(0xff123456, &fNegative, &fOverflow);
+    CHECK(!fNegative && fOverflow, "ff123456 negative %d overflow %d", fNegative, fOverflow);
+
+    // values with the 0x00800000 bit set go up an exponent rather than turning negative
+    n = 0x80;
+    CHECK(n.GetCompact() == 0x02008000, "80 compacts to %08x", n.GetCompact());
+}
+
+static void TestHashDifficulty()
+{
+    arith_uint256 diff1;
+    diff1.SetCompact(0x1d00ffff);
+
+    CHECK(GetHashDifficulty(ArithToUint256(diff1), diff1) == 1.0, "the difficulty 1 target is not difficulty 1");
+    CHECK(GetHashDifficulty(ArithToUint256(diff1 >> 4), diff1) == 16.0, "a sixteenth of the target is not difficulty 16");
+    CHECK(GetHashDifficulty(ArithToUint256(diff1 << 1), diff1) == 0.5, "twice the target is not difficulty 0.5");
+    CHECK(isinf(GetHashDifficulty(uint256(), diff1)), "a zero hash is not infinitely difficult");
+
+    // hashes and targets compare as 256 bit numbers, not byte strings
+    uint256 low = ArithToUint256(arith_uint256(0x100)), high = ArithToUint256(arith_uint256(0xff) << 64);
+    CHECK(UintToArith256(low) < UintToArith256(high), "0x100 does not compare below 0xff << 64");
+}
+
+int main(int argc, char *argv[])
+{
+    TestDivision();
+    TestMultiplication();
+    TestCompact();
+    TestHashDifficulty();
+
+    if (testFailures)
+    {
+        printf("%d checks failed\n", testFailures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+Checks of CBlockHeader::GetVerusV2Hash on serialized bytes against hashing the deserialized
+header.
+
+The raw path hashes a header in place, substituting zeros for the non-canonical fields instead
+of clearing a copy, and splices around the MMR roots of PBaaS solution descriptors. Each header
+here has random fields and a random solution of a size around the compact size and full size
+boundaries, with a solution descriptor of each version that changes what is cleared. Prints
+each mismatch and exits non-zero if there were any.
+
+    test_blockhash
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "solutiondata.h"
+#include "streams.h"
+#include "crypto/verus_context.h"
+
+static const int TEST_PROTOCOL_VERSION = 170009;
+
+static int testFailures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) \
+        { \
+            printf("ERROR: %s, %s:%d: ", __func__, __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// xorshift64*, only for test data
+static uint64_t testSeed = 0x2545f4914f6cdd1dULL;
+
+static uint64_t TestRand()
+{
+    testSeed ^= testSeed >> 12;
+    testSeed ^= testSeed << 25;
+    testSeed ^= testSeed >> 27;
+    return testSeed * 0x2545f4914f6cdd1dULL;
+}
+
+static void RandomFill(unsigned char *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        p[i] = TestRand() >> 56;
+    }
+}
+
+static CBlockHeader TestHeader(size_t solutionSize, uint32_t descrVersion)
+{
+    CBlockHeader bh;
+    bh.nVersion = CBlockHeader::VERUS_V2;
+    RandomFill(bh.hashPrevBlock.begin(), bh.hashPrevBlock.size());
+    RandomFill(bh.hashMerkleRoot.begin(), bh.hashMerkleRoot.size());
+    RandomFill(bh.hashFinalSaplingRoot.begin(), bh.hashFinalSaplingRoot.size());
+    RandomFill(bh.nNonce.begin(), bh.nNonce.size());
+    bh.nTime = TestRand();
+    bh.nBits = TestRand();
+    bh.nSolution.resize(solutionSize);
+    RandomFill(bh.nSolution.data(), solutionSize);
+    // the descriptor starts with its version, little endian
+    for (int i = 0; i < 4; i++)
+    {
+        bh.nSolution[i] = descrVersion >> (i * 8);
+    }
+    return bh;
+}
+
+static std::vector<unsigned char> Serialize(const CBlockHeader &bh)
+{
+    CDataStream s(SER_NETWORK, TEST_PROTOCOL_VERSION);
+    s << bh;
+    return std::vector<unsigned char>(s.begin(), s.end());
+}
+
+static void TestRawHash()
+{
+    // the descriptor alone, the first 3 byte compact size, around the full size and past it
+    static const size_t solutionSizes[] = { 72, 253, 1343, 1344, 1345, 2000 };
+    // no descriptor version, the MMR roots cleared from PBaaS headers on, and PBaaS
+    static const uint32_t descrVersions[] = { 0, CActivationHeight::SOLUTION_VERUSV6, CActivationHeight::SOLUTION_VERUSV7 };
+
+    CVerusHashContext context;
+    for (size_t size : solutionSizes)
+    {
+        for (uint32_t descrVersion : descrVersions)
+        {
+            for (int round = 0; round < 4; round++)
+            {
+                CBlockHeader bh = TestHeader(size, descrVersion);
+                std::vector<unsigned char> raw = Serialize(bh);
+                uint256 expected = bh.GetVerusV2Hash(), hash;
+
+                CHECK(CBlockHeader::GetVerusV2Hash(raw.data(), raw.size(), context, hash) && hash == expected,
+                      "solution size %zu, descriptor version %u: raw hash differs", size, descrVersion);
+
+                // bytes after the header are not hashed
+                std::vector<unsigned char> longer(raw);
+                longer.resize(raw.size() + 1 + TestRand() % 64, 0xa5);
+                CHECK(CBlockHeader::GetVerusV2Hash(longer.data(), longer.size(), context, hash) && hash == expected,
+                      "solution size %zu, descriptor version %u: trailing bytes change the hash", size, descrVersion);
+
+                CHECK(!CBlockHeader::GetVerusV2Hash(raw.data(), raw.size() - 1, context, hash),
+                      "solution size %zu, descriptor version %u: truncated header hashed", size, descrVersion);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    CVerusHash::init();
+    CVerusHashV2::init();
+
+    TestRawHash();
+
+    if (testFailures)
+    {
+        printf("%d checks failed\n", testFailures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
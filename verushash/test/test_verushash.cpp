@@ -0,0 +1,734 @@
+/*
+Consistency checks of the VerusHash fast paths against the plain ones they stand in for, and
+of each tier's kernels against known answers from the original AES-NI code.
+
+main forces each tier that ForceVerusCPUTier accepts in turn and repeats the per-tier checks,
+naming the tier in every mismatch, then runs the portable tier once more with SSSE3 Haraka
+turned off, so the table lookup kernels are covered on hosts that have SSSE3. Inputs come from
+a fixed seed, so a failure repeats from run to run. Prints each mismatch and exits non-zero if
+there were any.
+
+    test_verushash
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "hash.h"
+#include "crypto/common.h"
+#include "crypto/verus_context.h"
+#include "crypto/verus_dispatch.h"
+#include "crypto/sha256.h"
+#include "crypto/utilstrencodings.h"
+
+static int testFailures = 0;
+static int testTier = 0;
+static const char *testTierName = "";
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) \
+        { \
+            printf("ERROR: %s tier %s, %s:%d: ", __func__, testTierName, __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// xorshift64*, only for test data
+static uint64_t testSeed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t TestRand()
+{
+    testSeed ^= testSeed >> 12;
+    testSeed ^= testSeed << 25;
+    testSeed ^= testSeed >> 27;
+    return testSeed * 0x2545f4914f6cdd1dULL;
+}
+
+static std::vector<unsigned char> TestBytes(size_t len)
+{
+    std::vector<unsigned char> v(len);
+    for (size_t i = 0; i < len; i++)
+    {
+        v[i] = (unsigned char)TestRand();
+    }
+    return v;
+}
+
+// the three hash versions, and the later solution versions current headers carry, which hash
+// as the latest
+static const int hashVersions[] = { SOLUTION_VERUSHHASH_V2, SOLUTION_VERUSHHASH_V2_1, SOLUTION_VERUSHHASH_V2_2 };
+static const int testVersions[] = { SOLUTION_VERUSHHASH_V2, SOLUTION_VERUSHHASH_V2_1, SOLUTION_VERUSHHASH_V2_2, 5, 6, 7 };
+static const size_t TEST_VERSIONS = sizeof(testVersions) / sizeof(testVersions[0]);
+
+// Reset, Write and Finalize2b with the context's hasher of the version
+static void HashWith(CVerusHashContext &context, int solutionVersion, const unsigned char *data, size_t len, unsigned char *hash)
+{
+    CVerusHashV2 &vh2 = context.GetHasher(solutionVersion);
+    vh2.Reset();
+    vh2.Write(data, len);
+    vh2.Finalize2b(hash);
+}
+
+// SHA-256 digests of what the AES-NI kernels of the original VerusHash code give for the inputs
+// TestKnownAnswers makes, so every tier is checked against the same answers
+static const struct {
+    const char *name;
+    const char *digest;
+} knownAnswers[] = {
+    { "haraka256",          "26aa81589c38740b562bb391fb9d2558da2cbd345b49a680d7109ec739beb40c" },
+    { "haraka512",          "e30b211a475e638c0a67a89f9d2fa1a2012e5701f10e1eda1dde7d3a98a93a40" },
+    { "haraka512_zero",     "3562457e0f4b7027d5bdcf0fc76e2b64fa972fabfdccc5ebb68f3843b9c0de44" },
+    { "haraka512_keyed",    "bb5161451a365fd34377c58a7ed6b638524c1d1fae8b7674f329aee1f9b85698" },
+    { "GenNewCLKey",        "b192d7514d1601c3c708a7116aa70d2310dfa841459d9aad6fd0effda7e9403e" },
+    { "verusclhash",        "4b23b08d09d52f6c15ccfa92897ba5a5287fb0e0b4efea39e8290b5c83c0af0e" },
+    { "verusclhash_sv2_1",  "7d96ac3f595ec530a93caf5a504f229e823010ed4cd92b79182e3d9bbe076046" },
+    { "verusclhash_sv2_2",  "5fd4503c60546cd65cd5901378352773eee94f463fc9e63da57f5b25e2a7a9a5" },
+    { "Finalize2b V2",      "c33517518729387054edc55686338389721b3e1fdb06d0a99a7a26cbd51d1fe9" },
+    { "Finalize2b V2_1",    "81a3c334c6dc326def937844ba3401602dfe06d1d565dfccb040b1bf5c1730a1" },
+    { "Finalize2b V2_2",    "775d5a3d1e8ca1642472b20dd22cca3995f57857803a5f358d4908275b5fe156" },
+    { "sha256 abc",         "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+};
+
+static void CheckKnownAnswer(const char *name, CSHA256 &sha)
+{
+    unsigned char digest[CSHA256::OUTPUT_SIZE];
+    sha.Finalize(digest);
+    std::string hex = HexStr(digest, digest + sizeof(digest));
+    for (const auto &answer : knownAnswers)
+    {
+        if (!strcmp(answer.name, name))
+        {
+            CHECK(hex == answer.digest, "%s gives %s", name, hex.c_str());
+            return;
+        }
+    }
+    CHECK(false, "no known answer for %s", name);
+}
+
+// the tier's Haraka, clhash, key generation, Finalize2b and SHA-256 kernels against the known
+// answers, with the multi-lane Haraka kernels against the same answers as the single ones
+static void TestKnownAnswers()
+{
+    const verus_kernels *k = GetVerusKernels();
+    alignas(32) unsigned char in[512 + 40 * 16], out[8 * 32];
+    for (size_t i = 0; i < sizeof(in); i++)
+    {
+        in[i] = (unsigned char)(i * 167 + 13);
+    }
+
+    struct {
+        const char *name;
+        void (*single)(unsigned char *out, const unsigned char *in);
+        void (*x4)(unsigned char *out, const unsigned char *in);
+        void (*x8)(unsigned char *out, const unsigned char *in);
+        size_t inSize;
+    } harakas[] = {
+        { "haraka256", k->haraka256, k->haraka256_4x, k->haraka256_8x, 32 },
+        { "haraka512", k->haraka512, k->haraka512_4x, k->haraka512_8x, 64 },
+        { "haraka512_zero", k->haraka512_zero, NULL, NULL, 64 },
+    };
+    for (const auto &haraka : harakas)
+    {
+        CSHA256 single, x4, x8;
+        for (int i = 0; i < 8; i++)
+        {
+            haraka.single(out, in + i * haraka.inSize);
+            single.Write(out, 32);
+        }
+        CheckKnownAnswer(haraka.name, single);
+        if (haraka.x4)
+        {
+            haraka.x4(out, in);
+            haraka.x4(out + 4 * 32, in + 4 * haraka.inSize);
+            x4.Write(out, sizeof(out));
+            CheckKnownAnswer(haraka.name, x4);
+            haraka.x8(out, in);
+            x8.Write(out, sizeof(out));
+            CheckKnownAnswer(haraka.name, x8);
+        }
+    }
+    CSHA256 keyed;
+    for (int i = 0; i < 8; i++)
+    {
+        k->haraka512_keyed(out, in + i * 64, (const __m128i *)(in + 512));
+        keyed.Write(out, 32);
+    }
+    CheckKnownAnswer("haraka512_keyed", keyed);
+
+    // a fresh context and no cache, so the key is generated with this tier's kernels
+    CVerusKeyCache &keyCache = CVerusKeyCache::Shared();
+    uint32_t cacheCapacity = keyCache.GetCapacity();
+    keyCache.SetCapacity(0);
+
+    CVerusHashContext context;
+    unsigned char *key = context.GetKey();
+    uint32_t size = context.GetDescr()->keySizeInBytes;
+    uint64_t keyMask = verusclhasher::keymask(size);
+    alignas(32) unsigned char seed[32];
+    memcpy(seed, in, sizeof(seed));
+    CVerusHashV2::GenNewCLKey(seed, key, context.GetDescr());
+    CSHA256 keySha;
+    keySha.Write(key, size);
+    CheckKnownAnswer("GenNewCLKey", keySha);
+
+    // each clhash from the same key, with the key as the clhash left it
+    std::vector<unsigned char> generated(key, key + size);
+    const char *clhashNames[VERUS_CLHASH_VERSIONS] = { "verusclhash", "verusclhash_sv2_1", "verusclhash_sv2_2" };
+    for (int v = 0; v < VERUS_CLHASH_VERSIONS; v++)
+    {
+        CSHA256 sha;
+        for (int i = 0; i < 8; i++)
+        {
+            memcpy(key, generated.data(), size);
+            uint64_t result = k->verusclhash[v](key, in + i * 64, keyMask, (__m128i **)(key + size + keyMask + 1));
+            unsigned char resultBytes[8];
+            WriteLE64(resultBytes, result);
+            sha.Write(resultBytes, sizeof(resultBytes)).Write(key, size);
+        }
+        CheckKnownAnswer(clhashNames[v], sha);
+    }
+
+    const char *finalizeNames[] = { "Finalize2b V2", "Finalize2b V2_1", "Finalize2b V2_2" };
+    const size_t lens[] = { 0, 1, 31, 32, 33, 64, 65, 100, 140, 200, 1000 };
+    for (int v = 0; v < 3; v++)
+    {
+        CSHA256 sha;
+        CVerusHashV2 &vh2 = context.GetHasher(hashVersions[v]);
+        for (size_t len : lens)
+        {
+            vh2.Reset();
+            vh2.Write(in, len);
+            vh2.Finalize2b(out);
+            sha.Write(out, 32);
+        }
+        CheckKnownAnswer(finalizeNames[v], sha);
+    }
+    keyCache.SetCapacity(cacheCapacity);
+
+    CSHA256 abc;
+    abc.Write((const unsigned char *)"abc", 3);
+    CheckKnownAnswer("sha256 abc", abc);
+}
+
+// a length of at most max + 1 for batch and piece tests, weighted towards the edges of the
+// 32 byte blocks. max is at least 32
+static size_t TestLength(size_t max)
+{
+    switch (TestRand() % 4)
+    {
+        case 0:
+            return TestRand() % 3;
+        case 1:
+            return ((1 + TestRand() % (max / 32)) << 5) + TestRand() % 3 - 1;
+        default:
+            return TestRand() % (max + 1);
+    }
+}
+
+static bool SameMidstate(const CVerusHashV2 &a, const CVerusHashV2 &b)
+{
+    CVerusHashV2::Midstate ma, mb;
+    a.GetMidstate(ma);
+    b.GetMidstate(mb);
+    return ma.curPos == mb.curPos && ma.solutionVersion == mb.solutionVersion && !memcmp(ma.buf, mb.buf, 32 + ma.curPos);
+}
+
+// data split at random points into pieces, empty ones included
+static std::vector<verus_iovec> TestPieces(const std::vector<unsigned char> &data)
+{
+    std::vector<verus_iovec> iov;
+    size_t pos = 0;
+    while (pos < data.size() || TestRand() % 4 == 0)
+    {
+        size_t len = std::min(TestLength(70), data.size() - pos);
+        iov.push_back({ data.data() + pos, len });
+        pos += len;
+    }
+    return iov;
+}
+
+// WriteV of data split into pieces, on hashers part way through a block, leaves each hasher
+// as one Write of the data would, for VerusHash 1 and every VerusHash 2 solution version
+static void TestWriteV()
+{
+    CVerusHashContext context, reference;
+
+    for (int round = 0; round < 200; round++)
+    {
+        std::vector<unsigned char> prefix = TestBytes(TestLength(70));
+        std::vector<unsigned char> data = TestBytes(TestLength(400));
+        std::vector<verus_iovec> iov = TestPieces(data);
+        unsigned char hash[32], expected[32];
+
+        CVerusHash v1, v1Single;
+        v1.Reset().Write(prefix.data(), prefix.size()).WriteV(iov.data(), iov.size()).Finalize(hash);
+        v1Single.Reset().Write(prefix.data(), prefix.size()).Write(data.data(), data.size()).Finalize(expected);
+        CHECK(!memcmp(hash, expected, 32), "round %d V1 %zu bytes in %zu pieces differs", round, data.size(), iov.size());
+
+        int version = testVersions[round % TEST_VERSIONS];
+        CVerusHashV2 &vh2 = context.GetHasher(version), &single = reference.GetHasher(version);
+        vh2.Reset().Write(prefix.data(), prefix.size()).WriteV(iov.data(), iov.size());
+        single.Reset().Write(prefix.data(), prefix.size()).Write(data.data(), data.size());
+        CHECK(SameMidstate(vh2, single), "round %d version %d %zu bytes in %zu pieces differs", round, version, data.size(), iov.size());
+        vh2.Finalize2b(hash);
+        single.Finalize2b(expected);
+        CHECK(!memcmp(hash, expected, 32), "round %d version %d %zu bytes in %zu pieces hashes differently", round, version, data.size(), iov.size());
+
+        CVerusHashV2bWriter writer(SER_GETHASH, 0, context, version), singleWriter(SER_GETHASH, 0, reference, version);
+        writer.write((const char *)prefix.data(), prefix.size()).writev(iov.data(), iov.size());
+        singleWriter.write((const char *)prefix.data(), prefix.size()).write((const char *)data.data(), data.size());
+        CHECK(writer.GetHash() == singleWriter.GetHash(), "round %d version %d writer of %zu pieces differs", round, version, iov.size());
+    }
+}
+
+// HashBatch of inputs of mixed lengths, empty ones included, gives what Hash gives for each
+static void TestHashBatch()
+{
+    for (size_t count = 1; count <= 3 * CVerusHashV2::BATCH_LANES; count++)
+    {
+        std::vector<std::vector<unsigned char>> inputs(count);
+        std::vector<const unsigned char *> data(count);
+        std::vector<size_t> lens(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            inputs[i] = TestBytes(TestLength(300));
+            data[i] = inputs[i].data();
+            lens[i] = inputs[i].size();
+        }
+
+        std::vector<unsigned char> results(count * 32);
+        CVerusHashV2::HashBatch(results.data(), data.data(), lens.data(), count);
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned char expected[32];
+            CVerusHashV2::Hash(expected, data[i], lens[i]);
+            CHECK(!memcmp(&results[i * 32], expected, 32), "count %zu item %zu of %zu bytes differs", count, i, lens[i]);
+        }
+    }
+}
+
+// WriteBatch into hashers part way through a block leaves each as Write would
+static void TestWriteBatch()
+{
+    for (size_t count = 1; count <= 3 * CVerusHashV2::BATCH_LANES; count++)
+    {
+        std::vector<std::unique_ptr<CVerusHashV2>> batch, single;
+        std::vector<std::vector<unsigned char>> inputs(count);
+        std::vector<CVerusHashV2 *> hashers(count);
+        std::vector<const unsigned char *> data(count);
+        std::vector<size_t> lens(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            int version = testVersions[TestRand() % TEST_VERSIONS];
+            batch.emplace_back(new CVerusHashV2(version));
+            single.emplace_back(new CVerusHashV2(version));
+            std::vector<unsigned char> prefix = TestBytes(TestLength(70));
+            batch[i]->Reset().Write(prefix.data(), prefix.size());
+            single[i]->Reset().Write(prefix.data(), prefix.size());
+
+            inputs[i] = TestBytes(TestLength(300));
+            hashers[i] = batch[i].get();
+            data[i] = inputs[i].data();
+            lens[i] = inputs[i].size();
+        }
+
+        CVerusHashV2::WriteBatch(hashers.data(), data.data(), lens.data(), count);
+        for (size_t i = 0; i < count; i++)
+        {
+            single[i]->Write(data[i], lens[i]);
+            CHECK(SameMidstate(*batch[i], *single[i]), "count %zu item %zu of %zu bytes differs", count, i, lens[i]);
+
+            unsigned char hash[32], expected[32];
+            batch[i]->Finalize2b(hash);
+            single[i]->Finalize2b(expected);
+            CHECK(!memcmp(hash, expected, 32), "count %zu item %zu of %zu bytes hashes differently", count, i, lens[i]);
+        }
+    }
+}
+
+// Finalize2bBatch of hashers from separate and shared contexts, of mixed solution versions,
+// gives what Finalize2b gives for each, with new keys and with keys current from the last round
+static void TestFinalize2bBatch()
+{
+    CVerusHashContext reference;
+
+    for (size_t count = 1; count <= 3 * CVerusHashV2::BATCH_LANES; count++)
+    {
+        // hasher i is hasher i % 3 of context i / 3, in shuffled order
+        std::vector<std::unique_ptr<CVerusHashContext>> contexts;
+        for (size_t i = 0; i < (count + 2) / 3; i++)
+        {
+            contexts.emplace_back(new CVerusHashContext());
+            CHECK(((uintptr_t)contexts.back().get() % alignof(CVerusHashContext)) == 0, "heap context not aligned");
+        }
+        std::vector<size_t> order(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t j = TestRand() % (i + 1);
+            order[i] = order[j];
+            order[j] = i;
+        }
+
+        std::vector<std::vector<unsigned char>> inputs(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            inputs[i] = TestBytes(TestLength(300));
+        }
+
+        for (int round = 0; round < 2; round++)
+        {
+            std::vector<CVerusHashV2 *> hashers(count);
+            std::vector<unsigned char> results(count * 32);
+            std::vector<unsigned char *> hashes(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t item = order[i];
+                hashers[i] = &contexts[item / 3]->GetHasher(hashVersions[item % 3]);
+                hashers[i]->Reset().Write(inputs[item].data(), inputs[item].size());
+                hashes[i] = &results[i * 32];
+            }
+
+            CVerusHashV2::Finalize2bBatch(hashers.data(), hashes.data(), count);
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t item = order[i];
+                unsigned char expected[32];
+                HashWith(reference, hashVersions[item % 3], inputs[item].data(), inputs[item].size(), expected);
+                CHECK(!memcmp(hashes[i], expected, 32), "count %zu round %d item %zu version %d of %zu bytes differs",
+                      count, round, i, hashVersions[item % 3], inputs[item].size());
+            }
+        }
+    }
+}
+
+// GenNewCLKeys into separate key storage gives the keys GenNewCLKey gives, whether a key is
+// generated, current and restored after a hash mutated it, or copied from the shared cache
+static void TestGenNewCLKeys()
+{
+    CVerusHashContext reference;
+    CVerusKeyCache &keyCache = CVerusKeyCache::Shared();
+
+    for (int cached = 0; cached < 2; cached++)
+    {
+        keyCache.Clear();
+        keyCache.SetCapacity(cached ? CVerusKeyCache::MAX_ENTRIES : 0);
+
+        for (size_t count = 1; count <= 3 * CVerusHashV2::BATCH_LANES; count++)
+        {
+            std::vector<std::unique_ptr<CVerusHashContext>> contexts, others;
+            std::vector<unsigned char *> keys(count), seeds(count);
+            std::vector<verusclhash_descr *> descrs(count);
+            std::vector<uint256> seedValues(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                contexts.emplace_back(new CVerusHashContext());
+                keys[i] = contexts[i]->GetKey();
+                descrs[i] = contexts[i]->GetDescr();
+
+                // a third of the keys are current, mutated by the hash that made them
+                std::vector<unsigned char> data = TestBytes(TestLength(200));
+                if (TestRand() % 3 == 0)
+                {
+                    unsigned char hash[32];
+                    HashWith(*contexts[i], testVersions[TestRand() % TEST_VERSIONS], data.data(), data.size(), hash);
+                    seedValues[i] = descrs[i]->seed;
+                }
+                else
+                {
+                    memcpy(seedValues[i].begin(), data.data(), std::min(data.size(), (size_t)32));
+
+                    // with the cache on, half of the others are cached from another context
+                    if (cached && TestRand() % 2)
+                    {
+                        others.emplace_back(new CVerusHashContext());
+                        CVerusHashV2::GenNewCLKey(seedValues[i].begin(), others.back()->GetKey(), others.back()->GetDescr());
+                    }
+                }
+                seeds[i] = seedValues[i].begin();
+            }
+
+            uint64_t hits = keyCache.GetStats().hits;
+            CVerusHashV2::GenNewCLKeys(seeds.data(), keys.data(), descrs.data(), count);
+            CHECK(!cached || others.empty() || keyCache.GetStats().hits > hits, "count %zu no cache hits", count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint32_t size = descrs[i]->keySizeInBytes;
+                CVerusHashV2::GenNewCLKey(seeds[i], reference.GetKey(), reference.GetDescr());
+                CHECK(size == reference.GetDescr()->keySizeInBytes && !memcmp(keys[i], reference.GetKey(), size),
+                      "count %zu cached %d key %zu differs", count, cached, i);
+                CHECK(descrs[i]->seed == seedValues[i], "count %zu cached %d key %zu has another seed", count, cached, i);
+            }
+        }
+    }
+    keyCache.SetCapacity(0);
+    keyCache.Clear();
+}
+
+// resuming from an exported midstate, in another context, gives the hash of the whole input
+static void TestMidstateRoundTrip()
+{
+    CVerusHashContext source, dest;
+
+    for (int version : testVersions)
+    {
+        for (size_t prefixLen = 0; prefixLen <= 100; prefixLen += 1 + (prefixLen >= 40) * 9)
+        {
+            std::vector<unsigned char> data = TestBytes(prefixLen + TestRand() % 200);
+            unsigned char expected[32], hash[32], blob[CVerusHashV2::MIDSTATE_BLOB_MAX];
+
+            HashWith(source, version, data.data(), data.size(), expected);
+
+            CVerusHashV2 &vh2 = source.GetHasher(version);
+            vh2.Reset();
+            vh2.Write(data.data(), prefixLen);
+            size_t blobLen = vh2.ExportMidstate(blob, sizeof(blob));
+            CHECK(blobLen == CVerusHashV2::MIDSTATE_BLOB_HEADER + 32 + prefixLen % 32, "version %d prefix %zu exported %zu bytes", version, prefixLen, blobLen);
+            CHECK(vh2.ExportMidstate(blob, blobLen - 1) == 0, "version %d prefix %zu exported into a short buffer", version, prefixLen);
+            CHECK(blob[1] == CVerusHashV2::HashVersion(version), "version %d prefix %zu exported as version %d", version, prefixLen, blob[1]);
+
+            CVerusHashV2 *resumed = dest.ImportMidstate(blob, blobLen);
+            CHECK(resumed == &dest.GetHasher(version), "version %d prefix %zu not imported to its hasher", version, prefixLen);
+            if (resumed)
+            {
+                resumed->Write(data.data() + prefixLen, data.size() - prefixLen);
+                resumed->Finalize2b(hash);
+                CHECK(!memcmp(hash, expected, 32), "version %d prefix %zu resumed hash differs", version, prefixLen);
+            }
+
+            CVerusHashV2::Midstate midstate;
+            vh2.Reset();
+            vh2.Write(data.data(), prefixLen);
+            vh2.GetMidstate(midstate);
+            resumed = dest.SetMidstate(midstate);
+            CHECK(resumed == &dest.GetHasher(version), "version %d prefix %zu midstate not set on its hasher", version, prefixLen);
+            if (resumed)
+            {
+                resumed->Write(data.data() + prefixLen, data.size() - prefixLen);
+                resumed->Finalize2b(hash);
+                CHECK(!memcmp(hash, expected, 32), "version %d prefix %zu midstate hash differs", version, prefixLen);
+            }
+
+            // and between writers of the version, as for SerializeVerusHashV2b of a header
+            CVerusHashV2bWriter writer(SER_GETHASH, 0, source, version), resumedWriter(SER_GETHASH, 0, dest, version);
+            writer.write((const char *)data.data(), prefixLen);
+            blobLen = writer.ExportMidstate(blob, sizeof(blob));
+            CHECK(resumedWriter.ImportMidstate(blob, blobLen), "version %d prefix %zu writer import refused", version, prefixLen);
+            resumedWriter.write((const char *)data.data() + prefixLen, data.size() - prefixLen);
+            uint256 writerHash = resumedWriter.GetHash();
+            CHECK(!memcmp(writerHash.begin(), expected, 32), "version %d prefix %zu writer import hash differs", version, prefixLen);
+
+            writer.Reset();
+            writer.write((const char *)data.data(), prefixLen);
+            writer.GetMidstate(midstate);
+            resumedWriter.Reset();
+            CHECK(resumedWriter.SetMidstate(midstate), "version %d prefix %zu writer midstate refused", version, prefixLen);
+            resumedWriter.write((const char *)data.data() + prefixLen, data.size() - prefixLen);
+            writerHash = resumedWriter.GetHash();
+            CHECK(!memcmp(writerHash.begin(), expected, 32), "version %d prefix %zu writer midstate hash differs", version, prefixLen);
+        }
+    }
+}
+
+// short, malformed and other version blobs are refused and leave the hasher as it was
+static void TestMidstateRejects()
+{
+    CVerusHashContext context, fresh;
+    std::vector<unsigned char> data = TestBytes(150);
+    unsigned char blob[CVerusHashV2::MIDSTATE_BLOB_MAX], bad[CVerusHashV2::MIDSTATE_BLOB_MAX];
+
+    for (int version : testVersions)
+    {
+        CVerusHashV2 &vh2 = context.GetHasher(version);
+        vh2.Reset();
+        vh2.Write(data.data(), 45);
+        size_t blobLen = vh2.ExportMidstate(blob, sizeof(blob));
+
+        for (size_t len = 0; len < blobLen; len++)
+        {
+            CHECK(!vh2.ImportMidstate(blob, len), "version %d imported a %zu byte blob", version, len);
+            CHECK(!context.ImportMidstate(blob, len), "version %d context imported a %zu byte blob", version, len);
+        }
+
+        memcpy(bad, blob, blobLen);
+        bad[0] = CVerusHashV2::MIDSTATE_BLOB_VERSION + 1;
+        CHECK(!vh2.ImportMidstate(bad, blobLen), "version %d imported blob format %d", version, bad[0]);
+
+        memcpy(bad, blob, blobLen);
+        bad[2] = 32;
+        CHECK(!vh2.ImportMidstate(bad, sizeof(bad)), "version %d imported curPos 32", version);
+
+        for (int other = 0; other <= SOLUTION_VERUSHHASH_V2_2 + 4; other++)
+        {
+            // exports only carry hash versions, so a later solution version in a blob is malformed
+            if (other > SOLUTION_VERUSHHASH_V2_2)
+            {
+                memcpy(bad, blob, blobLen);
+                bad[1] = other;
+                CHECK(!vh2.ImportMidstate(bad, blobLen), "version %d imported a version %d blob", version, other);
+            }
+            if (CVerusHashV2::HashVersion(other) != CVerusHashV2::HashVersion(version))
+            {
+                memcpy(bad, blob, blobLen);
+                bad[1] = other;
+                CHECK(!vh2.ImportMidstate(bad, blobLen), "version %d imported a version %d blob", version, other);
+
+                CVerusHashV2::Midstate midstate;
+                vh2.GetMidstate(midstate);
+                midstate.solutionVersion = other;
+                CHECK(!vh2.SetMidstate(midstate), "version %d set a version %d midstate", version, other);
+            }
+        }
+        CHECK(CVerusHashV2::HashVersion(vh2.GetSolutionVersion()) == CVerusHashV2::HashVersion(version),
+              "version %d hasher switched to version %d", version, vh2.GetSolutionVersion());
+
+        // the refused imports left the chain where it was
+        unsigned char expected[32], hash[32];
+        HashWith(fresh, version, data.data(), data.size(), expected);
+        vh2.Write(data.data() + 45, data.size() - 45);
+        vh2.Finalize2b(hash);
+        CHECK(!memcmp(hash, expected, 32), "version %d hash differs after refused imports", version);
+    }
+
+    // a midstate of another version does not change what the context hashes afterwards
+    for (int version : testVersions)
+    {
+        for (int other : testVersions)
+        {
+            CVerusHashV2 &vh2 = context.GetHasher(other);
+            vh2.Reset();
+            vh2.Write(data.data(), 45);
+            size_t blobLen = vh2.ExportMidstate(blob, sizeof(blob));
+            context.GetHasher(version).ImportMidstate(blob, blobLen);
+
+            unsigned char expected[32], hash[32];
+            HashWith(fresh, version, data.data(), data.size(), expected);
+            HashWith(context, version, data.data(), data.size(), hash);
+            CHECK(!memcmp(hash, expected, 32), "version %d hash differs after importing a version %d blob", version, other);
+        }
+    }
+}
+
+// lookups racing inserts, evictions and capacity changes only ever copy out the key of the
+// seed asked for
+static void TestKeyCacheThreads()
+{
+    const int KEY_SIZE = 1024, SEEDS = 12, THREADS = 4, ROUNDS = 20000;
+    CVerusKeyCache cache;
+    cache.SetCapacity(4);
+
+    std::vector<uint256> seeds(SEEDS);
+    std::vector<std::vector<unsigned char>> keys(SEEDS);
+    for (int i = 0; i < SEEDS; i++)
+    {
+        std::vector<unsigned char> seed = TestBytes(32);
+        memcpy(seeds[i].begin(), seed.data(), 32);
+        keys[i] = TestBytes(KEY_SIZE);
+    }
+    // a seed that shares its tag with seeds[0]
+    seeds[1] = seeds[0];
+    *(seeds[1].begin() + 31) ^= 1;
+
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++)
+    {
+        threads.emplace_back([&, t]() {
+            std::vector<unsigned char> key(KEY_SIZE);
+            uint64_t r = t + 1;
+            for (int i = 0; i < ROUNDS; i++)
+            {
+                r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+                int n = (r >> 33) % SEEDS;
+                if (t == 0 && !(i & 1023))
+                {
+                    cache.SetCapacity((i >> 10) & 1 ? 2 : 4);
+                }
+                if (cache.Lookup(seeds[n], KEY_SIZE, key.data()))
+                {
+                    wrong += memcmp(key.data(), keys[n].data(), KEY_SIZE) != 0;
+                }
+                else
+                {
+                    cache.Insert(seeds[n], KEY_SIZE, keys[n].data());
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    CVerusKeyCache::Stats stats = cache.GetStats();
+    CHECK(!wrong, "%d lookups copied the wrong key", wrong.load());
+    CHECK(stats.hits + stats.misses == (uint64_t)THREADS * ROUNDS, "%lu hits and %lu misses of %d lookups",
+          (unsigned long)stats.hits, (unsigned long)stats.misses, THREADS * ROUNDS);
+    CHECK(stats.hits && stats.evictions, "%lu hits and %lu evictions", (unsigned long)stats.hits, (unsigned long)stats.evictions);
+}
+
+// every check that runs per tier, on the tier in use
+static void TestTier()
+{
+    CVerusHash::init();
+    CVerusHashV2::init();
+
+    TestKnownAnswers();
+    TestWriteV();
+    TestHashBatch();
+    TestWriteBatch();
+    TestGenNewCLKeys();
+    TestFinalize2bBatch();
+    TestMidstateRoundTrip();
+    TestMidstateRejects();
+}
+
+int main(int argc, char *argv[])
+{
+    int detected = DetectVerusCPUTier();
+
+    for (testTier = VERUS_TIER_PORTABLE; testTier <= detected; testTier++)
+    {
+        if (ForceVerusCPUTier(testTier) != testTier)
+        {
+            continue;
+        }
+        testTierName = GetVerusCPUTierName(testTier);
+        TestTier();
+    }
+
+    // the portable tier again with the table lookup Haraka, where SSSE3 stood in for it above
+    testTier = VERUS_TIER_PORTABLE;
+    ForceVerusCPUTier(testTier);
+    if (GetVerusKernels()->harakassse3)
+    {
+        ForceVerusHarakaSSSE3(false);
+        ForceVerusCPUTier(testTier);
+        testTierName = "portable-tables";
+        TestTier();
+        ForceVerusHarakaSSSE3(true);
+    }
+
+    ForceVerusCPUTier(-1);
+    testTier = GetVerusCPUTier();
+    testTierName = GetVerusCPUTierName(testTier);
+
+    // not tied to a tier
+    TestKeyCacheThreads();
+
+    if (testFailures)
+    {
+        printf("%d checks failed\n", testFailures);
+        return 1;
+    }
+    printf("all checks passed on tiers %s to %s\n", GetVerusCPUTierName(VERUS_TIER_PORTABLE), GetVerusCPUTierName(detected));
+    return 0;
+}
@@ -1,6 +1,7 @@
 /* File : verushash.cxx */
 
 #include "verushash.h"
+#include "verushash_c.h"
 
 #include <stdint.h>
 #include <vector>
@@ -8,7 +9,12 @@
 #include <sodium.h>
 #include <iostream>
 #include "crypto/verus_hash.h"
+#include "crypto/verus_context.h"
+#include "crypto/verus_stats.h"
 #include "solutiondata.h"
+#include "arith_uint256.h"
+#include "headerverify.h"
+#include "jobtemplates.h"
 
 #include <sstream>
 
@@ -41,62 +47,291 @@ void Verushash::verushash(const char * bytes, int length, void * ptrResult) {
     verus_hash(ptrResult, bytes, length);
 }
 
+CVerusHashContext &Verushash::getContext() {
+    return context ? *context : CVerusHashContext::ThreadContext();
+}
+
 void Verushash::verushash_v2(const char * bytes, int length, void * ptrResult) {
-    CVerusHashV2 vh2(SOLUTION_VERUSHHASH_V2);
-    
     if (initialized == false) {
         initialize();
     }
 
+    CVerusHashV2 &vh2 = getContext().GetHasher(SOLUTION_VERUSHHASH_V2);
     vh2.Reset();
     vh2.Write((unsigned char *) bytes, length);
     vh2.Finalize((unsigned char *) ptrResult);
 }
 
 void Verushash::verushash_v2b(const char * bytes, int length, void * ptrResult) {
-    CVerusHashV2 vh2(SOLUTION_VERUSHHASH_V2);
-    
     if (initialized == false) {
         initialize();
     }
 
+    CVerusHashV2 &vh2 = getContext().GetHasher(SOLUTION_VERUSHHASH_V2);
     vh2.Reset();
     vh2.Write((unsigned char *) bytes, length);
     vh2.Finalize2b((unsigned char *) ptrResult);
 }
 
-void Verushash::verushash_v2b1(std::string const bytes, int length, void * ptrResult) {
-    CVerusHashV2 vh2b1(SOLUTION_VERUSHHASH_V2_1);
+void Verushash::verushash_v2b1(std::string const &bytes, int length, void * ptrResult) {
+    verushash_v2b1_raw(bytes.data(), length, ptrResult);
+}
 
+void Verushash::verushash_v2b1_raw(const char * bytes, int length, void * ptrResult) {
     if (initialized == false) {
         initialize();
     }
 
+    CVerusHashV2 &vh2b1 = getContext().GetHasher(SOLUTION_VERUSHHASH_V2_1);
     vh2b1.Reset();
-    vh2b1.Write((unsigned char *) &bytes[0], length);
+    vh2b1.Write((unsigned char *) bytes, length);
     vh2b1.Finalize2b((unsigned char *) ptrResult);
 }
 
-void Verushash::verushash_v2b2(std::string const bytes, void * ptrResult)
+void Verushash::verushash_v2b2(std::string const &bytes, void * ptrResult)
 {
-    uint256 result;
+    verushash_v2b2_raw(bytes.data(), bytes.size(), ptrResult);
+}
 
+bool Verushash::verushash_v2b2_raw(const char * bytes, int length, void * ptrResult)
+{
+    uint256 result;
 
     if (initialized == false) {
         initialize();
     }
 
-    CBlockHeader bh;
-    CDataStream s(bytes.data(), bytes.data() + bytes.size(), 1, 170009);
-
-    try
-    {
-        s >> bh;
-        result = bh.GetVerusV2Hash();
-    }
-    catch(const std::exception& e)
+    bool valid = length >= 0 && CBlockHeader::GetVerusV2Hash((const unsigned char *)bytes, length, getContext(), result);
+    if (!valid)
     {
+        result.SetNull();
     }
 
     memcpy(ptrResult, &result, 32);
+    return valid;
+}
+
+// hashes with the calling thread's context, like the package level SWIG object
+static Verushash cVerushash;
+
+void verushash_hash_into(unsigned char *dst, const unsigned char *src, int length) {
+    cVerushash.verushash((const char *)src, length, dst);
+}
+
+void verushash_v2_hash_into(unsigned char *dst, const unsigned char *src, int length) {
+    cVerushash.verushash_v2((const char *)src, length, dst);
+}
+
+void verushash_v2b_hash_into(unsigned char *dst, const unsigned char *src, int length) {
+    cVerushash.verushash_v2b((const char *)src, length, dst);
+}
+
+void verushash_v2b1_hash_into(unsigned char *dst, const unsigned char *src, int length) {
+    cVerushash.verushash_v2b1_raw((const char *)src, length, dst);
+}
+
+int verushash_v2b2_hash_into(unsigned char *dst, const unsigned char *src, int length) {
+    return cVerushash.verushash_v2b2_raw((const char *)src, length, dst);
+}
+
+struct verushash_context
+{
+    verushash_context() { hasher.setContext(&context); }
+
+    CVerusHashContext context;
+    Verushash hasher;
+};
+
+verushash_context *verushash_context_new(void) {
+    cVerushash.initialize();
+    return new verushash_context();
+}
+
+void verushash_context_free(verushash_context *ctx) {
+    delete ctx;
+}
+
+int verushash_context_hash_into(verushash_context *ctx, int version, unsigned char *dst,
+                                const unsigned char *src, int length) {
+    switch (version) {
+        case VERUSHASH_V1:
+            ctx->hasher.verushash((const char *)src, length, dst);
+            return 1;
+        case VERUSHASH_V2:
+            ctx->hasher.verushash_v2((const char *)src, length, dst);
+            return 1;
+        case VERUSHASH_V2B:
+            ctx->hasher.verushash_v2b((const char *)src, length, dst);
+            return 1;
+        case VERUSHASH_V2B1:
+            ctx->hasher.verushash_v2b1_raw((const char *)src, length, dst);
+            return 1;
+        case VERUSHASH_V2B2:
+            return ctx->hasher.verushash_v2b2_raw((const char *)src, length, dst);
+    }
+    memset(dst, 0, 32);
+    return 0;
+}
+
+struct verushash_batch
+{
+    verushash_batch(int threads) : verifier(threads) {}
+
+    CVerusHeaderVerifier verifier;
+    std::vector<const unsigned char *> headers;
+    std::vector<size_t> lens;
+};
+
+verushash_batch *verushash_batch_new(int threads) {
+    cVerushash.initialize();
+    return new verushash_batch(threads);
+}
+
+void verushash_batch_free(verushash_batch *batch) {
+    delete batch;
+}
+
+int verushash_batch_verify(verushash_batch *batch, unsigned char *dst, const unsigned char *data,
+                           const int *lens, int count, const unsigned char *targets,
+                           unsigned char *passed, unsigned char *complete) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    // reused from call to call, so only grow
+    batch->headers.resize(count);
+    batch->lens.resize(count);
+    for (int i = 0; i < count; i++) {
+        batch->headers[i] = data;
+        batch->lens[i] = lens[i] < 0 ? 0 : lens[i];
+        data += batch->lens[i];
+    }
+
+    return batch->verifier.Verify(&batch->headers[0], &batch->lens[0], count, (const uint256 *)targets,
+                                  (uint256 *)dst, passed, complete);
+}
+
+struct verushash_templates
+{
+    verushash_templates(int capacity) : templates(capacity) {}
+
+    CVerusJobTemplates templates;
+};
+
+verushash_templates *verushash_templates_new(int capacity) {
+    cVerushash.initialize();
+    return new verushash_templates(capacity);
+}
+
+void verushash_templates_free(verushash_templates *templates) {
+    delete templates;
+}
+
+int verushash_templates_register(verushash_templates *templates, uint64_t id, const unsigned char *header,
+                                 int length, int tail_offset, const unsigned char *target) {
+    if (length < 0 || tail_offset < 0) {
+        return 0;
+    }
+    return templates->templates.Register(id, header, length, tail_offset, (const uint256 *)target);
+}
+
+int verushash_templates_retire(verushash_templates *templates, uint64_t id) {
+    return templates->templates.Retire(id);
+}
+
+int verushash_templates_submit(verushash_templates *templates, verushash_context *ctx, uint64_t id,
+                               uint32_t n_time, const unsigned char *tail, int tail_length,
+                               unsigned char *dst) {
+    if (tail_length < 0) {
+        memset(dst, 0, 32);
+        return VERUSHASH_SHARE_INVALID;
+    }
+    return templates->templates.Submit(id, n_time, tail, tail_length,
+                                       ctx ? ctx->context : CVerusHashContext::ThreadContext(),
+                                       *(uint256 *)dst);
+}
+
+static_assert((int)VERUSHASH_SHARE_UNKNOWN_JOB == (int)CVerusJobTemplates::SUBMIT_UNKNOWN_JOB &&
+              (int)VERUSHASH_SHARE_INVALID == (int)CVerusJobTemplates::SUBMIT_INVALID &&
+              (int)VERUSHASH_SHARE_REJECTED == (int)CVerusJobTemplates::SUBMIT_REJECTED &&
+              (int)VERUSHASH_SHARE_PASSED == (int)CVerusJobTemplates::SUBMIT_PASSED,
+              "verushash share results must match CVerusJobTemplates");
+
+static_assert(sizeof(verushash_stats) == sizeof(CVerusStatsSnapshot) &&
+              (int)VERUSHASH_STAT_COUNTERS == (int)VERUS_STAT_COUNTERS &&
+              (int)VERUSHASH_STAT_SOLUTION_VERSIONS == (int)VERUS_STAT_SOLUTION_VERSIONS &&
+              (int)VERUSHASH_STAGES == (int)VERUS_STAGE_COUNT &&
+              (int)VERUSHASH_STAT_BUCKETS == (int)VERUS_STAT_BUCKETS,
+              "verushash_stats must match CVerusStatsSnapshot");
+
+void verushash_stats_enable(int enable) {
+    CVerusStats::Enable(enable != 0);
+}
+
+int verushash_stats_enabled(void) {
+    return CVerusStats::IsEnabled();
+}
+
+void verushash_stats_snapshot(verushash_stats *stats) {
+    CVerusStatsSnapshot snapshot;
+    CVerusStats::Snapshot(snapshot);
+    memcpy(stats, &snapshot, sizeof(snapshot));
+}
+
+void verushash_stats_reset(void) {
+    CVerusStats::Reset();
+}
+
+double verushash_stats_cycles_per_second(void) {
+    return CVerusStats::TicksPerSecond();
+}
+
+static_assert(sizeof(verushash_keycache_stats) == sizeof(CVerusKeyCache::Stats) &&
+              (int)VERUSHASH_KEYCACHE_MAX_ENTRIES == (int)CVerusKeyCache::MAX_ENTRIES,
+              "verushash_keycache_stats must match CVerusKeyCache::Stats");
+
+int verushash_keycache_set_capacity(int entries) {
+    CVerusKeyCache &keyCache = CVerusKeyCache::Shared();
+    keyCache.SetCapacity(entries > 0 ? entries : 0);
+    return keyCache.GetCapacity();
+}
+
+void verushash_keycache_stats_snapshot(verushash_keycache_stats *stats) {
+    CVerusKeyCache::Stats snapshot = CVerusKeyCache::Shared().GetStats();
+    memcpy(stats, &snapshot, sizeof(snapshot));
+}
+
+void verushash_keycache_stats_reset(void) {
+    CVerusKeyCache::Shared().ResetStats();
+}
+
+static uint256 Uint256From(const unsigned char *p) {
+    uint256 n;
+    memcpy(n.begin(), p, n.size());
+    return n;
+}
+
+int verushash_compact_to_target(uint32_t n_bits, unsigned char *target) {
+    bool fNegative, fOverflow;
+    arith_uint256 n;
+    n.SetCompact(n_bits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || n == 0) {
+        memset(target, 0, 32);
+        return 0;
+    }
+    uint256 t = ArithToUint256(n);
+    memcpy(target, t.begin(), t.size());
+    return 1;
+}
+
+uint32_t verushash_target_to_compact(const unsigned char *target) {
+    return UintToArith256(Uint256From(target)).GetCompact();
+}
+
+int verushash_hash_meets_target(const unsigned char *hash, const unsigned char *target) {
+    return UintToArith256(Uint256From(hash)) <= UintToArith256(Uint256From(target));
+}
+
+double verushash_hash_difficulty(const unsigned char *hash, const unsigned char *diff1_target) {
+    return GetHashDifficulty(Uint256From(hash), UintToArith256(Uint256From(diff1_target)));
 }
@@ -9,14 +9,27 @@
 
 #include <stdio.h>
 #include <string>
+
+class CVerusHashContext;
+
 class Verushash {
 public:
   bool initialized = false;
   void initialize();
+  // hash with this context's key storage and hashers instead of the calling thread's. the
+  // context must outlive its use here, and neither may be used by two threads at once.
+  void setContext(CVerusHashContext *ctx) { context = ctx; }
   void verushash(const char * bytes, int length, void * ptrResult);
   void verushash_v2(const char * bytes, int length, void * ptrResult);
   void verushash_v2b(const char * bytes, int length, void * ptrResult);
-  void verushash_v2b1(std::string bytes, int length, void * ptrResult);
-  void verushash_v2b2(std::string const  bytes, void * ptrResult);
+  void verushash_v2b1(std::string const &bytes, int length, void * ptrResult);
+  void verushash_v2b1_raw(const char * bytes, int length, void * ptrResult);
+  void verushash_v2b2(std::string const &bytes, void * ptrResult);
+  // hashes a serialized block header in place. returns false and a zero result if it is not a
+  // complete header
+  bool verushash_v2b2_raw(const char * bytes, int length, void * ptrResult);
+private:
+  CVerusHashContext *context = NULL;
+  CVerusHashContext &getContext();
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+/* File : verushash_c.h */
+// C entry points for calling the hashes directly through cgo, without the SWIG std::string
+// conversion. every function writes 32 bytes to dst and hashes with the calling thread's context.
+
+#ifndef _VERUSHASH_C_H_
+#define _VERUSHASH_C_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void verushash_hash_into(unsigned char *dst, const unsigned char *src, int length);
+void verushash_v2_hash_into(unsigned char *dst, const unsigned char *src, int length);
+void verushash_v2b_hash_into(unsigned char *dst, const unsigned char *src, int length);
+void verushash_v2b1_hash_into(unsigned char *dst, const unsigned char *src, int length);
+
+// src is a serialized block header. returns 0 and zeroes dst if it is not a complete header
+int verushash_v2b2_hash_into(unsigned char *dst, const unsigned char *src, int length);
+
+// a CVerusHashContext and a Verushash that hashes with it, for callers that keep one per
+// thread instead of relying on the calling thread's context
+typedef struct verushash_context verushash_context;
+
+enum {
+    VERUSHASH_V1 = 0,
+    VERUSHASH_V2 = 1,
+    VERUSHASH_V2B = 2,
+    VERUSHASH_V2B1 = 3,
+    VERUSHASH_V2B2 = 4
+};
+
+verushash_context *verushash_context_new(void);
+void verushash_context_free(verushash_context *ctx);
+
+// hashes with one of the VERUSHASH_ versions into dst. returns 0 and zeroes dst for an unknown
+// version, or for VERUSHASH_V2B2 if src is not a complete header. a context must not be used
+// by two threads at once.
+int verushash_context_hash_into(verushash_context *ctx, int version, unsigned char *dst,
+                                const unsigned char *src, int length);
+
+// a CVerusHeaderVerifier and the scratch to call it with, for hashing and checking many
+// headers in one call
+typedef struct verushash_batch verushash_batch;
+
+verushash_batch *verushash_batch_new(int threads);
+void verushash_batch_free(verushash_batch *batch);
+
+// hashes count headers, packed back to back in data with lengths in lens, into 32 bytes each
+// of dst. targets is NULL or holds a 32 byte little endian target per header, where a zero
+// target means the header's own nBits. passed and complete get bitmaps of (count + 7) / 8
+// bytes, of headers that met their target and of headers that were complete. returns the
+// number that passed. calls on one batch must not overlap.
+int verushash_batch_verify(verushash_batch *batch, unsigned char *dst, const unsigned char *data,
+                           const int *lens, int count, const unsigned char *targets,
+                           unsigned char *passed, unsigned char *complete);
+
+// a CVerusJobTemplates, for checking shares against registered jobs from only the fields a
+// share changes, see jobtemplates.h
+typedef struct verushash_templates verushash_templates;
+
+enum {
+    VERUSHASH_SHARE_UNKNOWN_JOB = -2,
+    VERUSHASH_SHARE_INVALID = -1,
+    VERUSHASH_SHARE_REJECTED = 0,
+    VERUSHASH_SHARE_PASSED = 1
+};
+
+verushash_templates *verushash_templates_new(int capacity);
+void verushash_templates_free(verushash_templates *templates);
+
+// adds job id from a serialized VerusHash 2 header, whose shares replace its solution from
+// tail_offset on. target is NULL or a 32 byte little endian target, where NULL or a zero
+// target means the header's own nBits. returns 0 if the header cannot be a template, the id is
+// already live or every slot is in use.
+int verushash_templates_register(verushash_templates *templates, uint64_t id, const unsigned char *header,
+                                 int length, int tail_offset, const unsigned char *target);
+
+// returns 0 if no live job has the id
+int verushash_templates_retire(verushash_templates *templates, uint64_t id);
+
+// hashes a share of job id, with n_time and the end of the solution in tail, into dst, with
+// ctx or, if ctx is NULL, the calling thread's context. returns one of the VERUSHASH_SHARE_
+// results, and zeroes dst if the share could not be hashed. submits may run on any number of
+// threads at once.
+int verushash_templates_submit(verushash_templates *templates, verushash_context *ctx, uint64_t id,
+                               uint32_t n_time, const unsigned char *tail, int tail_length,
+                               unsigned char *dst);
+
+// opt-in counters and stage timings of the hot path, summed over every thread, see
+// crypto/verus_stats.h. the layout matches CVerusStatsSnapshot.
+enum {
+    VERUSHASH_STAT_HASHES_V1 = 0,
+    VERUSHASH_STAT_HASHES_V2 = 1,
+    VERUSHASH_STAT_BYTES_HASHED = 2,
+    VERUSHASH_STAT_KEYS_GENERATED = 3,
+    VERUSHASH_STAT_KEYS_CACHED = 4,
+    VERUSHASH_STAT_KEYS_REUSED = 5,
+    VERUSHASH_STAT_DESERIALIZE_FAILURES = 6,
+    VERUSHASH_STAT_COUNTERS = 7,
+    VERUSHASH_STAT_SOLUTION_VERSIONS = 16,
+
+    VERUSHASH_STAGE_DESERIALIZE = 0,
+    VERUSHASH_STAGE_CLEAR_NONCANONICAL = 1,
+    VERUSHASH_STAGE_HARAKA_CHAIN = 2,
+    VERUSHASH_STAGE_KEYGEN = 3,
+    VERUSHASH_STAGE_CLHASH = 4,
+    VERUSHASH_STAGE_FINAL_HARAKA = 5,
+    VERUSHASH_STAGES = 6,
+    VERUSHASH_STAT_BUCKETS = 40
+};
+
+typedef struct verushash_stats
+{
+    uint64_t counters[VERUSHASH_STAT_COUNTERS];
+    uint64_t hashes_by_solution[VERUSHASH_STAT_SOLUTION_VERSIONS];
+    uint64_t stage_calls[VERUSHASH_STAGES];
+    uint64_t stage_cycles[VERUSHASH_STAGES];
+    // bucket n counts calls that took 2^(n-1) to 2^n - 1 cycles
+    uint64_t stage_buckets[VERUSHASH_STAGES][VERUSHASH_STAT_BUCKETS];
+    uint32_t threads;
+} verushash_stats;
+
+void verushash_stats_enable(int enable);
+int verushash_stats_enabled(void);
+
+// totals since the last reset. reading them does not stop or slow the hashing threads.
+void verushash_stats_snapshot(verushash_stats *stats);
+void verushash_stats_reset(void);
+
+// cycles per second of the stage timings
+double verushash_stats_cycles_per_second(void);
+
+// the cache of generated VerusCLHash keys that every context shares, see
+// crypto/verus_keycache.h. it is off until given a capacity.
+enum {
+    VERUSHASH_KEYCACHE_MAX_ENTRIES = 64
+};
+
+typedef struct verushash_keycache_stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+    uint32_t capacity;
+    uint32_t entries;                   // keys cached now
+} verushash_keycache_stats;
+
+// sets how many keys the cache holds, 0 turning it off, and returns the capacity set, which
+// is at most VERUSHASH_KEYCACHE_MAX_ENTRIES
+int verushash_keycache_set_capacity(int entries);
+
+// counters since the last reset, which are kept whether or not stats are enabled
+void verushash_keycache_stats_snapshot(verushash_keycache_stats *stats);
+void verushash_keycache_stats_reset(void);
+
+// target arithmetic for vardiff and share accounting. hashes and targets are 32 bytes little
+// endian, as the hashes above are written, and compare as 256 bit numbers.
+
+// expands compact n_bits into target. returns 0 and zeroes target if n_bits is negative,
+// overflows or is zero, none of which a hash can meet
+int verushash_compact_to_target(uint32_t n_bits, unsigned char *target);
+
+// the compact form of target, rounded down
+uint32_t verushash_target_to_compact(const unsigned char *target);
+
+// returns 1 if hash is at or below target
+int verushash_hash_meets_target(const unsigned char *hash, const unsigned char *target);
+
+// the difficulty of hash, diff1_target / hash, as shares are credited. a zero hash gives
+// infinity
+double verushash_hash_difficulty(const unsigned char *hash, const unsigned char *diff1_target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,514 @@
+package verushash
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"encoding/hex"
+	"math"
+	"os"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/hashpool/go-verushash/verushash"
+)
+
+// known answers, computed with the original SWIG bindings, for the headers in
+// testdata/headers.hex in the same order
+var knownAnswers = []struct {
+	name                string
+	v1, v2b, v2b1, v2b2 string
+}{
+	{
+		// a mined VerusHash 2b2 header
+		"mined",
+		"eb46fbd5b5eaeefcba21f9c7459ab093b6865315e01c92dea9c74e1274af9f21",
+		"549ace72a524eefeb5f7745b9564b16420c4b656deab27bacf42f6c32d97dcdb",
+		"8ac0c1bad153e0920a8fb11969d72ab20be11c373b2abba4c2b0602464582d8f",
+		"d384408512e5b4bb799456c8defd05e7d204e2b413136c28fb92b72876000000",
+	},
+	{
+		// the same header with its non-canonical fields cleared, which hashes with SHA256D
+		// because it has no previous block
+		"canonical",
+		"2f175872e8c3b3379eabce2218074a8d7dcd28fdaeb6a36927b7680ea528d2d3",
+		"f0fca2f56f10862e490aa19a137b04ad42f4715a597d50eaff7058b938b254fb",
+		"cbf55506679f4db2b6271d8cf7f5fb772f34beb233eeaf2d811a4ce33da7b127",
+		"4c04323c74e9f7edcd7aaf0f924b0439a265131d687ab2c8e89289c5cbbc3f48",
+	},
+	{
+		// a header with a PBaaS solution descriptor, whose MMR roots are cleared before hashing
+		"pbaas",
+		"33398cb9294fb030918162289944663a675ae8a7e1f66d1facff98e50ef927bb",
+		"4b660a4a264e980a2812753054b70b30e4beb4fdcef088e764f21c1a90e30e74",
+		"31b1a81e9bf2326fb8953dc48966dfe5da57684f956cd265fe8817348137de4f",
+		"87bc843879e5142111247d5c03d2e075929ee4c7a74bc75a0fc3117b88e61c84",
+	},
+}
+
+func loadHeaders(tb testing.TB) [][]byte {
+	f, err := os.Open("testdata/headers.hex")
+	if err != nil {
+		tb.Fatal(err)
+	}
+	defer f.Close()
+
+	var headers [][]byte
+	scanner := bufio.NewScanner(f)
+	scanner.Buffer(nil, 1<<20)
+	for scanner.Scan() {
+		line := strings.TrimSpace(scanner.Text())
+		if line == "" || strings.HasPrefix(line, "#") {
+			continue
+		}
+		header, err := hex.DecodeString(line)
+		if err != nil {
+			tb.Fatal(err)
+		}
+		headers = append(headers, header)
+	}
+	if len(headers) != len(knownAnswers) {
+		tb.Fatalf("%d headers for %d known answers", len(headers), len(knownAnswers))
+	}
+	return headers
+}
+
+func checkHash(t *testing.T, name string, got []byte, want string) {
+	if hex.EncodeToString(got) != want {
+		t.Errorf("%s: got %x, want %s", name, got, want)
+	}
+}
+
+func TestKnownAnswers(t *testing.T) {
+	headers := loadHeaders(t)
+	dst := make([]byte, VH.HashSize)
+	for i, ka := range knownAnswers {
+		h := headers[i]
+		checkHash(t, ka.name+" VerusHash", VerusHash(h), ka.v1)
+		checkHash(t, ka.name+" VerusHash_V2B", VerusHash_V2B(h), ka.v2b)
+		checkHash(t, ka.name+" VerusHash_V2B1", VerusHash_V2B1(h), ka.v2b1)
+		checkHash(t, ka.name+" VerusHash_V2B2", VerusHash_V2B2(h), ka.v2b2)
+
+		VerusHashInto(dst, h)
+		checkHash(t, ka.name+" VerusHashInto", dst, ka.v1)
+		VerusHash_V2BInto(dst, h)
+		checkHash(t, ka.name+" VerusHash_V2BInto", dst, ka.v2b)
+		VerusHash_V2B1Into(dst, h)
+		checkHash(t, ka.name+" VerusHash_V2B1Into", dst, ka.v2b1)
+		if err := VerusHash_V2B2Into(dst, h); err != nil {
+			t.Errorf("%s VerusHash_V2B2Into: %v", ka.name, err)
+		}
+		checkHash(t, ka.name+" VerusHash_V2B2Into", dst, ka.v2b2)
+	}
+
+	batch := make([]byte, VH.HashSize*len(headers))
+	errs := make([]error, len(headers))
+	if failed := VerusHash_V2B2Batch(batch, headers, errs); failed != 0 {
+		t.Errorf("VerusHash_V2B2Batch: %d failed: %v", failed, errs)
+	}
+	for i, ka := range knownAnswers {
+		checkHash(t, ka.name+" VerusHash_V2B2Batch", batch[i*VH.HashSize:(i+1)*VH.HashSize], ka.v2b2)
+	}
+
+	pool := VH.NewPool(2)
+	defer pool.Close()
+	for i, ka := range knownAnswers {
+		if err := pool.Hash(VH.V2b2, dst, headers[i]); err != nil {
+			t.Errorf("%s Pool.Hash: %v", ka.name, err)
+		}
+		checkHash(t, ka.name+" Pool.Hash", dst, ka.v2b2)
+	}
+}
+
+func TestInvalidHeader(t *testing.T) {
+	header := loadHeaders(t)[0]
+	dst := bytes.Repeat([]byte{0xff}, VH.HashSize)
+	for _, n := range []int{0, 100, 143, len(header) - 1} {
+		if err := VerusHash_V2B2Into(dst, header[:n]); err != ErrInvalidHeader {
+			t.Errorf("%d bytes: got %v, want ErrInvalidHeader", n, err)
+		}
+		if !bytes.Equal(dst, make([]byte, VH.HashSize)) {
+			t.Errorf("%d bytes: hash not zeroed", n)
+		}
+	}
+}
+
+var benchVariants = []struct {
+	name string
+	hash func(dst, src []byte)
+}{
+	{"VerusHash", func(dst, src []byte) { VerusHash(src) }},
+	{"VerusHash_V2B", func(dst, src []byte) { VerusHash_V2B(src) }},
+	{"VerusHash_V2B1", func(dst, src []byte) { VerusHash_V2B1(src) }},
+	{"VerusHash_V2B2", func(dst, src []byte) { VerusHash_V2B2(src) }},
+	{"VerusHashInto", VerusHashInto},
+	{"VerusHash_V2BInto", VerusHash_V2BInto},
+	{"VerusHash_V2B1Into", VerusHash_V2B1Into},
+	{"VerusHash_V2B2Into", func(dst, src []byte) { VerusHash_V2B2Into(dst, src) }},
+}
+
+func TestTemplates(t *testing.T) {
+	templates := NewTemplates(0)
+	defer templates.Close()
+
+	const solutionOffset = 143
+	const tailOffset = 1344 - 40
+	header := loadHeaders(t)[0]
+	if len(header) != solutionOffset+1344 {
+		t.Fatalf("header is %d bytes, not full size", len(header))
+	}
+	nTime := binary.LittleEndian.Uint32(header[100:])
+	tail := header[solutionOffset+tailOffset:]
+
+	if err := templates.Register(1, header, tailOffset, bytes.Repeat([]byte{0xff}, VH.HashSize)); err != nil {
+		t.Fatal(err)
+	}
+	if err := templates.Register(1, header, tailOffset, nil); err != VH.ErrInvalidTemplate {
+		t.Errorf("registering a live ID: got %v, want ErrInvalidTemplate", err)
+	}
+	if err := templates.Register(2, header, 8, nil); err != VH.ErrInvalidTemplate {
+		t.Errorf("tail over the solution descriptor: got %v, want ErrInvalidTemplate", err)
+	}
+
+	// shares with the template's nTime resume after the tail offset, others before nTime
+	share := append([]byte(nil), header...)
+	dst := make([]byte, VH.HashSize)
+	for i, time := range []uint32{nTime, nTime + 1} {
+		binary.LittleEndian.PutUint32(share[100:], time)
+		share[len(share)-1] ^= byte(i + 1)
+		passed, err := templates.Submit(dst, 1, time, share[solutionOffset+tailOffset:])
+		if err != nil || !passed {
+			t.Errorf("nTime %d: got %v, %v, want a passing share", time, passed, err)
+		}
+		if want := VerusHash_V2B2(share); !bytes.Equal(dst, want) {
+			t.Errorf("nTime %d: got %x, want %x", time, dst, want)
+		}
+	}
+
+	if _, err := templates.Submit(dst, 1, nTime, tail[1:]); err != VH.ErrInvalidShare {
+		t.Errorf("short tail: got %v, want ErrInvalidShare", err)
+	}
+	if err := templates.Retire(1); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := templates.Submit(dst, 1, nTime, tail); err != VH.ErrUnknownJob {
+		t.Errorf("retired job: got %v, want ErrUnknownJob", err)
+	}
+}
+
+// TestTemplatesRetireRace retires jobs that are already gone while workers register, submit
+// to and retire their own jobs in the same slots. A stale retire must never touch a live job.
+func TestTemplatesRetireRace(t *testing.T) {
+	const workers = 2
+	const stale = 2
+	const rounds = 2000
+	const submits = 4
+	templates := NewTemplates(workers)
+	defer templates.Close()
+
+	const solutionOffset = 143
+	const tailOffset = 1344 - 40
+	header := loadHeaders(t)[0]
+	nTime := binary.LittleEndian.Uint32(header[100:])
+	tail := header[solutionOffset+tailOffset:]
+
+	var nextID, retired uint64
+	var stop int32
+	var wg sync.WaitGroup
+	for r := 0; r < stale; r++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for atomic.LoadInt32(&stop) == 0 {
+				if id := atomic.LoadUint64(&retired); id != 0 {
+					if err := templates.Retire(id); err != VH.ErrUnknownJob {
+						t.Errorf("retiring retired job %d: got %v, want ErrUnknownJob", id, err)
+					}
+				}
+			}
+		}()
+	}
+
+	var workersWG sync.WaitGroup
+	for w := 0; w < workers; w++ {
+		workersWG.Add(1)
+		go func() {
+			defer workersWG.Done()
+			dst := make([]byte, VH.HashSize)
+			for i := 0; i < rounds; i++ {
+				id := atomic.AddUint64(&nextID, 1)
+				if err := templates.Register(id, header, tailOffset, nil); err != nil {
+					t.Errorf("registering job %d: %v", id, err)
+					return
+				}
+				for s := 0; s < submits; s++ {
+					if _, err := templates.Submit(dst, id, nTime, tail); err != nil {
+						t.Errorf("submitting to live job %d: %v", id, err)
+					}
+				}
+				if err := templates.Retire(id); err != nil {
+					t.Errorf("retiring job %d: %v", id, err)
+				}
+				atomic.StoreUint64(&retired, id)
+			}
+		}()
+	}
+	workersWG.Wait()
+	atomic.StoreInt32(&stop, 1)
+	wg.Wait()
+}
+
+// TestTemplatesRegisterRace registers each job ID from several goroutines at once. Exactly one
+// registration may succeed, and one retire must remove the job.
+func TestTemplatesRegisterRace(t *testing.T) {
+	const registrars = 4
+	const rounds = 500
+	templates := NewTemplates(registrars)
+	defer templates.Close()
+
+	header := loadHeaders(t)[0]
+	const tailOffset = 1344 - 40
+	for id := uint64(1); id <= rounds; id++ {
+		var registered int32
+		var wg sync.WaitGroup
+		for r := 0; r < registrars; r++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				if templates.Register(id, header, tailOffset, nil) == nil {
+					atomic.AddInt32(&registered, 1)
+				}
+			}()
+		}
+		wg.Wait()
+		if registered != 1 {
+			t.Fatalf("job %d: %d registrations succeeded, want 1", id, registered)
+		}
+		if err := templates.Retire(id); err != nil {
+			t.Fatalf("retiring job %d: %v", id, err)
+		}
+		if err := templates.Retire(id); err != VH.ErrUnknownJob {
+			t.Fatalf("job %d still live after retiring: got %v, want ErrUnknownJob", id, err)
+		}
+	}
+}
+
+func reportHashRate(b *testing.B, start time.Time, hashes int) {
+	if elapsed := time.Since(start).Seconds(); elapsed > 0 {
+		b.ReportMetric(float64(hashes)/elapsed, "hashes/s")
+	}
+}
+
+// BenchmarkHash hashes a full 1487 byte header with each variant, on one goroutine and then on
+// GOMAXPROCS goroutines.
+func BenchmarkHash(b *testing.B) {
+	header := loadHeaders(b)[0]
+	for _, v := range benchVariants {
+		v := v
+		b.Run(v.name+"/serial", func(b *testing.B) {
+			dst := make([]byte, VH.HashSize)
+			b.SetBytes(int64(len(header)))
+			b.ReportAllocs()
+			b.ResetTimer()
+			start := time.Now()
+			for i := 0; i < b.N; i++ {
+				v.hash(dst, header)
+			}
+			reportHashRate(b, start, b.N)
+		})
+		b.Run(v.name+"/parallel", func(b *testing.B) {
+			b.SetBytes(int64(len(header)))
+			b.ReportAllocs()
+			b.ResetTimer()
+			start := time.Now()
+			b.RunParallel(func(pb *testing.PB) {
+				dst := make([]byte, VH.HashSize)
+				for pb.Next() {
+					v.hash(dst, header)
+				}
+			})
+			reportHashRate(b, start, b.N)
+		})
+	}
+}
+
+// BenchmarkBatch hashes headers 64 at a time through VerusHash_V2B2Batch.
+func BenchmarkBatch(b *testing.B) {
+	const batchSize = 64
+	header := loadHeaders(b)[0]
+	headers := make([][]byte, batchSize)
+	for i := range headers {
+		headers[i] = header
+	}
+	dst := make([]byte, VH.HashSize*batchSize)
+	errs := make([]error, batchSize)
+	b.SetBytes(int64(len(header) * batchSize))
+	b.ReportAllocs()
+	b.ResetTimer()
+	start := time.Now()
+	for i := 0; i < b.N; i++ {
+		VerusHash_V2B2Batch(dst, headers, errs)
+	}
+	reportHashRate(b, start, b.N*batchSize)
+}
+
+// BenchmarkPool hashes headers on a worker pool of GOMAXPROCS workers, submitting from
+// GOMAXPROCS goroutines.
+func BenchmarkPool(b *testing.B) {
+	header := loadHeaders(b)[0]
+	pool := VH.NewPool(0)
+	defer pool.Close()
+	b.SetBytes(int64(len(header)))
+	b.ReportAllocs()
+	b.ResetTimer()
+	start := time.Now()
+	b.RunParallel(func(pb *testing.PB) {
+		dst := make([]byte, VH.HashSize)
+		for pb.Next() {
+			pool.Hash(VH.V2b2, dst, header)
+		}
+	})
+	reportHashRate(b, start, b.N)
+}
+
+func TestStats(t *testing.T) {
+	headers := loadHeaders(t)
+	dst := make([]byte, VH.HashSize)
+
+	EnableStats(true)
+	defer EnableStats(false)
+	ResetStats()
+	for i := 0; i < 10; i++ {
+		VerusHash_V2B2Into(dst, headers[0])
+	}
+	VerusHash_V2B2Into(dst, headers[0][:100])
+
+	var stats Stats
+	ReadStats(&stats)
+	if stats.HashesBySolution[4] != 10 {
+		t.Errorf("HashesBySolution[4] = %d, want 10", stats.HashesBySolution[4])
+	}
+	if stats.KeysGenerated+stats.KeysCached+stats.KeysReused != 10 {
+		t.Errorf("%d keys generated, %d cached, %d reused, want 10 in all", stats.KeysGenerated, stats.KeysCached, stats.KeysReused)
+	}
+	if stats.DeserializeFailures != 1 {
+		t.Errorf("DeserializeFailures = %d, want 1", stats.DeserializeFailures)
+	}
+	if stats.BytesHashed < 10*uint64(len(headers[0])) {
+		t.Errorf("BytesHashed = %d, want at least %d", stats.BytesHashed, 10*len(headers[0]))
+	}
+	for _, stage := range []VH.Stage{VH.StageDeserialize, VH.StageHarakaChain, VH.StageKeygen, VH.StageCLHash, VH.StageFinalHaraka} {
+		s := stats.Stages[stage]
+		var bucketed uint64
+		for _, n := range s.Buckets {
+			bucketed += n
+		}
+		if s.Calls == 0 || s.Cycles == 0 || bucketed != s.Calls {
+			t.Errorf("%v: %d calls, %d cycles, %d in buckets", stage, s.Calls, s.Cycles, bucketed)
+		}
+	}
+
+	ResetStats()
+	ReadStats(&stats)
+	if stats.HashesBySolution[4] != 0 || stats.Stages[VH.StageKeygen].Calls != 0 {
+		t.Errorf("stats not reset: %+v", stats)
+	}
+}
+
+func TestDifficulty(t *testing.T) {
+	diff1 := make([]byte, VH.HashSize)
+	if err := CompactToTarget(diff1, 0x1d00ffff); err != nil {
+		t.Fatal(err)
+	}
+	want := make([]byte, VH.HashSize)
+	want[26], want[27] = 0xff, 0xff
+	if !bytes.Equal(diff1, want) {
+		t.Errorf("1d00ffff: got %x, want %x", diff1, want)
+	}
+	if bits := TargetToCompact(diff1); bits != 0x1d00ffff {
+		t.Errorf("compact of the 1d00ffff target: got %08x", bits)
+	}
+	for _, bits := range []uint32{0, 0x04923456, 0xff123456} {
+		if err := CompactToTarget(want, bits); err != VH.ErrInvalidCompact {
+			t.Errorf("%08x: got %v, want ErrInvalidCompact", bits, err)
+		}
+	}
+
+	half := make([]byte, VH.HashSize)
+	half[25], half[26], half[27] = 0x80, 0xff, 0x7f
+	above := append([]byte(nil), diff1...)
+	above[28] = 1
+	for _, c := range []struct {
+		hash       []byte
+		difficulty float64
+	}{
+		{diff1, 1},
+		{half, 2},
+		{make([]byte, VH.HashSize), math.Inf(1)},
+	} {
+		if !MeetsTarget(c.hash, diff1) {
+			t.Errorf("%x does not meet the target", c.hash)
+		}
+		if got := HashDifficulty(c.hash, diff1); got != c.difficulty {
+			t.Errorf("%x difficulty: got %v, want %v", c.hash, got, c.difficulty)
+		}
+	}
+	if MeetsTarget(above, diff1) || HashDifficulty(above, diff1) >= 1 {
+		t.Errorf("%x, above the target, meets it", above)
+	}
+}
+
+func TestKeyCache(t *testing.T) {
+	headers := loadHeaders(t)
+	want, dst := make([]byte, VH.HashSize), make([]byte, VH.HashSize)
+
+	if got := SetKeyCacheCapacity(VH.KeyCacheMaxEntries + 1); got != VH.KeyCacheMaxEntries {
+		t.Errorf("capacity %d set, want it clamped to %d", got, VH.KeyCacheMaxEntries)
+	}
+	if got := SetKeyCacheCapacity(-1); got != 0 {
+		t.Errorf("capacity %d set for -1, want 0", got)
+	}
+	SetKeyCacheCapacity(4)
+	defer SetKeyCacheCapacity(0)
+	EnableStats(true)
+	defer EnableStats(false)
+	ResetStats()
+	ResetKeyCacheStats()
+
+	// every pool worker has a context of its own, so the second pool does not have the key
+	// the first one generated, and gets it from the cache
+	first, second := VH.NewPool(1), VH.NewPool(1)
+	defer first.Close()
+	defer second.Close()
+
+	var cache KeyCacheStats
+	first.Hash(VH.V2b2, want, headers[0])
+	ReadKeyCacheStats(&cache)
+	if cache.Hits != 0 || cache.Misses != 1 || cache.Inserts != 1 || cache.Entries != 1 || cache.Capacity != 4 {
+		t.Errorf("after the first context: %+v, want a miss and an insert", cache)
+	}
+
+	second.Hash(VH.V2b2, dst, headers[0])
+	ReadKeyCacheStats(&cache)
+	if cache.Hits != 1 || cache.Misses != 1 {
+		t.Errorf("after the second context: %+v, want a hit", cache)
+	}
+	if !bytes.Equal(dst, want) {
+		t.Errorf("hash with a cached key %x, want %x", dst, want)
+	}
+
+	var stats Stats
+	ReadStats(&stats)
+	if stats.KeysGenerated != 1 || stats.KeysCached != 1 {
+		t.Errorf("%d keys generated and %d cached, want 1 each", stats.KeysGenerated, stats.KeysCached)
+	}
+
+	ResetKeyCacheStats()
+	ReadKeyCacheStats(&cache)
+	if cache.Hits != 0 || cache.Misses != 0 || cache.Inserts != 0 || cache.Entries != 1 {
+		t.Errorf("key cache stats not reset: %+v", cache)
+	}
+}